@@ -19,6 +19,10 @@ extern llvm::cl::opt<bool> UseCache;
 
 extern llvm::cl::opt<bool> UseIndependentSolver; 
 
+extern llvm::cl::opt<bool> UseIntervalSolver;
+
+extern llvm::cl::opt<bool> UseQueryNormalization;
+
 extern llvm::cl::opt<bool> DebugValidateSolver;
   
 extern llvm::cl::opt<int> MinQueryTimeToLog;
@@ -29,6 +33,8 @@ extern llvm::cl::opt<bool> UseForkedCoreSolver;
 
 extern llvm::cl::opt<bool> CoreSolverOptimizeDivides;
 
+extern llvm::cl::opt<unsigned> ConstructCacheSize;
+
 extern llvm::cl::opt<bool> UseAssignmentValidatingSolver;
 
 ///The different query logging solvers that can switched on/off
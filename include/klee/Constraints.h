@@ -11,6 +11,10 @@
 #define KLEE_CONSTRAINTS_H
 
 #include "klee/Expr.h"
+#include "klee/util/ExprHashMap.h"
+#include "klee/Internal/ADT/ImmutableVector.h"
+
+#include <map>
 
 // FIXME: Currently we use ConstraintManager for two things: to pass
 // sets of constraints around, and to optimize constraints. We should
@@ -22,8 +26,10 @@ class ExprVisitor;
   
 class ConstraintManager {
 public:
-  typedef std::vector< ref<Expr> > constraints_ty;
-  typedef constraints_ty::iterator iterator;
+  /// The constraints are shared between copies of a constraint manager,
+  /// so that copying one takes constant time.
+  typedef ImmutableVector< ref<Expr> > constraints_ty;
+  typedef constraints_ty::const_iterator iterator;
   typedef constraints_ty::const_iterator const_iterator;
 
   ConstraintManager() {}
@@ -31,11 +37,15 @@ public:
   // create from constraints with no optimization
   explicit
   ConstraintManager(const std::vector< ref<Expr> > &_constraints) :
-    constraints(_constraints) {}
+    constraints(_constraints.begin(), _constraints.end()) {}
 
-  ConstraintManager(const ConstraintManager &cs) : constraints(cs.constraints) {}
+  /// Get the number of bytes taken by the constraint sets of all
+  /// constraint managers and by their (shared) indices.
+  static size_t getNumAllocatedBytes() {
+    return allocatedBytes + constraints_ty::getNumAllocatedBytes();
+  }
 
-  typedef std::vector< ref<Expr> >::const_iterator constraint_iterator;
+  typedef constraints_ty::const_iterator constraint_iterator;
 
   // given a constraint which is known to be valid, attempt to 
   // simplify the existing constraint set
@@ -60,16 +70,98 @@ public:
   size_t size() const {
     return constraints.size();
   }
+  const ref<Expr> &operator[](unsigned index) const {
+    return constraints[index];
+  }
+
+  /// Get the number of leading constraints which are shared with other
+  /// constraint managers, and so stay in memory without this one.
+  size_t getNumSharedConstraints() const {
+    return constraints.getNumSharedElements();
+  }
+
+  /// Keep only the first \a n constraints, still sharing them with the
+  /// managers they are shared with, and drop the caches.
+  void truncate(unsigned n);
+
+  /// Append \a e, which was dropped by truncate(), as it is.
+  void restoreConstraint(const ref<Expr> &e) { constraints.push_back(e); }
 
   bool operator==(const ConstraintManager &other) const {
     return constraints == other.constraints;
   }
   
 private:
-  std::vector< ref<Expr> > constraints;
+  constraints_ty constraints;
+
+  /// The bytes taken by the indices, see getNumAllocatedBytes().
+  static size_t allocatedBytes;
+
+  /// The equalities used by simplifyExpr() and its memoised results for
+  /// (a prefix of) the constraints. Shared between copies of the
+  /// constraint manager until the constraints of either change.
+  struct SimplificationCache {
+    unsigned refCount;
+
+    /// Number of leading constraints which are indexed in equalities.
+    unsigned numIndexed;
+
+    /// Maps expressions to the values they are known to have.
+    ExprHashMap< ref<Expr> > equalities;
+
+    /// Results of simplifyExpr() for the indexed constraints.
+    ExprHashMap< ref<Expr> > simplified;
+
+    SimplificationCache();
+    SimplificationCache(const SimplificationCache &b);
+    ~SimplificationCache();
+
+    /// Get the (estimated) number of bytes taken by the cache.
+    size_t getNumBytes() const;
+  };
+
+  /// Null if the cache has to be rebuilt from scratch.
+  mutable ref<SimplificationCache> cache;
+
+  /// Get the simplification cache, indexing any new constraints.
+  SimplificationCache &getSimplificationCache() const;
+
+  /// The symbolic arrays read by (a prefix of) the constraints, so that
+  /// rewriting an expression only visits the constraints which may
+  /// contain it. Shared between copies like the simplification cache.
+  struct ArrayIndex {
+    unsigned refCount;
+
+    /// The arrays read by each indexed constraint.
+    std::vector< std::vector<const Array*> > arrays;
+
+    /// The positions of the indexed constraints reading each array.
+    std::map<const Array*, std::vector<unsigned> > uses;
+
+    /// The (estimated) number of bytes taken by the index.
+    size_t numBytes;
+
+    ArrayIndex() : refCount(0), numBytes(sizeof(ArrayIndex)) {
+      allocatedBytes += numBytes;
+    }
+    ArrayIndex(const ArrayIndex &b)
+      : refCount(0), arrays(b.arrays), uses(b.uses), numBytes(b.numBytes) {
+      allocatedBytes += numBytes;
+    }
+    ~ArrayIndex() { allocatedBytes -= numBytes; }
+
+    void add(const std::vector<const Array*> &objects);
+  };
+
+  /// Null until the first rewrite.
+  ref<ArrayIndex> arrayIndex;
+
+  /// Get the array index, indexing any new constraints.
+  ArrayIndex &getArrayIndex();
 
+  /// Rewrite the constraints which may contain \a src with \a visitor.
   // returns true iff the constraints were modified
-  bool rewriteConstraints(ExprVisitor &visitor);
+  bool rewriteConstraints(ExprVisitor &visitor, const ref<Expr> &src);
 
   void addConstraintInternal(ref<Expr> e);
 };
@@ -12,7 +12,12 @@
 
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+#include "klee/Internal/ADT/ImmutableSet.h"
+#include "klee/Internal/ADT/ImmutableVector.h"
+#include "klee/Internal/ADT/SharedBitmap.h"
 #include "klee/Internal/ADT/TreeStream.h"
+#include "klee/Internal/Module/Cell.h"
 
 // FIXME: We do not want to be exposing these? :(
 #include "../../lib/Core/AddressSpace.h"
@@ -25,7 +30,6 @@
 namespace klee {
 class Array;
 class CallPathNode;
-struct Cell;
 struct KFunction;
 struct KInstruction;
 class MemoryObject;
@@ -40,7 +44,26 @@ struct StackFrame {
   CallPathNode *callPathNode;
 
   std::vector<const MemoryObject *> allocas;
-  Cell *locals;
+
+private:
+  /// The registers of a frame, shared between copies of the frame until
+  /// either writes to them.
+  struct Locals {
+    unsigned refCount;
+    Cell *cells;
+
+    explicit Locals(unsigned numRegisters)
+      : refCount(1), cells(new Cell[numRegisters]) {}
+    ~Locals() { delete[] cells; }
+  };
+
+  Locals *locals;
+
+  /// Give the frame its own copy of the registers.
+  void copyLocals();
+  void releaseLocals();
+
+public:
 
   /// Minimum distance to an uncovered instruction once the function
   /// returns. This is not a good place for this but is used to
@@ -59,6 +82,39 @@ struct StackFrame {
   StackFrame(KInstIterator caller, KFunction *kf);
   StackFrame(const StackFrame &s);
   ~StackFrame();
+
+  StackFrame &operator=(const StackFrame &s);
+
+  const Cell &getLocal(unsigned index) const { return locals->cells[index]; }
+
+  /// Whether the registers are shared with another frame.
+  bool hasSharedLocals() const { return locals->refCount > 1; }
+
+  /// Get a register for writing, copying the registers first if they are
+  /// shared with another frame.
+  Cell &getWriteableLocal(unsigned index) {
+    if (locals->refCount > 1)
+      copyLocals();
+    return locals->cells[index];
+  }
+};
+
+/// A symbolic object of a state. Holds a reference to its memory object,
+/// so that the symbolics can be shared between states.
+struct Symbolic {
+  const MemoryObject *first;
+  const Array *second;
+
+  Symbolic() : first(0), second(0) {}
+  Symbolic(const MemoryObject *mo, const Array *array);
+  Symbolic(const Symbolic &b);
+  ~Symbolic();
+
+  Symbolic &operator=(const Symbolic &b);
+
+  bool operator==(const Symbolic &b) const {
+    return first == b.first && second == b.second;
+  }
 };
 
 /// @brief ExecutionState representing a path under exploration
@@ -70,7 +126,7 @@ private:
   // unsupported, use copy constructor
   ExecutionState &operator=(const ExecutionState &);
 
-  std::map<std::string, std::string> fnAliases;
+  ImmutableMap<std::string, std::string> fnAliases;
 
 public:
   // Execution - Control Flow specific
@@ -130,26 +186,34 @@ public:
   /// @brief Disables forking for this state. Set by user code
   bool forkDisabled;
 
-  /// @brief Set containing which lines in which files are covered by this state
-  std::map<const std::string *, std::set<unsigned> > coveredLines;
+  /// @brief The number of branches of the replayed path taken by this state
+  unsigned replayPathPosition;
+
+  /// @brief The instructions (by InstructionInfo id) which were first
+  /// covered by this state since it last branched. Only tracked if the
+  /// interpreter was asked to report covered lines.
+  SharedBitmap coveredInstructions;
 
   /// @brief Pointer to the process tree of the current state
   PTreeNode *ptreeNode;
 
+  /// @brief Position of the state in the states of the executor, or
+  /// NotRegistered if it was not added there (yet)
+  unsigned stateIndex;
+  static const unsigned NotRegistered = ~0u;
+
   /// @brief Ordered list of symbolics: used to generate test cases.
-  //
-  // FIXME: Move to a shared list structure (not critical).
-  std::vector<std::pair<const MemoryObject *, const Array *> > symbolics;
+  ImmutableVector<Symbolic> symbolics;
 
   /// @brief Set of used array names for this state.  Used to avoid collisions.
-  std::set<std::string> arrayNames;
+  ImmutableSet<std::string> arrayNames;
 
   std::string getFnAlias(std::string fn);
   void addFnAlias(std::string old_fn, std::string new_fn);
   void removeFnAlias(std::string fn);
 
 private:
-  ExecutionState() : ptreeNode(0) {}
+  ExecutionState() : ptreeNode(0), stateIndex(NotRegistered) {}
 
 public:
   ExecutionState(KFunction *kf);
@@ -174,9 +174,39 @@ public:
 
   unsigned refCount;
 
+  /// Whether structurally equal expressions are allocated only once, see
+  /// hashCons(). Set by --hash-cons-exprs.
+  static bool hashConsing;
+
 protected:  
   unsigned hashValue;
 
+  /// The width of the expression. Together with the kind and the
+  /// hash-consing flag below it fills a single word, so that the kids of
+  /// an expression directly follow the reference count and the hash.
+  Width width;
+
+private:
+  unsigned char exprKind;
+
+  /// Whether this expression is in the hash-consing table.
+  bool hashConsed;
+
+  static Expr *lookupOrInsert(Expr *e);
+  void removeHashConsed();
+
+protected:
+  /// Get the unique expression structurally equal to the newly allocated
+  /// \a e, which is entered into the hash-consing table if there is none
+  /// yet. The table only holds weak references, expressions leave it
+  /// when they are deleted. Returns \a e if hash-consing is disabled.
+  template<class T>
+  static ref<T> hashCons(const ref<T> &e) {
+    if (!hashConsing)
+      return e;
+    return static_cast<T *>(lookupOrInsert(e.get()));
+  }
+
   /// Compares `b` to `this` Expr and determines how they are ordered
   /// (ignoring their kid expressions - i.e. those returned by `getKid()`).
   ///
@@ -201,12 +231,29 @@ protected:
   /// `<` and `>` are binary relations that express the partial order.
   virtual int compareContents(const Expr &b) const = 0;
 
+  Expr(Kind k, Width w)
+    : refCount(0), width(w), exprKind(k), hashConsed(false) {
+    Expr::count++;
+  }
+
 public:
-  Expr() : refCount(0) { Expr::count++; }
-  virtual ~Expr() { Expr::count--; } 
+  virtual ~Expr() {
+    Expr::count--;
+    if (hashConsed)
+      removeHashConsed();
+  }
+
+  /// Expressions are allocated from slabs of equally sized objects rather
+  /// than by malloc, which would add its own header to each of these
+  /// small objects.
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr, size_t size);
 
-  virtual Kind getKind() const = 0;
-  virtual Width getWidth() const = 0;
+  /// Number of bytes taken by the expressions currently allocated.
+  static size_t getNumAllocatedBytes();
+
+  Kind getKind() const { return static_cast<Kind>(exprKind); }
+  Width getWidth() const { return width; }
   
   virtual unsigned getNumKids() const = 0;
   virtual ref<Expr> getKid(unsigned i) const = 0;
@@ -238,6 +285,12 @@ public:
   /// `<` and `>` are binary relations that express the total order.
   int compare(const Expr &b) const;
 
+  /// Is this the unique expression of its structure, see hashCons().
+  bool isHashConsed() const { return hashConsed; }
+
+  /// Number of expressions in the hash-consing table.
+  static unsigned getNumHashConsed();
+
   // Given an array of new kids return a copy of the expression
   // but using those children. 
   virtual ref<Expr> rebuild(ref<Expr> kids[/* getNumKids() */]) const = 0;
@@ -302,6 +355,11 @@ struct Expr::CreateArg {
 // Comparison operators
 
 inline bool operator==(const Expr &lhs, const Expr &rhs) {
+  if (&lhs == &rhs)
+    return true;
+  // Distinct hash-consed expressions are never structurally equal.
+  if (lhs.isHashConsed() && rhs.isHashConsed())
+    return false;
   return lhs.compare(rhs) == 0;
 }
 
@@ -359,6 +417,9 @@ inline std::stringstream &operator<<(std::stringstream &os, const Expr::Kind kin
 // Utility classes
 
 class NonConstantExpr : public Expr {
+protected:
+  NonConstantExpr(Kind k, Width w) : Expr(k, w) {}
+
 public:
   static bool classof(const Expr *E) {
     return E->getKind() != Expr::Constant;
@@ -381,7 +442,8 @@ public:
   }
  
 protected:
-  BinaryExpr(const ref<Expr> &l, const ref<Expr> &r) : left(l), right(r) {}
+  BinaryExpr(Kind k, Width w, const ref<Expr> &l, const ref<Expr> &r)
+    : NonConstantExpr(k, w), left(l), right(r) {}
 
 public:
   static bool classof(const Expr *E) {
@@ -395,11 +457,9 @@ public:
 class CmpExpr : public BinaryExpr {
 
 protected:
-  CmpExpr(ref<Expr> l, ref<Expr> r) : BinaryExpr(l,r) {}
+  CmpExpr(Kind k, ref<Expr> l, ref<Expr> r) : BinaryExpr(k, Bool, l, r) {}
   
 public:                                                       
-  Width getWidth() const { return Bool; }
-
   static bool classof(const Expr *E) {
     Kind k = E->getKind();
     return Expr::CmpKindFirst <= k && k <= Expr::CmpKindLast;
@@ -418,21 +478,19 @@ public:
   static ref<Expr> alloc(const ref<Expr> &src) {
     ref<Expr> r(new NotOptimizedExpr(src));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(ref<Expr> src);
   
-  Width getWidth() const { return src->getWidth(); }
-  Kind getKind() const { return NotOptimized; }
-
   unsigned getNumKids() const { return 1; }
   ref<Expr> getKid(unsigned i) const { return src; }
 
   virtual ref<Expr> rebuild(ref<Expr> kids[]) const { return create(kids[0]); }
 
 private:
-  NotOptimizedExpr(const ref<Expr> &_src) : src(_src) {}
+  NotOptimizedExpr(const ref<Expr> &_src)
+    : NonConstantExpr(NotOptimized, _src->getWidth()), src(_src) {}
 
 protected:
   virtual int compareContents(const Expr &b) const {
@@ -578,14 +636,11 @@ public:
   static ref<Expr> alloc(const UpdateList &updates, const ref<Expr> &index) {
     ref<Expr> r(new ReadExpr(updates, index));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(const UpdateList &updates, ref<Expr> i);
   
-  Width getWidth() const { assert(updates.root); return updates.root->getRange(); }
-  Kind getKind() const { return Read; }
-  
   unsigned getNumKids() const { return numKids; }
   ref<Expr> getKid(unsigned i) const { return !i ? index : 0; }
   
@@ -599,6 +654,7 @@ public:
 
 private:
   ReadExpr(const UpdateList &_updates, const ref<Expr> &_index) : 
+    NonConstantExpr(Read, _updates.root->getRange()),
     updates(_updates), index(_index) { assert(updates.root); }
 
 public:
@@ -623,14 +679,11 @@ public:
                          const ref<Expr> &f) {
     ref<Expr> r(new SelectExpr(c, t, f));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(ref<Expr> c, ref<Expr> t, ref<Expr> f);
 
-  Width getWidth() const { return trueExpr->getWidth(); }
-  Kind getKind() const { return Select; }
-
   unsigned getNumKids() const { return numKids; }
   ref<Expr> getKid(unsigned i) const { 
         switch(i) {
@@ -654,7 +707,8 @@ public:
 
 private:
   SelectExpr(const ref<Expr> &c, const ref<Expr> &t, const ref<Expr> &f) 
-    : cond(c), trueExpr(t), falseExpr(f) {}
+    : NonConstantExpr(Select, t->getWidth()), cond(c), trueExpr(t),
+      falseExpr(f) {}
 
 public:
   static bool classof(const Expr *E) {
@@ -679,20 +733,17 @@ public:
   static const unsigned numKids = 2;
 
 private:
-  Width width;
   ref<Expr> left, right;  
 
 public:
   static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {
     ref<Expr> c(new ConcatExpr(l, r));
     c->computeHash();
-    return c;
+    return hashCons(c);
   }
   
   static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);
 
-  Width getWidth() const { return width; }
-  Kind getKind() const { return kind; }
   ref<Expr> getLeft() const { return left; }
   ref<Expr> getRight() const { return right; }
 
@@ -715,9 +766,9 @@ public:
   virtual ref<Expr> rebuild(ref<Expr> kids[]) const { return create(kids[0], kids[1]); }
   
 private:
-  ConcatExpr(const ref<Expr> &l, const ref<Expr> &r) : left(l), right(r) {
-    width = l->getWidth() + r->getWidth();
-  }
+  ConcatExpr(const ref<Expr> &l, const ref<Expr> &r)
+    : NonConstantExpr(Concat, l->getWidth() + r->getWidth()), left(l),
+      right(r) {}
 
 public:
   static bool classof(const Expr *E) {
@@ -747,21 +798,18 @@ public:
 public:
   ref<Expr> expr;
   unsigned offset;
-  Width width;
+  using Expr::width;
 
 public:  
   static ref<Expr> alloc(const ref<Expr> &e, unsigned o, Width w) {
     ref<Expr> r(new ExtractExpr(e, o, w));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   /// Creates an ExtractExpr with the given bit offset and width
   static ref<Expr> create(ref<Expr> e, unsigned bitOff, Width w);
 
-  Width getWidth() const { return width; }
-  Kind getKind() const { return Extract; }
-
   unsigned getNumKids() const { return numKids; }
   ref<Expr> getKid(unsigned i) const { return expr; }
 
@@ -780,7 +828,7 @@ public:
 
 private:
   ExtractExpr(const ref<Expr> &e, unsigned b, Width w) 
-    : expr(e),offset(b),width(w) {}
+    : NonConstantExpr(Extract, w), expr(e), offset(b) {}
 
 public:
   static bool classof(const Expr *E) {
@@ -804,14 +852,11 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e) {
     ref<Expr> r(new NotExpr(e));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(const ref<Expr> &e);
 
-  Width getWidth() const { return expr->getWidth(); }
-  Kind getKind() const { return Not; }
-
   unsigned getNumKids() const { return numKids; }
   ref<Expr> getKid(unsigned i) const { return expr; }
 
@@ -828,7 +873,7 @@ public:
   static bool classof(const NotExpr *) { return true; }
 
 private:
-  NotExpr(const ref<Expr> &e) : expr(e) {}
+  NotExpr(const ref<Expr> &e) : NonConstantExpr(Not, e->getWidth()), expr(e) {}
 
 protected:
   virtual int compareContents(const Expr &b) const {
@@ -844,12 +889,11 @@ protected:
 class CastExpr : public NonConstantExpr {
 public:
   ref<Expr> src;
-  Width width;
+  using Expr::width;
 
 public:
-  CastExpr(const ref<Expr> &e, Width w) : src(e), width(w) {}
-
-  Width getWidth() const { return width; }
+  CastExpr(Kind k, const ref<Expr> &e, Width w)
+    : NonConstantExpr(k, w), src(e) {}
 
   unsigned getNumKids() const { return 1; }
   ref<Expr> getKid(unsigned i) const { return (i==0) ? src : 0; }
@@ -877,14 +921,14 @@ public:                                                          \
   static const Kind kind = _class_kind;                          \
   static const unsigned numKids = 1;                             \
 public:                                                          \
-    _class_kind ## Expr(ref<Expr> e, Width w) : CastExpr(e,w) {} \
+    _class_kind ## Expr(ref<Expr> e, Width w)                    \
+      : CastExpr(_class_kind, e, w) {}                           \
     static ref<Expr> alloc(const ref<Expr> &e, Width w) {        \
       ref<Expr> r(new _class_kind ## Expr(e, w));                \
       r->computeHash();                                          \
-      return r;                                                  \
+      return hashCons(r);                                        \
     }                                                            \
     static ref<Expr> create(const ref<Expr> &e, Width w);        \
-    Kind getKind() const { return _class_kind; }                 \
     virtual ref<Expr> rebuild(ref<Expr> kids[]) const {          \
       return create(kids[0], width);                             \
     }                                                            \
@@ -910,15 +954,13 @@ CAST_EXPR_CLASS(ZExt)
                                                                                \
   public:                                                                      \
     _class_kind##Expr(const ref<Expr> &l, const ref<Expr> &r)                  \
-        : BinaryExpr(l, r) {}                                                  \
+        : BinaryExpr(_class_kind, l->getWidth(), l, r) {}                      \
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
-      return res;                                                              \
+      return hashCons(res);                                                    \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
-    Width getWidth() const { return left->getWidth(); }                        \
-    Kind getKind() const { return _class_kind; }                               \
     virtual ref<Expr> rebuild(ref<Expr> kids[]) const {                        \
       return create(kids[0], kids[1]);                                         \
     }                                                                          \
@@ -959,14 +1001,13 @@ ARITHMETIC_EXPR_CLASS(AShr)
                                                                                \
   public:                                                                      \
     _class_kind##Expr(const ref<Expr> &l, const ref<Expr> &r)                  \
-        : CmpExpr(l, r) {}                                                     \
+        : CmpExpr(_class_kind, l, r) {}                                        \
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
-      return res;                                                              \
+      return hashCons(res);                                                    \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
-    Kind getKind() const { return _class_kind; }                               \
     virtual ref<Expr> rebuild(ref<Expr> kids[]) const {                        \
       return create(kids[0], kids[1]);                                         \
     }                                                                          \
@@ -1002,24 +1043,38 @@ public:
   static const unsigned numKids = 0;
 
 private:
-  llvm::APInt value;
+  /// The value, kept inline if it fits in 64 bits (as nearly all do) and in
+  /// a separately allocated APInt otherwise.
+  union {
+    uint64_t smallValue;
+    llvm::APInt *largeValue;
+  };
 
-  ConstantExpr(const llvm::APInt &v) : value(v) {}
+  bool isSmall() const { return width <= 64; }
 
-public:
-  ~ConstantExpr() {}
+  ConstantExpr(const llvm::APInt &v) : Expr(Constant, v.getBitWidth()) {
+    if (isSmall())
+      smallValue = v.getZExtValue();
+    else
+      largeValue = new llvm::APInt(v);
+  }
 
-  Width getWidth() const { return value.getBitWidth(); }
-  Kind getKind() const { return Constant; }
+public:
+  ~ConstantExpr() {
+    if (!isSmall())
+      delete largeValue;
+  }
 
   unsigned getNumKids() const { return 0; }
   ref<Expr> getKid(unsigned i) const { return 0; }
 
-  /// getAPValue - Return the arbitrary precision value directly.
+  /// getAPValue - Return the value as an arbitrary precision integer.
   ///
   /// Clients should generally not use the APInt value directly and instead use
   /// native ConstantExpr APIs.
-  const llvm::APInt &getAPValue() const { return value; }
+  llvm::APInt getAPValue() const {
+    return isSmall() ? llvm::APInt(width, smallValue) : *largeValue;
+  }
 
   /// getZExtValue - Returns the constant value zero extended to the
   /// return type of this method.
@@ -1032,13 +1087,15 @@ public:
   /// Example: unit8_t byte= (unit8_t) constant->getZExtValue(8);
   uint64_t getZExtValue(unsigned bits = 64) const {
     assert(getWidth() <= bits && "Value may be out of range!");
-    return value.getZExtValue();
+    return isSmall() ? smallValue : largeValue->getZExtValue();
   }
 
   /// getLimitedValue - If this value is smaller than the specified limit,
   /// return it, otherwise return the limit value.
   uint64_t getLimitedValue(uint64_t Limit = ~0ULL) const {
-    return value.getLimitedValue(Limit);
+    if (!isSmall())
+      return largeValue->getLimitedValue(Limit);
+    return smallValue > Limit ? Limit : smallValue;
   }
 
   /// toString - Return the constant value as a string
@@ -1050,9 +1107,14 @@ public:
     const ConstantExpr &cb = static_cast<const ConstantExpr &>(b);
     if (getWidth() != cb.getWidth())
       return getWidth() < cb.getWidth() ? -1 : 1;
-    if (value == cb.value)
+    if (isSmall()) {
+      if (smallValue == cb.smallValue)
+        return 0;
+      return smallValue < cb.smallValue ? -1 : 1;
+    }
+    if (*largeValue == *cb.largeValue)
       return 0;
-    return value.ult(cb.value) ? -1 : 1;
+    return largeValue->ult(*cb.largeValue) ? -1 : 1;
   }
 
   virtual ref<Expr> rebuild(ref<Expr> kids[]) const {
@@ -1068,7 +1130,7 @@ public:
   static ref<ConstantExpr> alloc(const llvm::APInt &v) {
     ref<ConstantExpr> r(new ConstantExpr(v));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
 
   static ref<ConstantExpr> alloc(const llvm::APFloat &f) {
@@ -1093,23 +1155,28 @@ public:
   /* Utility Functions */
 
   /// isZero - Is this a constant zero.
-  bool isZero() const { return getAPValue().isMinValue(); }
+  bool isZero() const {
+    return isSmall() ? smallValue == 0 : largeValue->isMinValue();
+  }
 
   /// isOne - Is this a constant one.
   bool isOne() const { return getLimitedValue() == 1; }
 
   /// isTrue - Is this the true expression.
   bool isTrue() const {
-    return (getWidth() == Expr::Bool && value.getBoolValue() == true);
+    return (getWidth() == Expr::Bool && smallValue == 1);
   }
 
   /// isFalse - Is this the false expression.
   bool isFalse() const {
-    return (getWidth() == Expr::Bool && value.getBoolValue() == false);
+    return (getWidth() == Expr::Bool && smallValue == 0);
   }
 
   /// isAllOnes - Is this constant all ones.
-  bool isAllOnes() const { return getAPValue().isAllOnesValue(); }
+  bool isAllOnes() const {
+    return isSmall() ? smallValue == bits64::maxValueOfNBits(width)
+                     : largeValue->isAllOnesValue();
+  }
 
   /* Constant Operations */
 
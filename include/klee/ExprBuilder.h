@@ -74,6 +74,12 @@ namespace klee {
   /// folding.
   ExprBuilder *createDefaultExprBuilder();
 
+  /// createCanonicalExprBuilder - Create an expression builder which builds
+  /// expressions with the create functions of the expression classes (such as
+  /// AddExpr::create), i.e. folds and canonicalizes them as the rest of KLEE
+  /// does.
+  ExprBuilder *createCanonicalExprBuilder();
+
   /// createConstantFoldingExprBuilder - Create an expression builder which
   /// folds constant expressions.
   ///
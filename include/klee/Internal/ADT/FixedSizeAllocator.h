@@ -0,0 +1,101 @@
+//===-- FixedSizeAllocator.h ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_FIXEDSIZEALLOCATOR_H
+#define KLEE_FIXEDSIZEALLOCATOR_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace klee {
+  /// Allocator for blocks of a single size.
+  ///
+  /// Blocks are carved out of larger slabs and recycled through an
+  /// intrusive free list, so objects which are created and destroyed at a
+  /// high rate do not have to go through the general purpose allocator.
+  /// Slabs are only released when the allocator itself is destroyed.
+  class FixedSizeAllocator {
+    struct FreeBlock {
+      FreeBlock *next;
+    };
+
+    /// Alignment of every block, enough for any of the pooled types.
+    static const size_t BlockAlignment = 2 * sizeof(void *);
+
+    size_t blockSize;
+    size_t blocksPerSlab;
+    FreeBlock *freeList;
+    std::vector<char *> slabs;
+    size_t numAllocated;
+
+    // DO NOT IMPLEMENT
+    FixedSizeAllocator(const FixedSizeAllocator &);
+    void operator=(const FixedSizeAllocator &);
+
+    void refill() {
+      char *slab =
+          static_cast<char *>(::operator new(blockSize * blocksPerSlab));
+      slabs.push_back(slab);
+      for (size_t i = blocksPerSlab; i != 0; --i) {
+        FreeBlock *block =
+            reinterpret_cast<FreeBlock *>(slab + (i - 1) * blockSize);
+        block->next = freeList;
+        freeList = block;
+      }
+    }
+
+  public:
+    explicit FixedSizeAllocator(size_t size, size_t _blocksPerSlab = 256)
+        : blockSize((std::max(size, sizeof(FreeBlock)) + BlockAlignment - 1) &
+                    ~(BlockAlignment - 1)),
+          blocksPerSlab(_blocksPerSlab), freeList(0), numAllocated(0) {
+      assert(blocksPerSlab && "empty slabs");
+    }
+
+    ~FixedSizeAllocator() {
+      for (std::vector<char *>::iterator it = slabs.begin(), ie = slabs.end();
+           it != ie; ++it)
+        ::operator delete(*it);
+    }
+
+    size_t getBlockSize() const { return blockSize; }
+
+    /// Number of blocks currently handed out.
+    size_t getNumAllocated() const { return numAllocated; }
+
+    /// Number of bytes reserved from the system.
+    size_t getReservedSize() const {
+      return slabs.size() * blocksPerSlab * blockSize;
+    }
+
+    void *allocate() {
+      if (!freeList)
+        refill();
+      FreeBlock *block = freeList;
+      freeList = block->next;
+      ++numAllocated;
+      return block;
+    }
+
+    void deallocate(void *ptr) {
+      if (!ptr)
+        return;
+      assert(numAllocated && "deallocating from empty allocator");
+      FreeBlock *block = static_cast<FreeBlock *>(ptr);
+      block->next = freeList;
+      freeList = block;
+      --numAllocated;
+    }
+  };
+}
+
+#endif
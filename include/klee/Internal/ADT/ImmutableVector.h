@@ -0,0 +1,349 @@
+//===-- ImmutableVector.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_IMMUTABLEVECTOR_H
+#define KLEE_IMMUTABLEVECTOR_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+
+#include <stdint.h>
+
+namespace klee {
+  /// A sequence whose copies share their elements.
+  ///
+  /// The elements are kept in a tree of reference counted nodes with up to
+  /// Width children, except for the last (up to) Width elements which are
+  /// kept in a separate leaf, the tail. Copying a vector takes constant
+  /// time. Appending to a vector only copies the nodes it shares on the
+  /// path to the new element, which is the tail alone in all but one of
+  /// Width cases.
+  template<class T>
+  class ImmutableVector {
+    static const unsigned Bits = 5;
+    static const unsigned Width = 1 << Bits;
+    static const unsigned Mask = Width - 1;
+
+    struct Node {
+      unsigned refCount;
+
+      Node() : refCount(1) {}
+    };
+
+    struct Inner : Node {
+      Node *children[Width];
+
+      Inner() { std::fill(children, children + Width, (Node *) 0); }
+    };
+
+    struct Leaf : Node {
+      T values[Width];
+    };
+
+    /// The tree holding the elements before the tail, null if there are
+    /// none. The root is a leaf if shift is zero.
+    Node *root;
+
+    /// The number of index bits below the root.
+    unsigned shift;
+
+    /// The last elements, null if the vector is empty.
+    Leaf *tail;
+
+    unsigned count;
+
+    static size_t allocatedBytes;
+
+    static Inner *createInner() {
+      allocatedBytes += sizeof(Inner);
+      return new Inner();
+    }
+
+    static Leaf *createLeaf() {
+      allocatedBytes += sizeof(Leaf);
+      return new Leaf();
+    }
+
+    static Node *retain(Node *node) {
+      if (node)
+        ++node->refCount;
+      return node;
+    }
+
+    /// Release a node at the given \a level of the tree (zero for leaves).
+    static void release(Node *node, unsigned level) {
+      if (!node || --node->refCount)
+        return;
+      if (level) {
+        Inner *inner = static_cast<Inner *>(node);
+        for (unsigned i = 0; i != Width; ++i)
+          release(inner->children[i], level - Bits);
+        allocatedBytes -= sizeof(Inner);
+        delete inner;
+      } else {
+        allocatedBytes -= sizeof(Leaf);
+        delete static_cast<Leaf *>(node);
+      }
+    }
+
+    /// Insert the full leaf \a leaf, holding the elements from \a index on,
+    /// into the subtree \a node at \a level. Shared nodes on the path are
+    /// copied.
+    /// \return the new root of the subtree.
+    static Node *insertLeaf(Node *node, unsigned level, unsigned index,
+                            Leaf *leaf) {
+      if (!level) {
+        assert(!node && "leaf already present");
+        return leaf;
+      }
+      Inner *inner;
+      if (!node) {
+        inner = createInner();
+      } else if (node->refCount > 1) {
+        Inner *old = static_cast<Inner *>(node);
+        inner = createInner();
+        for (unsigned i = 0; i != Width; ++i)
+          inner->children[i] = retain(old->children[i]);
+        --old->refCount;
+      } else {
+        inner = static_cast<Inner *>(node);
+      }
+      Node *&child = inner->children[(index >> level) & Mask];
+      child = insertLeaf(child, level - Bits, index, leaf);
+      return inner;
+    }
+
+    /// Count the leading elements of the subtree \a node at \a level,
+    /// holding \a size elements, which are shared with other vectors. An
+    /// element is shared if any node on its path is.
+    static unsigned countShared(const Node *node, unsigned level,
+                                unsigned size) {
+      if (node->refCount > 1)
+        return size;
+      if (!level)
+        return 0;
+      const Inner *inner = static_cast<const Inner *>(node);
+      unsigned childSize = 1u << level;
+      unsigned res = 0;
+      for (unsigned i = 0; i != Width && res != size; ++i) {
+        unsigned n = std::min(childSize, size - res);
+        unsigned shared = countShared(inner->children[i], level - Bits, n);
+        res += shared;
+        if (shared != n)
+          break;
+      }
+      return res;
+    }
+
+    /// Move the full tail into the tree.
+    void pushTail() {
+      unsigned treeCount = count - Width;
+      if (!root) {
+        root = tail;
+        shift = 0;
+      } else {
+        if (treeCount == (uint64_t) 1 << (shift + Bits)) {
+          Inner *newRoot = createInner();
+          newRoot->children[0] = root;
+          root = newRoot;
+          shift += Bits;
+        }
+        root = insertLeaf(root, shift, treeCount, tail);
+      }
+      tail = 0;
+    }
+
+    unsigned getTailOffset() const {
+      return count < Width ? 0 : ((count - 1) >> Bits) << Bits;
+    }
+
+    const Leaf *getLeaf(unsigned index) const {
+      if (index >= getTailOffset())
+        return tail;
+      const Node *node = root;
+      for (unsigned level = shift; level; level -= Bits)
+        node = static_cast<const Inner *>(node)
+                   ->children[(index >> level) & Mask];
+      return static_cast<const Leaf *>(node);
+    }
+
+  public:
+    typedef T value_type;
+
+    class const_iterator {
+      friend class ImmutableVector;
+
+      const ImmutableVector *vector;
+      unsigned index;
+      /// The elements of the leaf holding index.
+      const T *values;
+
+      const_iterator(const ImmutableVector *_vector, unsigned _index)
+        : vector(_vector), index(_index),
+          values(_index < _vector->count ? _vector->getLeaf(_index)->values
+                                         : 0) {}
+
+    public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef T value_type;
+      typedef ptrdiff_t difference_type;
+      typedef const T *pointer;
+      typedef const T &reference;
+
+      const_iterator() : vector(0), index(0), values(0) {}
+
+      reference operator*() const { return values[index & Mask]; }
+      pointer operator->() const { return &values[index & Mask]; }
+
+      const_iterator &operator++() {
+        ++index;
+        if (!(index & Mask) && index < vector->count)
+          values = vector->getLeaf(index)->values;
+        return *this;
+      }
+      const_iterator operator++(int) {
+        const_iterator res(*this);
+        ++*this;
+        return res;
+      }
+
+      bool operator==(const const_iterator &b) const {
+        return index == b.index;
+      }
+      bool operator!=(const const_iterator &b) const {
+        return index != b.index;
+      }
+    };
+
+    ImmutableVector() : root(0), shift(0), tail(0), count(0) {}
+
+    template<class InputIterator>
+    ImmutableVector(InputIterator begin, InputIterator end)
+      : root(0), shift(0), tail(0), count(0) {
+      for (; begin != end; ++begin)
+        push_back(*begin);
+    }
+
+    ImmutableVector(const ImmutableVector &b)
+      : root(retain(b.root)), shift(b.shift),
+        tail(static_cast<Leaf *>(retain(b.tail))), count(b.count) {}
+
+    ~ImmutableVector() {
+      release(root, shift);
+      release(tail, 0);
+    }
+
+    ImmutableVector &operator=(const ImmutableVector &b) {
+      retain(b.root);
+      retain(b.tail);
+      release(root, shift);
+      release(tail, 0);
+      root = b.root;
+      shift = b.shift;
+      tail = b.tail;
+      count = b.count;
+      return *this;
+    }
+
+    bool empty() const { return !count; }
+    unsigned size() const { return count; }
+
+    const T &operator[](unsigned index) const {
+      assert(index < count && "index out of range");
+      return getLeaf(index)->values[index & Mask];
+    }
+
+    const T &back() const { return (*this)[count - 1]; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count); }
+
+    void push_back(const T &value) {
+      unsigned offset = count - getTailOffset();
+      if (!tail || offset == Width) {
+        if (tail)
+          pushTail();
+        tail = createLeaf();
+        offset = 0;
+      } else if (tail->refCount > 1) {
+        Leaf *copy = createLeaf();
+        std::copy(tail->values, tail->values + offset, copy->values);
+        --tail->refCount;
+        tail = copy;
+      }
+      tail->values[offset] = value;
+      ++count;
+    }
+
+    /// Keep only the first \a n elements. The nodes holding whole groups of
+    /// Width of them are shared with the elements dropped.
+    void truncate(unsigned n) {
+      assert(n <= count && "truncating beyond the end");
+      if (n == count)
+        return;
+      ImmutableVector res;
+      unsigned whole = n & ~Mask;
+      for (unsigned i = 0; i != whole; i += Width) {
+        if (res.tail)
+          res.pushTail();
+        res.tail = static_cast<Leaf *>(retain(const_cast<Leaf *>(getLeaf(i))));
+        res.count += Width;
+      }
+      for (unsigned i = whole; i != n; ++i)
+        res.push_back((*this)[i]);
+      swap(res);
+    }
+
+    /// Get the number of leading elements which are kept in nodes shared
+    /// with other vectors, and so stay in memory without this vector.
+    unsigned getNumSharedElements() const {
+      unsigned treeCount = tail ? getTailOffset() : 0;
+      unsigned res = root ? countShared(root, shift, treeCount) : 0;
+      if (res == treeCount && tail && tail->refCount > 1)
+        res = count;
+      return res;
+    }
+
+    void clear() {
+      release(root, shift);
+      release(tail, 0);
+      root = 0;
+      shift = 0;
+      tail = 0;
+      count = 0;
+    }
+
+    void swap(ImmutableVector &b) {
+      std::swap(root, b.root);
+      std::swap(shift, b.shift);
+      std::swap(tail, b.tail);
+      std::swap(count, b.count);
+    }
+
+    bool operator==(const ImmutableVector &b) const {
+      if (count != b.count)
+        return false;
+      if (root == b.root && tail == b.tail)
+        return true;
+      return std::equal(begin(), end(), b.begin());
+    }
+    bool operator!=(const ImmutableVector &b) const { return !(*this == b); }
+
+    /// Get the number of bytes taken by the nodes of all vectors of this
+    /// type.
+    static size_t getNumAllocatedBytes() { return allocatedBytes; }
+  };
+
+  template<class T>
+  size_t ImmutableVector<T>::allocatedBytes = 0;
+}
+
+#endif
@@ -0,0 +1,114 @@
+//===-- SharedBitmap.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SHAREDBITMAP_H
+#define KLEE_SHAREDBITMAP_H
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+namespace klee {
+  /// A set of unsigned integers, which copies of the set share until
+  /// either is changed.
+  ///
+  /// The set is kept as the non-zero words of a bitmap, sorted by their
+  /// index, so that sparse sets stay small.
+  class SharedBitmap {
+    static const unsigned WordBits = 64;
+
+    typedef std::pair<unsigned, uint64_t> word_ty;
+
+    struct Words {
+      unsigned refCount;
+      std::vector<word_ty> words;
+
+      Words() : refCount(1) {}
+    };
+
+    /// Null if the set is empty.
+    Words *words;
+
+    void release() {
+      if (words && --words->refCount == 0)
+        delete words;
+    }
+
+    static bool lessIndex(const word_ty &a, unsigned index) {
+      return a.first < index;
+    }
+
+  public:
+    SharedBitmap() : words(0) {}
+    SharedBitmap(const SharedBitmap &b) : words(b.words) {
+      if (words)
+        ++words->refCount;
+    }
+    ~SharedBitmap() { release(); }
+
+    SharedBitmap &operator=(const SharedBitmap &b) {
+      if (b.words)
+        ++b.words->refCount;
+      release();
+      words = b.words;
+      return *this;
+    }
+
+    bool empty() const { return !words; }
+
+    bool test(unsigned value) const {
+      if (!words)
+        return false;
+      std::vector<word_ty>::const_iterator it =
+        std::lower_bound(words->words.begin(), words->words.end(),
+                         value / WordBits, lessIndex);
+      return it != words->words.end() && it->first == value / WordBits &&
+             (it->second >> (value % WordBits)) & 1;
+    }
+
+    void set(unsigned value) {
+      if (!words) {
+        words = new Words();
+      } else if (words->refCount > 1) {
+        Words *copy = new Words();
+        copy->words = words->words;
+        --words->refCount;
+        words = copy;
+      }
+      std::vector<word_ty>::iterator it =
+        std::lower_bound(words->words.begin(), words->words.end(),
+                         value / WordBits, lessIndex);
+      if (it == words->words.end() || it->first != value / WordBits)
+        it = words->words.insert(it, word_ty(value / WordBits, 0));
+      it->second |= (uint64_t) 1 << (value % WordBits);
+    }
+
+    void clear() {
+      release();
+      words = 0;
+    }
+
+    void swap(SharedBitmap &b) { std::swap(words, b.words); }
+
+    /// Append the elements of the set to \a res, in increasing order.
+    void getElements(std::vector<unsigned> &res) const {
+      if (!words)
+        return;
+      for (std::vector<word_ty>::const_iterator it = words->words.begin(),
+             ie = words->words.end(); it != ie; ++it)
+        for (unsigned i = 0; i != WordBits; ++i)
+          if ((it->second >> i) & 1)
+            res.push_back(it->first * WordBits + i);
+    }
+  };
+}
+
+#endif
@@ -15,8 +15,63 @@
 namespace klee {
   class MemoryObject;
 
+  /// A register or an entry of the constant table.
+  ///
+  /// Constants of up to 64 bits are also kept unboxed, so that the
+  /// interpreter can compute concrete results without allocating a
+  /// ConstantExpr for each of them. The ConstantExpr is only consed up
+  /// once a client asks for the value as an expression.
   struct Cell {
-    ref<Expr> value;
+  private:
+    /// The value as an expression, null for unboxed constants which were
+    /// never asked for as an expression (and for unset registers).
+    mutable ref<Expr> value;
+
+    /// The unboxed constant, valid if immediateWidth is non-zero.
+    uint64_t immediate;
+    Expr::Width immediateWidth;
+
+  public:
+    Cell() : immediate(0), immediateWidth(0) {}
+
+    /// Is the value a constant which is available unboxed.
+    bool isImmediate() const { return immediateWidth != 0; }
+
+    uint64_t getImmediate() const {
+      assert(isImmediate() && "not an immediate constant");
+      return immediate;
+    }
+
+    Expr::Width getImmediateWidth() const { return immediateWidth; }
+
+    /// Get the value as an expression, null for unset registers.
+    ref<Expr> getValue() const {
+      if (value.isNull() && immediateWidth)
+        value = ConstantExpr::create(immediate, immediateWidth);
+      return value;
+    }
+
+    void setValue(const ref<Expr> &e) {
+      value = e;
+      immediateWidth = 0;
+      if (e.isNull())
+        return;
+      if (ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+        if (ce->getWidth() <= Expr::Int64) {
+          immediate = ce->getZExtValue();
+          immediateWidth = ce->getWidth();
+        }
+      }
+    }
+
+    /// Set the value to the constant \a v of width \a w (at most 64 bits),
+    /// which must not have any bits set beyond \a w.
+    void setImmediate(uint64_t v, Expr::Width w) {
+      assert(w && w <= Expr::Int64 && "invalid immediate width");
+      value = 0;
+      immediate = v;
+      immediateWidth = w;
+    }
   };
 }
 
@@ -13,6 +13,7 @@
 #include <map>
 #include <string>
 #include <set>
+#include <vector>
 
 namespace llvm {
   class Function;
@@ -51,6 +52,8 @@ namespace klee {
     std::string dummyString;
     InstructionInfo dummyInfo;
     std::map<const llvm::Instruction*, InstructionInfo> infos;
+    /// The entries of infos, by id.
+    std::vector<const InstructionInfo *> infosByID;
     std::set<const std::string *, ltstr> internedStrings;
 
   private:
@@ -64,6 +67,9 @@ namespace klee {
 
     unsigned getMaxID() const;
     const InstructionInfo &getInfo(const llvm::Instruction*) const;
+    const InstructionInfo &getInfoByID(unsigned id) const {
+      return *infosByID[id];
+    }
     const InstructionInfo &getFunctionInfo(const llvm::Function*) const;
   };
 
@@ -42,6 +42,17 @@ namespace klee {
     /// Destination register index.
     unsigned dest;
 
+    /// The opcode of inst.
+    unsigned opcode;
+    /// The predicate of comparisons.
+    unsigned predicate;
+    /// The width of the result in bits, zero if the result is unsized
+    /// (e.g. void).
+    unsigned width;
+    /// Whether the instruction is an integer operation or cast which the
+    /// executor can evaluate directly on unboxed constants.
+    bool isImmediateOp;
+
   public:
     virtual ~KInstruction();
     void printFileLine(llvm::raw_ostream &);
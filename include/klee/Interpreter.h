@@ -79,8 +79,13 @@ public:
     /// symbolic execution on concrete programs.
     unsigned MakeConcreteSymbolic;
 
+    /// Record the instructions first covered by each state, so that
+    /// getCoveredLines() can report them.
+    bool TrackCoveredLines;
+
     InterpreterOptions()
-      : MakeConcreteSymbolic(false)
+      : MakeConcreteSymbolic(false),
+        TrackCoveredLines(false)
     {}
   };
 
@@ -119,9 +124,12 @@ public:
   virtual void setReplayKTest(const struct KTest *out) = 0;
 
   // supply a list of branch decisions specifying which direction to
-  // take on forks. this can be used to drive the interpretation down
-  // a user specified path. use null to reset.
-  virtual void setReplayPath(const std::vector<bool> *path) = 0;
+  // take on forks (including internal ones, and switches as a sequence
+  // of two-way decisions). this can be used to drive the interpretation
+  // down a user specified path. if prefixOnly is set, all the paths which
+  // extend the given one are explored. use null to reset.
+  virtual void setReplayPath(const std::vector<bool> *path,
+                             bool prefixOnly = false) = 0;
 
   // supply a set of symbolic bindings that will be used as "seeds"
   // for the search. use null to reset.
@@ -138,6 +146,10 @@ public:
 
   virtual void setInhibitForking(bool value) = 0;
 
+  /// Ask the interpreter to give away half of its states at the next
+  /// instruction step, by writing their paths to the output directory.
+  virtual void requestStateDonation() = 0;
+
   virtual void prepareForEarlyExit() = 0;
 
   /*** State accessor methods ***/
@@ -295,6 +295,21 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createFastCexSolver(Solver *s);
 
+  /// createIntervalSolver - Create a solver which tries to decide queries
+  /// from the known bits and the ranges of the bytes read by them, as
+  /// implied by the constraints, before passing them to the given solver.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createIntervalSolver(Solver *s);
+
+  /// createNormalizingSolver - Create a solver which rewrites the common
+  /// byte-level patterns of queries (extracts and comparisons of zero
+  /// extends and concatenations) into simpler forms before passing them to
+  /// the given solver, answering the queries which become constant.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createNormalizingSolver(Solver *s);
+
   /// createIndependentSolver - Create a solver which will eliminate any
   /// unnecessary constraints before propogating the query to the underlying
   /// solver.
@@ -104,6 +104,11 @@ namespace klee {
     }
 
     virtual void setCoreSolverTimeout(double timeout) {};
+
+    /// The (estimated) number of bytes taken by the caches of all solvers
+    /// and expression builders. Each cache adds the size of its entries
+    /// when it inserts them and subtracts it when it drops them.
+    static size_t cacheBytes;
 };
 
 }
@@ -26,6 +26,8 @@ namespace stats {
   extern Statistic queryConstructTime;
   extern Statistic queryConstructs;
   extern Statistic queryCounterexamples;
+  extern Statistic queryIntervalSolverHits;
+  extern Statistic queryNormalizationHits;
   extern Statistic queryTime;
   
 #ifdef DEBUG
@@ -15,6 +15,7 @@
 #include "klee/SolverStats.h"
 
 #include <map>
+#include <vector>
 
 #include <ciso646>
 #ifdef _LIBCPP_VERSION
@@ -65,9 +66,18 @@ public:
   void hashArrayExpr(const Array* array, T& exp);  
   
   bool lookupUpdateNodeExpr(const UpdateNode* un, T& exp) const;
-  void hashUpdateNodeExpr(const UpdateNode* un, T& exp);  
+  void hashUpdateNodeExpr(const Array* root, const UpdateNode* un, T& exp);
+
+  /// Forget the expressions of all update nodes, which releases the update
+  /// lists keeping the nodes alive.
+  void clearUpdateNodeExprs();
+
+  unsigned getNumUpdateNodeExprs() const { return _update_node_hash.size(); }
   
 protected:
+  /// Release an expression which is no longer hashed.
+  virtual void releaseExpr(T& exp) {}
+
   typedef unordered_map<const Array*, T, ArrayHashFn, ArrayCmpFn> ArrayHash;
   typedef typename ArrayHash::iterator ArrayHashIter;
   typedef typename ArrayHash::const_iterator ArrayHashConstIter;
@@ -78,6 +88,10 @@ protected:
   
   ArrayHash      _array_hash;
   UpdateNodeHash _update_node_hash;  
+
+  /// The update lists ending in the hashed update nodes, which keep the
+  /// nodes alive so that their addresses are not reused while hashed.
+  std::vector<UpdateList> _update_node_owners;
 };
 
 
@@ -128,14 +142,27 @@ bool ArrayExprHash<T>::lookupUpdateNodeExpr(const UpdateNode* un, T& exp) const
 }
 
 template<class T>
-void ArrayExprHash<T>::hashUpdateNodeExpr(const UpdateNode* un, T& exp) 
+void ArrayExprHash<T>::hashUpdateNodeExpr(const Array* root,
+                                          const UpdateNode* un, T& exp)
 {
 #ifdef DEBUG
   TimerStatIncrementer t(stats::arrayHashTime);
 #endif
   
   assert(un);
-  _update_node_hash[un] = exp;
+  if (_update_node_hash.insert(std::make_pair(un, exp)).second)
+    _update_node_owners.push_back(UpdateList(root, un));
+  else
+    _update_node_hash[un] = exp;
+}
+
+template<class T>
+void ArrayExprHash<T>::clearUpdateNodeExprs() {
+  for (UpdateNodeHashIter it = _update_node_hash.begin();
+       it != _update_node_hash.end(); ++it)
+    releaseExpr(it->second);
+  _update_node_hash.clear();
+  _update_node_owners.clear();
 }
 
 }
@@ -12,6 +12,7 @@
 
 #include <map>
 
+#include "klee/util/CompiledExpr.h"
 #include "klee/util/ExprEvaluator.h"
 
 // FIXME: Rename?
@@ -84,6 +85,9 @@ namespace klee {
   }
 
   inline ref<Expr> Assignment::evaluate(ref<Expr> e) { 
+    uint64_t value;
+    if (CompiledExpr::evaluateCached(e, *this, value))
+      return ConstantExpr::create(value, e->getWidth());
     AssignmentEvaluator v(*this);
     return v.visit(e); 
   }
@@ -91,9 +95,15 @@ namespace klee {
   template<typename InputIterator>
   inline bool Assignment::satisfies(InputIterator begin, InputIterator end) {
     AssignmentEvaluator v(*this);
-    for (; begin!=end; ++begin)
-      if (!v.visit(*begin)->isTrue())
+    for (; begin!=end; ++begin) {
+      uint64_t value;
+      if (CompiledExpr::evaluateCached(*begin, *this, value)) {
+        if (!value)
+          return false;
+      } else if (!v.visit(*begin)->isTrue()) {
         return false;
+      }
+    }
     return true;
   }
 }
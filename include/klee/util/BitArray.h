@@ -31,6 +31,12 @@ public:
   }
   ~BitArray() { delete[] bits; }
 
+  /// Get the number of bytes taken by a heap allocated array of \a size
+  /// bits.
+  static size_t getNumAllocatedBytes(unsigned size) {
+    return sizeof(BitArray) + sizeof(uint32_t) * length(size);
+  }
+
   bool get(unsigned idx) { return (bool) ((bits[idx/32]>>(idx&0x1F))&1); }
   void set(unsigned idx) { bits[idx/32] |= 1<<(idx&0x1F); }
   void unset(unsigned idx) { bits[idx/32] &= ~(1<<(idx&0x1F)); }
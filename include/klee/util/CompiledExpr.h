@@ -0,0 +1,94 @@
+//===-- CompiledExpr.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_COMPILEDEXPR_H
+#define KLEE_COMPILEDEXPR_H
+
+#include "klee/Expr.h"
+
+#include <vector>
+
+namespace klee {
+  class Assignment;
+
+  /// An expression compiled to a flat program over 64-bit registers, for
+  /// evaluating it under concrete assignments without walking the tree.
+  ///
+  /// Every instruction computes one sub-expression (shared sub-expressions
+  /// are computed once) into the register of the same index, the last
+  /// instruction computes the whole expression. Programs are evaluated
+  /// under many assignments at once, one instruction at a time.
+  ///
+  /// Only expressions of at most 64 bits are compiled. Evaluation fails
+  /// whenever the result would not be a constant, for instance for free
+  /// values or on division by zero, in which case clients fall back to
+  /// the AssignmentEvaluator.
+  class CompiledExpr {
+  public:
+    struct Instruction {
+      Expr::Kind kind;
+      /// Width of the result, and of the first operand.
+      Expr::Width width, kidWidth;
+      /// The registers of the operands. Constant: the value is ops[0] (low
+      /// bits) and ops[1] (high bits). Extract: ops[1] is the offset. Read:
+      /// ops[0] is the index, ops[1] the array, and ops[2] to ops[3] the
+      /// range of updates.
+      unsigned ops[4];
+    };
+
+    /// An update of an array, as the registers holding index and value.
+    struct Update {
+      unsigned index, value;
+    };
+
+  private:
+    std::vector<Instruction> program;
+    std::vector<Update> updates;
+    std::vector<const Array*> arrays;
+
+    CompiledExpr() {}
+
+    /// Evaluate the program under \a n assignments, writing the result
+    /// under the i-th assignment to \a results[i] and whether it is
+    /// concrete to \a valid[i].
+    void run(const Assignment *const *assignments, unsigned n,
+             uint64_t *results, bool *valid) const;
+
+  public:
+    /// Compile \a e, returns null if it cannot be compiled.
+    static CompiledExpr *compile(const ref<Expr> &e);
+
+    /// Number of instructions of the program.
+    unsigned size() const { return program.size(); }
+
+    /// Evaluate under a single assignment.
+    /// \return false if the result is not a constant.
+    bool evaluate(const Assignment &a, uint64_t &result) const;
+
+    /// Evaluate under each of \a assignments.
+    void evaluate(const std::vector<const Assignment*> &assignments,
+                  std::vector<uint64_t> &results,
+                  std::vector<bool> &valid) const;
+
+    /// Evaluate \a e under \a a, with a compiled form of \a e cached once
+    /// it was evaluated a few times. Only the first evaluations of an
+    /// expression go through the (slower) tree evaluator.
+    /// \return false if \a e could not be evaluated to a constant this way.
+    static bool evaluateCached(const ref<Expr> &e, const Assignment &a,
+                               uint64_t &result);
+
+    /// Get the cached compiled form of \a e. Like evaluateCached(), each
+    /// call counts as a use of \a e, and \a e is only compiled once it was
+    /// used often enough.
+    /// \return null if \a e is not compiled (yet), or cannot be compiled.
+    static const CompiledExpr *getCached(const ref<Expr> &e);
+  };
+}
+
+#endif
@@ -0,0 +1,92 @@
+//===-- ExprLRUCache.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRLRUCACHE_H
+#define KLEE_EXPRLRUCACHE_H
+
+#include "klee/util/ExprHashMap.h"
+
+#include <list>
+
+namespace klee {
+
+  /// A map from expressions to values holding at most a given number of
+  /// entries, evicting the least recently used entry when it is full.
+  ///
+  /// The cache holds references to its keys, so entries stay valid for as
+  /// long as they are cached (unlike caches keyed by address).
+  template<class T>
+  class ExprLRUCache {
+    typedef std::list< std::pair<ref<Expr>, T> > entries_ty;
+
+    /// The entries, most recently used first.
+    entries_ty entries;
+    ExprHashMap<typename entries_ty::iterator> index;
+    unsigned capacity;
+
+    /// Counts the (estimated) bytes taken by the entries, if non-null.
+    size_t *accountedBytes;
+
+    /// Estimated number of bytes taken by an entry: its list node and its
+    /// node and bucket in the index.
+    static size_t getEntryBytes() {
+      return sizeof(std::pair<ref<Expr>, T>) + 2 * sizeof(void*) +
+             sizeof(std::pair<ref<Expr>, typename entries_ty::iterator>) +
+             3 * sizeof(void*);
+    }
+
+  public:
+    explicit ExprLRUCache(unsigned _capacity, size_t *_accountedBytes = 0)
+      : capacity(_capacity), accountedBytes(_accountedBytes) {
+      assert(capacity && "empty cache");
+    }
+
+    ~ExprLRUCache() { clear(); }
+
+    /// Get the value for \a e and mark it as recently used.
+    /// \return null if \a e is not cached.
+    T *lookup(const ref<Expr> &e) {
+      typename ExprHashMap<typename entries_ty::iterator>::iterator it =
+        index.find(e);
+      if (it == index.end())
+        return 0;
+      entries.splice(entries.begin(), entries, it->second);
+      return &it->second->second;
+    }
+
+    /// Add the value for \a e, which must not be cached yet.
+    /// \return true if the least recently used entry was evicted.
+    bool insert(const ref<Expr> &e, const T &value) {
+      bool evicted = index.size() >= capacity;
+      if (evicted) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+      } else if (accountedBytes) {
+        *accountedBytes += getEntryBytes();
+      }
+      entries.push_front(std::make_pair(e, value));
+      index.insert(std::make_pair(e, entries.begin()));
+      return evicted;
+    }
+
+    void clear() {
+      if (accountedBytes)
+        *accountedBytes -= index.size() * getEntryBytes();
+      index.clear();
+      entries.clear();
+    }
+
+    unsigned size() const { return index.size(); }
+
+    unsigned getCapacity() const { return capacity; }
+  };
+
+}
+
+#endif
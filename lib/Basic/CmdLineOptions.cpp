@@ -36,6 +36,16 @@ UseIndependentSolver("use-independent-solver",
                      llvm::cl::init(true),
                      llvm::cl::desc("Use constraint independence (default=on)"));
 
+llvm::cl::opt<bool>
+UseIntervalSolver("use-interval-solver",
+                  llvm::cl::init(true),
+                  llvm::cl::desc("Decide queries from the known bits and ranges of the bytes they read, where possible (default=on)"));
+
+llvm::cl::opt<bool>
+UseQueryNormalization("use-query-normalization",
+                      llvm::cl::init(false),
+                      llvm::cl::desc("Simplify the byte-level patterns of queries before solving them (default=off)"));
+
 llvm::cl::opt<bool>
 DebugValidateSolver("debug-validate-solver",
 		             llvm::cl::init(false));
@@ -59,6 +69,11 @@ UseForkedCoreSolver("use-forked-solver",
              llvm::cl::desc("Run the core SMT solver in a forked process (default=on)"),
              llvm::cl::init(true));
 
+llvm::cl::opt<unsigned>
+ConstructCacheSize("construct-cache-size",
+                   llvm::cl::desc("Number of translated expressions the core solver keeps across queries, 0 to only keep them within a query (default=65536)"),
+                   llvm::cl::init(65536));
+
 llvm::cl::opt<bool>
 CoreSolverOptimizeDivides("solver-optimize-divides", 
                  llvm::cl::desc("Optimize constant divides into add/shift/multiplies before passing to core SMT solver (default=off)"),
@@ -52,6 +52,12 @@ Solver *constructSolverChain(Solver *coreSolver,
   if (UseIndependentSolver)
     solver = createIndependentSolver(solver);
 
+  if (UseQueryNormalization)
+    solver = createNormalizingSolver(solver);
+
+  if (UseIntervalSolver)
+    solver = createIntervalSolver(solver);
+
   if (DebugValidateSolver)
     solver = createValidatingSolver(solver, coreSolver);
 
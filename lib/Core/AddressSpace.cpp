@@ -17,6 +17,9 @@
 
 using namespace klee;
 
+uint64_t AddressSpace::lastStoreVersion = 0;
+uint64_t AddressSpace::minValidStoreVersion = 1;
+
 ///
 
 void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
@@ -35,6 +38,21 @@ const ObjectState *AddressSpace::findObject(const MemoryObject *mo) const {
   return res ? res->second : 0;
 }
 
+bool AddressSpace::owns(const ObjectState *os) const {
+  return os->copyOnWriteOwner == cowKey;
+}
+
+uint64_t AddressSpace::getOwnedBytes() const {
+  uint64_t bytes = 0;
+  for (MemoryMap::iterator it = objects.begin(), ie = objects.end(); it != ie;
+       ++it) {
+    const ObjectState *os = it->second;
+    if (owns(os) && os->refCount == 1)
+      bytes += os->getPrivateBytes();
+  }
+  return bytes;
+}
+
 ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
                                         const ObjectState *os) {
   assert(!os->readOnly);
@@ -300,13 +318,29 @@ void AddressSpace::copyOutConcretes() {
       ObjectState *os = it->second;
       uint8_t *address = (uint8_t*) (unsigned long) mo->address;
 
-      if (!os->readOnly)
-        memcpy(address, os->concreteStore, mo->size);
+      if (!os->readOnly) {
+        // Memory allocated by us is only written by external calls, after
+        // which copyInConcretes() revalidates the copied out versions. So
+        // it still holds the contents last copied out unless these changed.
+        if (!mo->isFixed && os->storeVersion >= minValidStoreVersion &&
+            mo->copiedOutVersion == os->storeVersion)
+          continue;
+
+        os->copyConcreteTo(address);
+        if (os->storeVersion < minValidStoreVersion)
+          os->storeVersion = ++lastStoreVersion;
+        mo->copiedOutVersion = os->storeVersion;
+      }
     }
   }
 }
 
 bool AddressSpace::copyInConcretes() {
+  // The external call may have written any object, including those which
+  // are not bound in this address space (e.g. through a dangling pointer).
+  // Only the objects compared below are known to match system memory.
+  forgetCopiedOutConcretes();
+
   for (MemoryMap::iterator it = objects.begin(), ie = objects.end(); 
        it != ie; ++it) {
     const MemoryObject *mo = it->first;
@@ -315,20 +349,30 @@ bool AddressSpace::copyInConcretes() {
       const ObjectState *os = it->second;
       uint8_t *address = (uint8_t*) (unsigned long) mo->address;
 
-      if (memcmp(address, os->concreteStore, mo->size)!=0) {
+      if (!os->concreteEquals(address)) {
         if (os->readOnly) {
           return false;
         } else {
           ObjectState *wos = getWriteable(mo, os);
-          memcpy(wos->concreteStore, address, mo->size);
+          wos->copyConcreteFrom(address);
+          os = wos;
         }
       }
+      if (!os->readOnly) {
+        if (os->storeVersion < minValidStoreVersion)
+          os->storeVersion = ++lastStoreVersion;
+        mo->copiedOutVersion = os->storeVersion;
+      }
     }
   }
 
   return true;
 }
 
+void AddressSpace::forgetCopiedOutConcretes() {
+  minValidStoreVersion = ++lastStoreVersion;
+}
+
 /***/
 
 bool MemoryObjectLT::operator()(const MemoryObject *a, const MemoryObject *b) const {
@@ -38,6 +38,11 @@ namespace klee {
     /// Epoch counter used to control ownership of objects.
     mutable unsigned cowKey;
 
+    /// Last store version handed out to an object state, and the oldest
+    /// one which still describes the system memory, see copyOutConcretes().
+    static uint64_t lastStoreVersion;
+    static uint64_t minValidStoreVersion;
+
     /// Unsupported, use copy constructor
     AddressSpace &operator=(const AddressSpace&); 
     
@@ -100,6 +105,16 @@ namespace klee {
     /// Lookup a binding from a MemoryObject.
     const ObjectState *findObject(const MemoryObject *mo) const;
 
+    /// Is the bound object state \a os owned by this address space, i.e.
+    /// was it bound or copied for writing since the address space was last
+    /// copied. Owned object states are not shared with other address spaces.
+    bool owns(const ObjectState *os) const;
+
+    /// Get the number of bytes which are freed when this address space is
+    /// deleted, i.e. which are taken by the object states only it refers
+    /// to.
+    uint64_t getOwnedBytes() const;
+
     /// \brief Obtain an ObjectState suitable for writing.
     ///
     /// This returns a writeable object state, creating a new copy of
@@ -122,9 +137,18 @@ namespace klee {
     /// potentially copied) if the memory values are different from
     /// the current concrete values.
     ///
+    /// As the external call may have written objects which are not bound
+    /// in this address space, the versions recorded by copyOutConcretes()
+    /// are kept only for the objects of this address space.
+    ///
     /// \retval true The copy succeeded. 
     /// \retval false The copy failed because a read-only object was modified.
     bool copyInConcretes();
+
+    /// Forget which contents were last copied out, for when system memory
+    /// may have been modified without copying it back in (e.g. after a
+    /// failed external call).
+    static void forgetCopiedOutConcretes();
   };
 } // End klee namespace
 
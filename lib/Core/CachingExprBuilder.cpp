@@ -0,0 +1,338 @@
+//===-- CachingExprBuilder.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CachingExprBuilder.h"
+#include "CoreStats.h"
+
+#include "klee/ExprBuilder.h"
+
+#include <ciso646>
+#ifdef _LIBCPP_VERSION
+#include <unordered_map>
+#define unordered_map std::unordered_map
+#else
+#include <tr1/unordered_map>
+#define unordered_map std::tr1::unordered_map
+#endif
+
+using namespace klee;
+
+namespace {
+  /// Maximal number of remembered expressions, the cache is flushed when it
+  /// grows beyond this.
+  const unsigned MaxCachedExprs = 65536;
+
+  /// The arguments of a build.
+  struct BuildKey {
+    Expr::Kind kind;
+    ref<Expr> kids[3];
+    unsigned attributes[2];
+    /// The updates of a read, whose nodes are compared by address.
+    UpdateList updates;
+
+    BuildKey(Expr::Kind _kind, const ref<Expr> &a, const ref<Expr> &b = 0,
+             const ref<Expr> &c = 0, unsigned attribute0 = 0,
+             unsigned attribute1 = 0, const UpdateList &_updates =
+                                          UpdateList(0, 0))
+      : kind(_kind), updates(_updates) {
+      kids[0] = a;
+      kids[1] = b;
+      kids[2] = c;
+      attributes[0] = attribute0;
+      attributes[1] = attribute1;
+    }
+
+    static bool isSameKid(const ref<Expr> &a, const ref<Expr> &b) {
+      if (a.get() == b.get())
+        return true;
+      return isa<ConstantExpr>(a) && isa<ConstantExpr>(b) && a == b;
+    }
+
+    bool operator==(const BuildKey &b) const {
+      return kind == b.kind && attributes[0] == b.attributes[0] &&
+             attributes[1] == b.attributes[1] &&
+             updates.root == b.updates.root &&
+             updates.head == b.updates.head && isSameKid(kids[0], b.kids[0]) &&
+             isSameKid(kids[1], b.kids[1]) && isSameKid(kids[2], b.kids[2]);
+    }
+  };
+
+  struct BuildKeyHash {
+    static unsigned hashKid(const ref<Expr> &e) {
+      if (e.isNull())
+        return 0;
+      if (isa<ConstantExpr>(e))
+        return e->hash();
+      return (unsigned) (uintptr_t) e.get() >> 3;
+    }
+
+    unsigned operator()(const BuildKey &key) const {
+      unsigned result = key.kind;
+      for (unsigned i = 0; i != 3; ++i)
+        result = result * Expr::MAGIC_HASH_CONSTANT ^ hashKid(key.kids[i]);
+      result = result * Expr::MAGIC_HASH_CONSTANT ^ key.attributes[0];
+      result = result * Expr::MAGIC_HASH_CONSTANT ^ key.attributes[1];
+      result ^= (unsigned) (uintptr_t) key.updates.head >> 3;
+      return result;
+    }
+  };
+
+  class CachingExprBuilder : public ExprBuilder {
+    typedef unordered_map<BuildKey, ref<Expr>, BuildKeyHash> cache_map;
+
+    ExprBuilder *Base;
+    cache_map cache;
+
+    ref<Expr> *lookup(const BuildKey &key) {
+      cache_map::iterator it = cache.find(key);
+      if (it == cache.end()) {
+        ++stats::exprBuilderCacheMisses;
+        return 0;
+      }
+      ++stats::exprBuilderCacheHits;
+      return &it->second;
+    }
+
+    ref<Expr> insert(const BuildKey &key, const ref<Expr> &result) {
+      if (cache.size() >= MaxCachedExprs)
+        cache.clear();
+      cache.insert(std::make_pair(key, result));
+      return result;
+    }
+
+  public:
+    CachingExprBuilder(ExprBuilder *_Base) : Base(_Base) {}
+    ~CachingExprBuilder() { delete Base; }
+
+    virtual ref<Expr> Constant(const llvm::APInt &Value) {
+      return Base->Constant(Value);
+    }
+
+    virtual ref<Expr> NotOptimized(const ref<Expr> &Index) {
+      return Base->NotOptimized(Index);
+    }
+
+    virtual ref<Expr> Read(const UpdateList &Updates,
+                           const ref<Expr> &Index) {
+      BuildKey key(Expr::Read, Index, 0, 0, 0, 0, Updates);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Read(Updates, Index));
+    }
+
+    virtual ref<Expr> Select(const ref<Expr> &Cond,
+                             const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Select, Cond, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Select(Cond, LHS, RHS));
+    }
+
+    virtual ref<Expr> Concat(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Concat, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Concat(LHS, RHS));
+    }
+
+    virtual ref<Expr> Extract(const ref<Expr> &LHS,
+                              unsigned Offset, Expr::Width W) {
+      BuildKey key(Expr::Extract, LHS, 0, 0, Offset, W);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Extract(LHS, Offset, W));
+    }
+
+    virtual ref<Expr> ZExt(const ref<Expr> &LHS, Expr::Width W) {
+      BuildKey key(Expr::ZExt, LHS, 0, 0, W);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->ZExt(LHS, W));
+    }
+
+    virtual ref<Expr> SExt(const ref<Expr> &LHS, Expr::Width W) {
+      BuildKey key(Expr::SExt, LHS, 0, 0, W);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->SExt(LHS, W));
+    }
+
+    virtual ref<Expr> Not(const ref<Expr> &LHS) {
+      BuildKey key(Expr::Not, LHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Not(LHS));
+    }
+
+    virtual ref<Expr> Add(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Add, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Add(LHS, RHS));
+    }
+
+    virtual ref<Expr> Sub(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Sub, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Sub(LHS, RHS));
+    }
+
+    virtual ref<Expr> Mul(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Mul, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Mul(LHS, RHS));
+    }
+
+    virtual ref<Expr> UDiv(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::UDiv, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->UDiv(LHS, RHS));
+    }
+
+    virtual ref<Expr> SDiv(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::SDiv, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->SDiv(LHS, RHS));
+    }
+
+    virtual ref<Expr> URem(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::URem, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->URem(LHS, RHS));
+    }
+
+    virtual ref<Expr> SRem(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::SRem, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->SRem(LHS, RHS));
+    }
+
+    virtual ref<Expr> And(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::And, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->And(LHS, RHS));
+    }
+
+    virtual ref<Expr> Or(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Or, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Or(LHS, RHS));
+    }
+
+    virtual ref<Expr> Xor(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Xor, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Xor(LHS, RHS));
+    }
+
+    virtual ref<Expr> Shl(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Shl, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Shl(LHS, RHS));
+    }
+
+    virtual ref<Expr> LShr(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::LShr, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->LShr(LHS, RHS));
+    }
+
+    virtual ref<Expr> AShr(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::AShr, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->AShr(LHS, RHS));
+    }
+
+    virtual ref<Expr> Eq(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Eq, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Eq(LHS, RHS));
+    }
+
+    virtual ref<Expr> Ne(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Ne, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Ne(LHS, RHS));
+    }
+
+    virtual ref<Expr> Ult(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Ult, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Ult(LHS, RHS));
+    }
+
+    virtual ref<Expr> Ule(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Ule, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Ule(LHS, RHS));
+    }
+
+    virtual ref<Expr> Ugt(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Ugt, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Ugt(LHS, RHS));
+    }
+
+    virtual ref<Expr> Uge(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Uge, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Uge(LHS, RHS));
+    }
+
+    virtual ref<Expr> Slt(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Slt, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Slt(LHS, RHS));
+    }
+
+    virtual ref<Expr> Sle(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Sle, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Sle(LHS, RHS));
+    }
+
+    virtual ref<Expr> Sgt(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Sgt, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Sgt(LHS, RHS));
+    }
+
+    virtual ref<Expr> Sge(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      BuildKey key(Expr::Sge, LHS, RHS);
+      if (ref<Expr> *cached = lookup(key))
+        return *cached;
+      return insert(key, Base->Sge(LHS, RHS));
+    }
+  };
+}
+
+ExprBuilder *klee::createCachingExprBuilder(ExprBuilder *Base) {
+  return new CachingExprBuilder(Base);
+}
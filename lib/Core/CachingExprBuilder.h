@@ -0,0 +1,30 @@
+//===-- CachingExprBuilder.h ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CACHINGEXPRBUILDER_H
+#define KLEE_CACHINGEXPRBUILDER_H
+
+namespace klee {
+  class ExprBuilder;
+
+  /// createCachingExprBuilder - Create an expression builder which remembers
+  /// the expressions built by a base builder and returns them again when
+  /// asked for an expression of the same kind, kids and attributes, instead
+  /// of redoing the folds of the base builder. Kids are compared by address,
+  /// except for constants, which are compared by value.
+  ///
+  /// Lookups are counted by the ExprBuilderCacheHits and
+  /// ExprBuilderCacheMisses statistics.
+  ///
+  /// Base - The base builder to use when constructing expressions, which is
+  /// owned by the new builder.
+  ExprBuilder *createCachingExprBuilder(ExprBuilder *Base);
+}
+
+#endif
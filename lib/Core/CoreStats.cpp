@@ -13,6 +13,9 @@ using namespace klee;
 
 Statistic stats::allocations("Allocations", "Alloc");
 Statistic stats::coveredInstructions("CoveredInstructions", "Icov");
+Statistic stats::exprBuilderCacheHits("ExprBuilderCacheHits", "EBhits");
+Statistic stats::exprBuilderCacheMisses("ExprBuilderCacheMisses",
+                                         "EBmisses");
 Statistic stats::falseBranches("FalseBranches", "Bf");
 Statistic stats::forkTime("ForkTime", "Ftime");
 Statistic stats::forks("Forks", "Forks");
@@ -27,6 +27,11 @@ namespace stats {
   extern Statistic forkTime;
   extern Statistic solverTime;
 
+  /// Lookups of expressions in the cache of the executor's expression
+  /// builder, see --cache-expr-builds.
+  extern Statistic exprBuilderCacheHits;
+  extern Statistic exprBuilderCacheMisses;
+
   /// The number of process forks.
   extern Statistic forks;
 
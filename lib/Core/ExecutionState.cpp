@@ -45,7 +45,7 @@ namespace {
 StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
   : caller(_caller), kf(_kf), callPathNode(0), 
     minDistToUncoveredOnReturn(0), varargs(0) {
-  locals = new Cell[kf->numRegisters];
+  locals = new Locals(kf->numRegisters);
 }
 
 StackFrame::StackFrame(const StackFrame &s) 
@@ -53,15 +53,64 @@ StackFrame::StackFrame(const StackFrame &s)
     kf(s.kf),
     callPathNode(s.callPathNode),
     allocas(s.allocas),
+    locals(s.locals),
     minDistToUncoveredOnReturn(s.minDistToUncoveredOnReturn),
     varargs(s.varargs) {
-  locals = new Cell[s.kf->numRegisters];
-  for (unsigned i=0; i<s.kf->numRegisters; i++)
-    locals[i] = s.locals[i];
+  ++locals->refCount;
 }
 
 StackFrame::~StackFrame() { 
-  delete[] locals; 
+  releaseLocals();
+}
+
+StackFrame &StackFrame::operator=(const StackFrame &s) {
+  ++s.locals->refCount;
+  releaseLocals();
+  caller = s.caller;
+  kf = s.kf;
+  callPathNode = s.callPathNode;
+  allocas = s.allocas;
+  locals = s.locals;
+  minDistToUncoveredOnReturn = s.minDistToUncoveredOnReturn;
+  varargs = s.varargs;
+  return *this;
+}
+
+void StackFrame::copyLocals() {
+  Locals *copy = new Locals(kf->numRegisters);
+  std::copy(locals->cells, locals->cells + kf->numRegisters, copy->cells);
+  releaseLocals();
+  locals = copy;
+}
+
+void StackFrame::releaseLocals() {
+  if (--locals->refCount == 0)
+    delete locals;
+}
+
+Symbolic::Symbolic(const MemoryObject *mo, const Array *array)
+  : first(mo), second(array) {
+  ++first->refCount;
+}
+
+Symbolic::Symbolic(const Symbolic &b) : first(b.first), second(b.second) {
+  if (first)
+    ++first->refCount;
+}
+
+Symbolic::~Symbolic() {
+  if (first && --first->refCount == 0)
+    delete first;
+}
+
+Symbolic &Symbolic::operator=(const Symbolic &b) {
+  if (b.first)
+    ++b.first->refCount;
+  if (first && --first->refCount == 0)
+    delete first;
+  first = b.first;
+  second = b.second;
+  return *this;
 }
 
 /***/
@@ -78,24 +127,20 @@ ExecutionState::ExecutionState(KFunction *kf) :
     instsSinceCovNew(0),
     coveredNew(false),
     forkDisabled(false),
-    ptreeNode(0) {
+    replayPathPosition(0),
+    ptreeNode(0),
+    stateIndex(NotRegistered) {
   pushFrame(0, kf);
 }
 
 ExecutionState::ExecutionState(const std::vector<ref<Expr> > &assumptions)
-    : constraints(assumptions), queryCost(0.), relationToTarget(notRelevant), ptreeNode(0) {}
+    : constraints(assumptions), queryCost(0.), relationToTarget(notRelevant), ptreeNode(0),
+      stateIndex(NotRegistered) {}
 
 ExecutionState::~ExecutionState() {
-  for (unsigned int i=0; i<symbolics.size(); i++)
-  {
-    const MemoryObject *mo = symbolics[i].first;
-    assert(mo->refCount > 0);
-    mo->refCount--;
-    if (mo->refCount == 0)
-      delete mo;
-  }
-
-  while (!stack.empty()) popFrame();
+  // The address space is released as a whole together with the state, so
+  // there is no need to unbind the allocas of every frame one by one.
+  stack.clear();
 }
 
 ExecutionState::ExecutionState(const ExecutionState& state):
@@ -119,13 +164,13 @@ ExecutionState::ExecutionState(const ExecutionState& state):
     instsSinceCovNew(state.instsSinceCovNew),
     coveredNew(state.coveredNew),
     forkDisabled(state.forkDisabled),
-    coveredLines(state.coveredLines),
+    replayPathPosition(state.replayPathPosition),
+    coveredInstructions(state.coveredInstructions),
     ptreeNode(state.ptreeNode),
+    stateIndex(NotRegistered),
     symbolics(state.symbolics),
     arrayNames(state.arrayNames)
 {
-  for (unsigned int i=0; i<symbolics.size(); i++)
-    symbolics[i].first->refCount++;
 }
 
 ExecutionState *ExecutionState::branch() {
@@ -133,7 +178,7 @@ ExecutionState *ExecutionState::branch() {
 
   ExecutionState *falseState = new ExecutionState(*this);
   falseState->coveredNew = false;
-  falseState->coveredLines.clear();
+  falseState->coveredInstructions.clear();
 
   weight *= .5;
   falseState->weight -= weight;
@@ -157,24 +202,22 @@ void ExecutionState::popFrame() {
 }
 
 void ExecutionState::addSymbolic(const MemoryObject *mo, const Array *array) { 
-  mo->refCount++;
-  symbolics.push_back(std::make_pair(mo, array));
+  symbolics.push_back(Symbolic(mo, array));
 }
 ///
 
 std::string ExecutionState::getFnAlias(std::string fn) {
-  std::map < std::string, std::string >::iterator it = fnAliases.find(fn);
-  if (it != fnAliases.end())
-    return it->second;
+  if (const std::pair<std::string, std::string> *alias = fnAliases.lookup(fn))
+    return alias->second;
   else return "";
 }
 
 void ExecutionState::addFnAlias(std::string old_fn, std::string new_fn) {
-  fnAliases[old_fn] = new_fn;
+  fnAliases = fnAliases.replace(std::make_pair(old_fn, new_fn));
 }
 
 void ExecutionState::removeFnAlias(std::string fn) {
-  fnAliases.erase(fn);
+  fnAliases = fnAliases.remove(fn);
 }
 
 /**/
@@ -319,13 +362,13 @@ bool ExecutionState::merge(const ExecutionState &b) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
-      const ref<Expr> &bv = bf.locals[i].value;
+      ref<Expr> av = af.getLocal(i).getValue();
+      ref<Expr> bv = bf.getLocal(i).getValue();
       if (av.isNull() || bv.isNull()) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
       } else {
-        av = SelectExpr::create(inA, av, bv);
+        af.getWriteableLocal(i).setValue(SelectExpr::create(inA, av, bv));
       }
     }
   }
@@ -378,7 +421,7 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
 
       out << ai->getName().str();
       // XXX should go through function
-      ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].value;
+      ref<Expr> value = sf.getLocal(sf.kf->getArgRegister(index++)).getValue();
       if (value.get() && isa<ConstantExpr>(value))
         out << "=" << value;
     }
@@ -9,15 +9,18 @@
 
 #include "Executor.h"
 #include "Context.h"
+#include "CachingExprBuilder.h"
 #include "CoreStats.h"
 #include "ExternalDispatcher.h"
 #include "ImpliedValue.h"
 #include "Memory.h"
 #include "MemoryManager.h"
+#include "PageStore.h"
 #include "PTree.h"
 #include "Searcher.h"
 #include "SeedInfo.h"
 #include "SpecialFunctionHandler.h"
+#include "StateSpiller.h"
 #include "StatsTracker.h"
 #include "TimingSolver.h"
 #include "UserSearcher.h"
@@ -26,6 +29,7 @@
 
 #include "klee/ExecutionState.h"
 #include "klee/Expr.h"
+#include "klee/ExprBuilder.h"
 #include "klee/Interpreter.h"
 #include "klee/TimerStatIncrementer.h"
 #include "klee/CommandLine.h"
@@ -44,9 +48,11 @@
 #include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/Internal/Support/FloatEvaluation.h"
+#include "klee/Internal/Support/IntEvaluation.h"
 #include "klee/Internal/Support/ModuleUtil.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/System/MemoryUsage.h"
+#include "klee/SolverImpl.h"
 #include "klee/SolverStats.h"
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
@@ -95,6 +101,8 @@
 #endif
 
 #include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <algorithm>
 #include <iomanip>
 #include <iosfwd>
@@ -121,6 +129,11 @@ namespace {
                    cl::init(true),
 		   cl::desc("Dump test cases for all active states on exit (default=on)"));
   
+  cl::opt<bool>
+  CacheExprBuilds("cache-expr-builds",
+                  cl::init(false),
+                  cl::desc("Remember the expressions built for instructions and reuse them when an instruction is executed again on the same operands (default=off)"));
+
   cl::opt<bool>
   AllowExternalSymCalls("allow-external-sym-calls",
                         cl::init(false),
@@ -167,6 +180,15 @@ namespace {
   cl::opt<bool>
   DebugCheckForImpliedValues("debug-check-for-implied-values");
 
+  cl::opt<bool>
+  LazyGlobalInit("lazy-global-init",
+                 cl::init(true),
+                 cl::desc("Compute the contents of global objects on first access (default=on)"));
+
+  cl::opt<bool>
+  ConcreteFastPath("concrete-fast-path",
+                   cl::init(true),
+                   cl::desc("Execute integer arithmetic, comparisons and casts on concrete operands without building expressions (default=on)"));
 
   cl::opt<bool>
   SimplifySymIndices("simplify-sym-indices",
@@ -182,6 +204,11 @@ namespace {
   MaxSymArraySize("max-sym-array-size",
                   cl::init(0));
 
+  cl::opt<unsigned>
+  MaxSymSizeAlloc("max-sym-size-alloc",
+                  cl::init(0),
+                  cl::desc("Allocate objects whose symbolic size is bounded by this many bytes as a single object of symbolic size, instead of concretizing the size (default=0 (off))"));
+
   cl::opt<bool>
   SuppressExternalWarnings("suppress-external-warnings",
 			   cl::init(false),
@@ -308,6 +335,11 @@ namespace {
            cl::desc("Only fork this many times (default=-1 (off))"),
            cl::init(~0u));
   
+  cl::opt<unsigned>
+  DonateStatesAt("donate-states-at",
+                 cl::desc("Give away half of the states once there are this many, as if asked to by the coordinator of --coordinate-workers (for testing, default=0 (off))"),
+                 cl::init(0));
+
   cl::opt<unsigned>
   MaxDepth("max-depth",
            cl::desc("Only allow this many symbolic branches (default=0 (off))"),
@@ -322,6 +354,32 @@ namespace {
   MaxMemoryInhibit("max-memory-inhibit",
             cl::desc("Inhibit forking at memory cap (vs. random terminate) (default=on)"),
             cl::init(true));
+
+  cl::opt<bool>
+  SpillStates("spill-states",
+              cl::desc("Write states to disk at memory cap, and read them back when they are selected, rather than inhibit forking or terminate states (default=off)"),
+              cl::init(false));
+
+  enum EvictionPolicy {
+    EvictBySearcher,
+    EvictByMemory,
+    EvictRandomly
+  };
+
+  cl::opt<EvictionPolicy>
+  EvictStates("evict-states",
+              cl::desc("Choose the states to spill or terminate at memory cap (default=searcher)"),
+              cl::values(
+                clEnumValN(EvictBySearcher, "searcher",
+                           "The states least useful to the searcher, or else "
+                           "the ones holding the most memory"),
+                clEnumValN(EvictByMemory, "memory",
+                           "The states holding the most memory"),
+                clEnumValN(EvictRandomly, "random",
+                           "Random states, preferring the ones which did not "
+                           "cover new code"),
+                clEnumValEnd),
+              cl::init(EvictBySearcher));
 }
 
 
@@ -349,8 +407,12 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
     : Interpreter(opts), kmodule(0), interpreterHandler(ih), searcher(0),
       externalDispatcher(new ExternalDispatcher(ctx)), statsTracker(0),
       pathWriter(0), symPathWriter(0), specialFunctionHandler(0),
-      processTree(0), replayKTest(0), replayPath(0), usingSeeds(0),
-      atMemoryLimit(false), inhibitForking(false), haltExecution(false),
+      processTree(0), replayKTest(0), replayPath(0), replayPathPrefix(false),
+      usingSeeds(0),
+      atMemoryLimit(false), unaccountedMemoryUsage(0),
+      lastMemoryMeasurement(0), spiller(0), inhibitForking(false),
+      haltExecution(false),
+      donationRequested(false), donatedAtThreshold(false),
       ivcEnabled(false),
       coreSolverTimeout(MaxCoreSolverTime != 0 && MaxInstructionTime != 0
                             ? std::min(MaxCoreSolverTime, MaxInstructionTime)
@@ -373,6 +435,19 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
   this->solver = new TimingSolver(solver, EqualitySubstitution);
   memory = new MemoryManager(&arrayCache);
 
+  exprBuilder = createCanonicalExprBuilder();
+  if (CacheExprBuilds)
+    exprBuilder = createCachingExprBuilder(exprBuilder);
+
+  if (SpillStates) {
+    spiller = new StateSpiller(
+        interpreterHandler->getOutputFilename("states.spill"));
+    if (!spiller->isOpen()) {
+      delete spiller;
+      spiller = 0;
+    }
+  }
+
   if (optionIsSet(DebugPrintInstructions, FILE_ALL) ||
       optionIsSet(DebugPrintInstructions, FILE_COMPACT) ||
       optionIsSet(DebugPrintInstructions, FILE_SRC)) {
@@ -436,7 +511,10 @@ const Module *Executor::setModule(llvm::Module *module,
 }
 
 Executor::~Executor() {
+  // Spilled states may hold the last references to memory objects.
+  delete spiller;
   delete memory;
+  delete exprBuilder;
   delete externalDispatcher;
   if (processTree)
     delete processTree;
@@ -457,8 +535,24 @@ Executor::~Executor() {
 
 /***/
 
-void Executor::initializeGlobalObject(ExecutionState &state, ObjectState *os,
-                                      const Constant *c, 
+namespace klee {
+  /// Computes the contents of a global object from its initializer when
+  /// the object is first accessed.
+  class GlobalObjectInitializer : public ObjectInitializer {
+    Executor &executor;
+    const Constant *initializer;
+
+  public:
+    GlobalObjectInitializer(Executor &_executor, const Constant *_initializer)
+      : executor(_executor), initializer(_initializer) {}
+
+    void initialize(ObjectState *os) const {
+      executor.initializeGlobalObject(os, initializer, 0);
+    }
+  };
+}
+
+void Executor::initializeGlobalObject(ObjectState *os, const Constant *c,
                                       unsigned offset) {
 #if LLVM_VERSION_CODE <= LLVM_VERSION(3, 1)
   TargetData *targetData = kmodule->targetData;
@@ -469,7 +563,7 @@ void Executor::initializeGlobalObject(ExecutionState &state, ObjectState *os,
     unsigned elementSize =
       targetData->getTypeStoreSize(cp->getType()->getElementType());
     for (unsigned i=0, e=cp->getNumOperands(); i != e; ++i)
-      initializeGlobalObject(state, os, cp->getOperand(i), 
+      initializeGlobalObject(os, cp->getOperand(i), 
 			     offset + i*elementSize);
   } else if (isa<ConstantAggregateZero>(c)) {
     unsigned i, size = targetData->getTypeStoreSize(c->getType());
@@ -479,13 +573,13 @@ void Executor::initializeGlobalObject(ExecutionState &state, ObjectState *os,
     unsigned elementSize =
       targetData->getTypeStoreSize(ca->getType()->getElementType());
     for (unsigned i=0, e=ca->getNumOperands(); i != e; ++i)
-      initializeGlobalObject(state, os, ca->getOperand(i), 
+      initializeGlobalObject(os, ca->getOperand(i), 
 			     offset + i*elementSize);
   } else if (const ConstantStruct *cs = dyn_cast<ConstantStruct>(c)) {
     const StructLayout *sl =
       targetData->getStructLayout(cast<StructType>(cs->getType()));
     for (unsigned i=0, e=cs->getNumOperands(); i != e; ++i)
-      initializeGlobalObject(state, os, cs->getOperand(i), 
+      initializeGlobalObject(os, cs->getOperand(i), 
 			     offset + sl->getElementOffset(i));
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 1)
   } else if (const ConstantDataSequential *cds =
@@ -493,7 +587,7 @@ void Executor::initializeGlobalObject(ExecutionState &state, ObjectState *os,
     unsigned elementSize =
       targetData->getTypeStoreSize(cds->getElementType());
     for (unsigned i=0, e=cds->getNumElements(); i != e; ++i)
-      initializeGlobalObject(state, os, cds->getElementAsConstant(i),
+      initializeGlobalObject(os, cds->getElementAsConstant(i),
                              offset + i*elementSize);
 #endif
   } else if (!isa<UndefValue>(c)) {
@@ -657,12 +751,22 @@ void Executor::initializeGlobals(ExecutionState &state) {
                                           /*alignment=*/globalObjectAlignment);
       if (!mo)
         llvm::report_fatal_error("out of memory");
-      ObjectState *os = bindObjectInState(state, mo, false);
       globalObjects.insert(std::make_pair(v, mo));
       globalAddresses.insert(std::make_pair(v, mo->getBaseExpr()));
 
-      if (!i->hasInitializer())
-          os->initializeToRandom();
+      if (!i->hasInitializer()) {
+        ObjectState *os = bindObjectInState(state, mo, false);
+        os->initializeToRandom();
+      } else if (LazyGlobalInit) {
+        // The initializer may refer to the addresses of other globals,
+        // these are all known by the time the object is first accessed.
+        ObjectInitializer *init =
+            new GlobalObjectInitializer(*this, i->getInitializer());
+        globalInitializers.push_back(init);
+        state.addressSpace.bindObject(mo, new ObjectState(mo, init));
+      } else {
+        bindObjectInState(state, mo, false);
+      }
     }
   }
   
@@ -675,6 +779,9 @@ void Executor::initializeGlobals(ExecutionState &state) {
 	  evalConstant(i->getAliasee())));
   }
 
+  if (LazyGlobalInit)
+    return;
+
   // once all objects are allocated, do the actual initialization
   for (Module::const_global_iterator i = m->global_begin(),
          e = m->global_end();
@@ -686,7 +793,7 @@ void Executor::initializeGlobals(ExecutionState &state) {
       assert(os);
       ObjectState *wos = state.addressSpace.getWriteable(mo, os);
       
-      initializeGlobalObject(state, wos, i->getInitializer(), 0);
+      initializeGlobalObject(wos, i->getInitializer(), 0);
       // if(i->isConstant()) os->setReadOnly(true);
     }
   }
@@ -699,7 +806,20 @@ void Executor::branch(ExecutionState &state,
   unsigned N = conditions.size();
   assert(N);
 
-  if (MaxForks!=~0u && stats::forks >= MaxForks) {
+  if (replayPath && !seedMap.count(&state) &&
+      (!replayPathPrefix || state.replayPathPosition < replayPath->size())) {
+    // The path records the condition taken, see recordBranch().
+    unsigned taken = 0;
+    while (taken + 1 != N) {
+      assert(state.replayPathPosition < replayPath->size() &&
+             "ran out of branches in replay path mode");
+      if ((*replayPath)[state.replayPathPosition++])
+        break;
+      ++taken;
+    }
+    for (unsigned i=0; i<N; ++i)
+      result.push_back(i == taken ? &state : NULL);
+  } else if (MaxForks!=~0u && stats::forks >= MaxForks) {
     unsigned next = theRNG.getInt32() % N;
     for (unsigned i=0; i<N; ++i) {
       if (i == next) {
@@ -716,6 +836,11 @@ void Executor::branch(ExecutionState &state,
     for (unsigned i=1; i<N; ++i) {
       ExecutionState *es = result[theRNG.getInt32() % i];
       ExecutionState *ns = es->branch();
+      // Give the new state its own path, see fork().
+      if (pathWriter)
+        ns->pathOS = pathWriter->open(es->pathOS);
+      if (symPathWriter)
+        ns->symPathOS = symPathWriter->open(es->symPathOS);
       addedStates.push_back(ns);
       result.push_back(ns);
       es->ptreeNode->data = 0;
@@ -773,9 +898,23 @@ void Executor::branch(ExecutionState &state,
     }
   }
 
-  for (unsigned i=0; i<N; ++i)
-    if (result[i])
+  for (unsigned i=0; i<N; ++i) {
+    if (result[i]) {
+      if (pathWriter)
+        recordBranch(*result[i], i, N);
       addConstraint(*result[i], conditions[i]);
+    }
+  }
+}
+
+void Executor::recordBranch(ExecutionState &state, unsigned taken,
+                            unsigned n) {
+  // As a sequence of the two-way branches "is it the first condition", "is
+  // it the second condition", ..., where the last one is implied.
+  for (unsigned i = 0; i != taken; ++i)
+    state.pathOS << "0";
+  if (taken + 1 != n)
+    state.pathOS << "1";
 }
 
 Executor::StatePair 
@@ -825,10 +964,12 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   }
 
   if (!isSeeding) {
-    if (replayPath && !isInternal) {
-      assert(replayPosition<replayPath->size() &&
+    if (replayPath &&
+        (!replayPathPrefix ||
+         current.replayPathPosition < replayPath->size())) {
+      assert(current.replayPathPosition<replayPath->size() &&
              "ran out of branches in replay path mode");
-      bool branch = (*replayPath)[replayPosition++];
+      bool branch = (*replayPath)[current.replayPathPosition++];
       
       if (res==Solver::True) {
         assert(branch && "hit invalid branch in replay path mode");
@@ -912,18 +1053,14 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   // hint to just use the single constraint instead of all the binary
   // search ones. If that makes sense.
   if (res==Solver::True) {
-    if (!isInternal) {
-      if (pathWriter) {
-        current.pathOS << "1";
-      }
+    if (pathWriter) {
+      current.pathOS << "1";
     }
 
     return StatePair(&current, 0);
   } else if (res==Solver::False) {
-    if (!isInternal) {
-      if (pathWriter) {
-        current.pathOS << "0";
-      }
+    if (pathWriter) {
+      current.pathOS << "0";
     }
 
     return StatePair(0, &current);
@@ -966,7 +1103,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       }
       if (swapInfo) {
         std::swap(trueState->coveredNew, falseState->coveredNew);
-        std::swap(trueState->coveredLines, falseState->coveredLines);
+        trueState->coveredInstructions.swap(falseState->coveredInstructions);
       }
     }
 
@@ -979,11 +1116,11 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     if (pathWriter) {
       // Need to update the pathOS.id field of falseState, otherwise the same id
       // is used for both falseState and trueState.
+      // Internal forks are recorded as well, so that the path tells the
+      // two states apart.
       falseState->pathOS = pathWriter->open(current.pathOS);
-      if (!isInternal) {
-        trueState->pathOS << "1";
-        falseState->pathOS << "0";
-      }
+      trueState->pathOS << "1";
+      falseState->pathOS << "0";
     }
     if (symPathWriter) {
       falseState->symPathOS = symPathWriter->open(current.symPathOS);
@@ -1117,18 +1254,18 @@ const Cell& Executor::eval(KInstruction *ki, unsigned index,
   } else {
     unsigned index = vnumber;
     StackFrame &sf = state.stack.back();
-    return sf.locals[index];
+    return sf.getLocal(index);
   }
 }
 
 void Executor::bindLocal(KInstruction *target, ExecutionState &state, 
                          ref<Expr> value) {
-  getDestCell(state, target).value = value;
+  getDestCell(state, target).setValue(value);
 }
 
 void Executor::bindArgument(KFunction *kf, unsigned index, 
                             ExecutionState &state, ref<Expr> value) {
-  getArgumentCell(state, kf, index).value = value;
+  getArgumentCell(state, kf, index).setValue(value);
 }
 
 ref<Expr> Executor::toUnique(const ExecutionState &state, 
@@ -1527,9 +1664,121 @@ static inline const llvm::fltSemantics * fpWidthToSemantics(unsigned width) {
   }
 }
 
+bool Executor::executeImmediateInstruction(ExecutionState &state,
+                                           KInstruction *ki) {
+  unsigned opcode = ki->opcode;
+
+  if (Instruction::isCast(opcode)) {
+    const Cell &src = eval(ki, 0, state);
+    if (!src.isImmediate())
+      return false;
+
+    Expr::Width outWidth = ki->width;
+
+    uint64_t v = src.getImmediate();
+    Expr::Width inWidth = src.getImmediateWidth();
+    switch (opcode) {
+    case Instruction::Trunc:
+      v = ints::trunc(v, outWidth, inWidth);
+      break;
+    case Instruction::SExt:
+      v = ints::sext(v, outWidth, inWidth);
+      break;
+    case Instruction::BitCast:
+      outWidth = inWidth;
+      break;
+    default:
+      // ZExt, and IntToPtr and PtrToInt which are zero extensions as
+      // well, see executeInstruction().
+      if (outWidth < inWidth)
+        v = ints::trunc(v, outWidth, inWidth);
+      break;
+    }
+    getDestCell(state, ki).setImmediate(v, outWidth);
+    return true;
+  }
+
+  const Cell &left = eval(ki, 0, state);
+  const Cell &right = eval(ki, 1, state);
+  if (!left.isImmediate() || !right.isImmediate())
+    return false;
+
+  uint64_t l = left.getImmediate(), r = right.getImmediate();
+  Expr::Width width = left.getImmediateWidth();
+  assert(width == right.getImmediateWidth() && "operand widths differ");
+
+  uint64_t result;
+  switch (opcode) {
+  case Instruction::Add: result = ints::add(l, r, width); break;
+  case Instruction::Sub: result = ints::sub(l, r, width); break;
+  case Instruction::Mul: result = ints::mul(l, r, width); break;
+  case Instruction::And: result = ints::land(l, r, width); break;
+  case Instruction::Or: result = ints::lor(l, r, width); break;
+  case Instruction::Xor: result = ints::lxor(l, r, width); break;
+
+  // Division by zero, signed overflow and oversized shifts are left to
+  // the expression library.
+  case Instruction::UDiv:
+  case Instruction::URem:
+  case Instruction::SDiv:
+  case Instruction::SRem:
+    if (r == 0 || (r == bits64::maxValueOfNBits(width) &&
+                   (opcode == Instruction::SDiv ||
+                    opcode == Instruction::SRem)))
+      return false;
+    switch (opcode) {
+    case Instruction::UDiv: result = ints::udiv(l, r, width); break;
+    case Instruction::URem: result = ints::urem(l, r, width); break;
+    case Instruction::SDiv: result = ints::sdiv(l, r, width); break;
+    default: result = ints::srem(l, r, width); break;
+    }
+    break;
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+    if (r >= width)
+      return false;
+    switch (opcode) {
+    case Instruction::Shl: result = ints::shl(l, r, width); break;
+    case Instruction::LShr: result = ints::lshr(l, r, width); break;
+    default: result = ints::ashr(l, r, width); break;
+    }
+    break;
+
+  case Instruction::ICmp:
+    switch (ki->predicate) {
+    case ICmpInst::ICMP_EQ: result = ints::eq(l, r, width); break;
+    case ICmpInst::ICMP_NE: result = ints::ne(l, r, width); break;
+    case ICmpInst::ICMP_UGT: result = ints::ugt(l, r, width); break;
+    case ICmpInst::ICMP_UGE: result = ints::uge(l, r, width); break;
+    case ICmpInst::ICMP_ULT: result = ints::ult(l, r, width); break;
+    case ICmpInst::ICMP_ULE: result = ints::ule(l, r, width); break;
+    case ICmpInst::ICMP_SGT: result = ints::sgt(l, r, width); break;
+    case ICmpInst::ICMP_SGE: result = ints::sge(l, r, width); break;
+    case ICmpInst::ICMP_SLT: result = ints::slt(l, r, width); break;
+    case ICmpInst::ICMP_SLE: result = ints::sle(l, r, width); break;
+    default:
+      return false;
+    }
+    width = Expr::Bool;
+    break;
+
+  default:
+    assert(0 && "unexpected immediate instruction");
+    return false;
+  }
+
+  getDestCell(state, ki).setImmediate(result, width);
+  return true;
+}
+
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   Instruction *i = ki->inst;
-  switch (i->getOpcode()) {
+  if (ConcreteFastPath && ki->isImmediateOp &&
+      executeImmediateInstruction(state, ki))
+    return;
+
+  switch (ki->opcode) {
     // Control flow
   case Instruction::Ret: {
     ReturnInst *ri = cast<ReturnInst>(i);
@@ -1539,7 +1788,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     ref<Expr> result = ConstantExpr::alloc(0, Expr::Bool);
     
     if (!isVoidReturn) {
-      result = eval(ki, 0, state).value;
+      result = eval(ki, 0, state).getValue();
     }
     
     if (state.stack.size() <= 1) {
@@ -1628,7 +1877,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       // FIXME: Find a way that we don't have this hidden dependency.
       assert(bi->getCondition() == bi->getOperand(0) &&
              "Wrong operand index!");
-      ref<Expr> cond = eval(ki, 0, state).value;
+      ref<Expr> cond = eval(ki, 0, state).getValue();
       Executor::StatePair branches = fork(state, cond, false);
 
       // NOTE: There is a hidden dependency here, markBranchVisited
@@ -1647,7 +1896,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
   case Instruction::Switch: {
     SwitchInst *si = cast<SwitchInst>(i);
-    ref<Expr> cond = eval(ki, 0, state).value;
+    ref<Expr> cond = eval(ki, 0, state).getValue();
     BasicBlock *bb = si->getParent();
 
     cond = toUnique(state, cond);
@@ -1800,7 +2049,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     arguments.reserve(numArgs);
 
     for (unsigned j=0; j<numArgs; ++j)
-      arguments.push_back(eval(ki, j+1, state).value);
+      arguments.push_back(eval(ki, j+1, state).getValue());
 
     if (f) {
       const FunctionType *fType = 
@@ -1847,7 +2096,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
       executeCall(state, ki, f, arguments);
     } else {
-      ref<Expr> v = eval(ki, 0, state).value;
+      ref<Expr> v = eval(ki, 0, state).getValue();
 
       ExecutionState *free = &state;
       bool hasInvalid = false, first = true;
@@ -1889,9 +2138,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
   case Instruction::PHI: {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 0)
-    ref<Expr> result = eval(ki, state.incomingBBIndex, state).value;
+    ref<Expr> result = eval(ki, state.incomingBBIndex, state).getValue();
 #else
-    ref<Expr> result = eval(ki, state.incomingBBIndex * 2, state).value;
+    ref<Expr> result = eval(ki, state.incomingBBIndex * 2, state).getValue();
 #endif
     bindLocal(ki, state, result);
     break;
@@ -1899,10 +2148,10 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     // Special instructions
   case Instruction::Select: {
-    ref<Expr> cond = eval(ki, 0, state).value;
-    ref<Expr> tExpr = eval(ki, 1, state).value;
-    ref<Expr> fExpr = eval(ki, 2, state).value;
-    ref<Expr> result = SelectExpr::create(cond, tExpr, fExpr);
+    ref<Expr> cond = eval(ki, 0, state).getValue();
+    ref<Expr> tExpr = eval(ki, 1, state).getValue();
+    ref<Expr> fExpr = eval(ki, 2, state).getValue();
+    ref<Expr> result = exprBuilder->Select(cond, tExpr, fExpr);
     bindLocal(ki, state, result);
     break;
   }
@@ -1914,102 +2163,102 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     // Arithmetic / logical
 
   case Instruction::Add: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, AddExpr::create(left, right));
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    bindLocal(ki, state, exprBuilder->Add(left, right));
     break;
   }
 
   case Instruction::Sub: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, SubExpr::create(left, right));
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    bindLocal(ki, state, exprBuilder->Sub(left, right));
     break;
   }
  
   case Instruction::Mul: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, MulExpr::create(left, right));
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    bindLocal(ki, state, exprBuilder->Mul(left, right));
     break;
   }
 
   case Instruction::UDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = UDivExpr::create(left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = exprBuilder->UDiv(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::SDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = SDivExpr::create(left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = exprBuilder->SDiv(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::URem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = URemExpr::create(left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = exprBuilder->URem(left, right);
     bindLocal(ki, state, result);
     break;
   }
  
   case Instruction::SRem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = SRemExpr::create(left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = exprBuilder->SRem(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::And: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = AndExpr::create(left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = exprBuilder->And(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::Or: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = OrExpr::create(left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = exprBuilder->Or(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::Xor: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = XorExpr::create(left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = exprBuilder->Xor(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::Shl: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = ShlExpr::create(left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = exprBuilder->Shl(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::LShr: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = LShrExpr::create(left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = exprBuilder->LShr(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::AShr: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> result = AShrExpr::create(left, right);
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
+    ref<Expr> result = exprBuilder->AShr(left, right);
     bindLocal(ki, state, result);
     break;
   }
@@ -2017,86 +2266,83 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     // Compare
 
   case Instruction::ICmp: {
-    CmpInst *ci = cast<CmpInst>(i);
-    ICmpInst *ii = cast<ICmpInst>(ci);
- 
-    switch(ii->getPredicate()) {
+    switch(ki->predicate) {
     case ICmpInst::ICMP_EQ: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = EqExpr::create(left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = exprBuilder->Eq(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_NE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = NeExpr::create(left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = exprBuilder->Ne(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_UGT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UgtExpr::create(left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = exprBuilder->Ugt(left, right);
       bindLocal(ki, state,result);
       break;
     }
 
     case ICmpInst::ICMP_UGE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UgeExpr::create(left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = exprBuilder->Uge(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_ULT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UltExpr::create(left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = exprBuilder->Ult(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_ULE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = UleExpr::create(left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = exprBuilder->Ule(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SGT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SgtExpr::create(left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = exprBuilder->Sgt(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SGE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SgeExpr::create(left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = exprBuilder->Sge(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SLT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SltExpr::create(left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = exprBuilder->Slt(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SLE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
-      ref<Expr> result = SleExpr::create(left, right);
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
+      ref<Expr> result = exprBuilder->Sle(left, right);
       bindLocal(ki, state, result);
       break;
     }
@@ -2114,87 +2360,79 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       kmodule->targetData->getTypeStoreSize(ai->getAllocatedType());
     ref<Expr> size = Expr::createPointer(elementSize);
     if (ai->isArrayAllocation()) {
-      ref<Expr> count = eval(ki, 0, state).value;
+      ref<Expr> count = eval(ki, 0, state).getValue();
       count = Expr::createZExtToPointerWidth(count);
-      size = MulExpr::create(size, count);
+      size = exprBuilder->Mul(size, count);
     }
     executeAlloc(state, size, true, ki);
     break;
   }
 
   case Instruction::Load: {
-    ref<Expr> base = eval(ki, 0, state).value;
+    ref<Expr> base = eval(ki, 0, state).getValue();
     executeMemoryOperation(state, false, base, 0, ki);
     break;
   }
   case Instruction::Store: {
-    ref<Expr> base = eval(ki, 1, state).value;
-    ref<Expr> value = eval(ki, 0, state).value;
+    ref<Expr> base = eval(ki, 1, state).getValue();
+    ref<Expr> value = eval(ki, 0, state).getValue();
     executeMemoryOperation(state, true, base, value, 0);
     break;
   }
 
   case Instruction::GetElementPtr: {
     KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
-    ref<Expr> base = eval(ki, 0, state).value;
+    ref<Expr> base = eval(ki, 0, state).getValue();
 
     for (std::vector< std::pair<unsigned, uint64_t> >::iterator 
            it = kgepi->indices.begin(), ie = kgepi->indices.end(); 
          it != ie; ++it) {
       uint64_t elementSize = it->second;
-      ref<Expr> index = eval(ki, it->first, state).value;
-      base = AddExpr::create(base,
-                             MulExpr::create(Expr::createSExtToPointerWidth(index),
-                                             Expr::createPointer(elementSize)));
+      ref<Expr> index = eval(ki, it->first, state).getValue();
+      base = exprBuilder->Add(base,
+                              exprBuilder->Mul(Expr::createSExtToPointerWidth(index),
+                                               Expr::createPointer(elementSize)));
     }
     if (kgepi->offset)
-      base = AddExpr::create(base,
-                             Expr::createPointer(kgepi->offset));
+      base = exprBuilder->Add(base,
+                              Expr::createPointer(kgepi->offset));
     bindLocal(ki, state, base);
     break;
   }
 
     // Conversion
   case Instruction::Trunc: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value,
-                                           0,
-                                           getWidthForLLVMType(ci->getType()));
+    ref<Expr> result = exprBuilder->Extract(eval(ki, 0, state).getValue(),
+                                            0, ki->width);
     bindLocal(ki, state, result);
     break;
   }
   case Instruction::ZExt: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
+    ref<Expr> result = exprBuilder->ZExt(eval(ki, 0, state).getValue(),
+                                         ki->width);
     bindLocal(ki, state, result);
     break;
   }
   case Instruction::SExt: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = SExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
+    ref<Expr> result = exprBuilder->SExt(eval(ki, 0, state).getValue(),
+                                         ki->width);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::IntToPtr: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width pType = getWidthForLLVMType(ci->getType());
-    ref<Expr> arg = eval(ki, 0, state).value;
-    bindLocal(ki, state, ZExtExpr::create(arg, pType));
+    ref<Expr> arg = eval(ki, 0, state).getValue();
+    bindLocal(ki, state, exprBuilder->ZExt(arg, ki->width));
     break;
   } 
   case Instruction::PtrToInt: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width iType = getWidthForLLVMType(ci->getType());
-    ref<Expr> arg = eval(ki, 0, state).value;
-    bindLocal(ki, state, ZExtExpr::create(arg, iType));
+    ref<Expr> arg = eval(ki, 0, state).getValue();
+    bindLocal(ki, state, exprBuilder->ZExt(arg, ki->width));
     break;
   }
 
   case Instruction::BitCast: {
-    ref<Expr> result = eval(ki, 0, state).value;
+    ref<Expr> result = eval(ki, 0, state).getValue();
     bindLocal(ki, state, result);
     break;
   }
@@ -2202,9 +2440,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     // Floating point instructions
 
   case Instruction::FAdd: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2222,9 +2460,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FSub: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2241,9 +2479,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
  
   case Instruction::FMul: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2261,9 +2499,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FDiv: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2281,9 +2519,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FRem: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2301,9 +2539,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPTrunc: {
-    FPTruncInst *fi = cast<FPTruncInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    Expr::Width resultType = ki->width;
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
       return terminateStateOnExecError(state, "Unsupported FPTrunc operation");
@@ -2322,9 +2559,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPExt: {
-    FPExtInst *fi = cast<FPExtInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    Expr::Width resultType = ki->width;
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
       return terminateStateOnExecError(state, "Unsupported FPExt operation");
@@ -2342,9 +2578,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPToUI: {
-    FPToUIInst *fi = cast<FPToUIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    Expr::Width resultType = ki->width;
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
       return terminateStateOnExecError(state, "Unsupported FPToUI operation");
@@ -2363,9 +2598,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPToSI: {
-    FPToSIInst *fi = cast<FPToSIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    Expr::Width resultType = ki->width;
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
       return terminateStateOnExecError(state, "Unsupported FPToSI operation");
@@ -2384,9 +2618,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::UIToFP: {
-    UIToFPInst *fi = cast<UIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    Expr::Width resultType = ki->width;
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
     if (!semantics)
@@ -2400,9 +2633,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::SIToFP: {
-    SIToFPInst *fi = cast<SIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    Expr::Width resultType = ki->width;
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
     if (!semantics)
@@ -2416,10 +2648,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FCmp: {
-    FCmpInst *fi = cast<FCmpInst>(i);
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2435,7 +2666,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     APFloat::cmpResult CmpRes = LHS.compare(RHS);
 
     bool Result = false;
-    switch( fi->getPredicate() ) {
+    switch( ki->predicate ) {
       // Predicates which only care about whether or not the operands are NaNs.
     case FCmpInst::FCMP_ORD:
       Result = CmpRes != APFloat::cmpUnordered;
@@ -2515,8 +2746,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::InsertValue: {
     KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-    ref<Expr> agg = eval(ki, 0, state).value;
-    ref<Expr> val = eval(ki, 1, state).value;
+    ref<Expr> agg = eval(ki, 0, state).getValue();
+    ref<Expr> val = eval(ki, 1, state).getValue();
 
     ref<Expr> l = NULL, r = NULL;
     unsigned lOffset = kgepi->offset*8, rOffset = kgepi->offset*8 + val->getWidth();
@@ -2542,9 +2773,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::ExtractValue: {
     KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-    ref<Expr> agg = eval(ki, 0, state).value;
+    ref<Expr> agg = eval(ki, 0, state).getValue();
 
-    ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, getWidthForLLVMType(i->getType()));
+    ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, ki->width);
 
     bindLocal(ki, state, result);
     break;
@@ -2571,26 +2802,49 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 }
 
+void Executor::registerState(ExecutionState *es) {
+  assert(es->stateIndex == ExecutionState::NotRegistered &&
+         "state added twice");
+  es->stateIndex = states.size();
+  states.push_back(es);
+}
+
+void Executor::unregisterState(ExecutionState *es) {
+  unsigned index = es->stateIndex;
+  assert(index < states.size() && states[index] == es &&
+         "state not registered");
+  ExecutionState *last = states.back();
+  states[index] = last;
+  last->stateIndex = index;
+  states.pop_back();
+  es->stateIndex = ExecutionState::NotRegistered;
+}
+
 void Executor::updateStates(ExecutionState *current) {
   if (searcher) {
     searcher->update(current, addedStates, removedStates);
   }
-  
-  states.insert(addedStates.begin(), addedStates.end());
+
+  states.reserve(states.size() + addedStates.size());
+  for (std::vector<ExecutionState *>::iterator it = addedStates.begin(),
+                                               ie = addedStates.end();
+       it != ie; ++it)
+    registerState(*it);
   addedStates.clear();
 
+  // Seed mode is usually over by the time many states are removed, so
+  // only look them up while there are seeds.
+  bool hasSeeds = !seedMap.empty();
   for (std::vector<ExecutionState *>::iterator it = removedStates.begin(),
                                                ie = removedStates.end();
        it != ie; ++it) {
     ExecutionState *es = *it;
-    std::set<ExecutionState*>::iterator it2 = states.find(es);
-    assert(it2!=states.end());
-    states.erase(it2);
-    std::map<ExecutionState*, std::vector<SeedInfo> >::iterator it3 = 
-      seedMap.find(es);
-    if (it3 != seedMap.end())
-      seedMap.erase(it3);
+    unregisterState(es);
+    if (hasSeeds)
+      seedMap.erase(es);
     processTree->remove(es->ptreeNode);
+    if (spiller && spiller->isSpilled(*es))
+      spiller->discard(*es);
     delete es;
   }
   removedStates.clear();
@@ -2654,55 +2908,189 @@ void Executor::bindModuleConstants() {
   kmodule->constantTable = new Cell[kmodule->constants.size()];
   for (unsigned i=0; i<kmodule->constants.size(); ++i) {
     Cell &c = kmodule->constantTable[i];
-    c.value = evalConstant(kmodule->constants[i]);
+    c.setValue(evalConstant(kmodule->constants[i]));
   }
 }
 
+uint64_t Executor::getAccountedMemoryUsage() const {
+  return Expr::getNumAllocatedBytes() + ObjectState::getNumAllocatedBytes() +
+         PageStore::getAllocatedSize() +
+         ConstraintManager::getNumAllocatedBytes() + SolverImpl::cacheBytes +
+         (processTree ? processTree->getNumAllocatedBytes() : 0);
+}
+
 void Executor::checkMemoryUsage() {
   if (!MaxMemory)
     return;
-  if ((stats::instructions & 0xFFFF) == 0) {
-    // We need to avoid calling GetTotalMallocUsage() often because it
-    // is O(elts on freelist). This is really bad since we start
-    // to pummel the freelist once we hit the memory cap.
-    unsigned mbs = (util::GetTotalMallocUsage() >> 20) +
-                   (memory->getUsedDeterministicSize() >> 20);
-
-    if (mbs > MaxMemory) {
-      if (mbs > MaxMemory + 100) {
-        // just guess at how many to kill
-        unsigned numStates = states.size();
-        unsigned toKill = std::max(1U, numStates - numStates * MaxMemory / mbs);
-        klee_warning("killing %d states (over memory cap)", toKill);
-        std::vector<ExecutionState *> arr(states.begin(), states.end());
-        for (unsigned i = 0, N = arr.size(); N && i < toKill; ++i, --N) {
-          unsigned idx = rand() % N;
-          // Make two pulls to try and not hit a state that
-          // covered new code.
-          if (arr[idx]->coveredNew)
-            idx = rand() % N;
-
-          std::swap(arr[idx], arr[N - 1]);
-          terminateStateEarly(*arr[N - 1], "Memory limit exceeded.");
+  uint64_t accounted = getAccountedMemoryUsage();
+  if ((stats::instructions & 0xFFFF) != 0) {
+    // Between full measurements, track the memory usage through the
+    // subsystems which account for their allocations and measure early
+    // when it spikes past the cap. Once at the cap, states are only
+    // killed at the usual rate.
+    int64_t estimate = unaccountedMemoryUsage + (int64_t)accounted;
+    if (atMemoryLimit || (estimate >> 20) <= (int64_t)MaxMemory ||
+        stats::instructions - lastMemoryMeasurement < 1024)
+      return;
+  }
+
+  // We need to avoid calling GetTotalMallocUsage() often because it
+  // is O(elts on freelist). This is really bad since we start
+  // to pummel the freelist once we hit the memory cap.
+  uint64_t usage = util::GetTotalMallocUsage() +
+                   memory->getUsedDeterministicSize() +
+                   PageStore::getUsedSize();
+  unaccountedMemoryUsage = (int64_t)usage - (int64_t)accounted;
+  lastMemoryMeasurement = stats::instructions;
+  unsigned mbs = usage >> 20;
+
+  if (mbs > MaxMemory) {
+    // Seeded states are executed without being selected, so they are
+    // not reloaded.
+    if (spiller && seedMap.empty() && spillStates(mbs)) {
+      atMemoryLimit = false;
+      return;
+    }
+    if (mbs > MaxMemory + 100) {
+      // Spilled states hold little memory, so they are only killed once
+      // no other state is left. They are not reloaded to output a test,
+      // which would take the memory they were spilled to save.
+      std::vector<ExecutionState *> arr, spilled;
+      for (std::vector<ExecutionState *>::iterator it = states.begin(),
+                                                   ie = states.end();
+           it != ie; ++it) {
+        if (std::find(removedStates.begin(), removedStates.end(), *it) !=
+            removedStates.end())
+          continue;
+        if (spiller && spiller->isSpilled(**it))
+          spilled.push_back(*it);
+        else
+          arr.push_back(*it);
+      }
+      if (arr.empty())
+        arr.swap(spilled);
+      unsigned toKill = selectStatesToEvict(arr, mbs);
+      klee_warning("killing %d states (over memory cap)", toKill);
+      for (unsigned i = 0; i != toKill; ++i) {
+        if (spiller && spiller->isSpilled(*arr[i])) {
+          spiller->discard(*arr[i]);
+          terminateState(*arr[i]);
+        } else {
+          terminateStateEarly(*arr[i], "Memory limit exceeded.");
         }
       }
-      atMemoryLimit = true;
-    } else {
-      atMemoryLimit = false;
     }
+    atMemoryLimit = true;
+  } else {
+    atMemoryLimit = false;
   }
 }
 
+static bool moreOwnedBytes(const std::pair<uint64_t, ExecutionState *> &a,
+                           const std::pair<uint64_t, ExecutionState *> &b) {
+  return a.first > b.first;
+}
+
+unsigned Executor::selectStatesToEvict(std::vector<ExecutionState *> &arr,
+                                       unsigned mbs) {
+  if (arr.empty())
+    return 0;
+
+  std::map<ExecutionState *, uint64_t> ownedBytes;
+  uint64_t totalOwnedBytes = 0;
+  for (std::vector<ExecutionState *>::iterator it = arr.begin(),
+                                               ie = arr.end();
+       it != ie; ++it) {
+    uint64_t bytes = (*it)->addressSpace.getOwnedBytes();
+    ownedBytes[*it] = bytes;
+    totalOwnedBytes += bytes;
+  }
+
+  switch (EvictStates) {
+  case EvictBySearcher:
+    if (searcher && searcher->rankForEviction(arr))
+      break;
+    // Fall through.
+  case EvictByMemory: {
+    std::vector<std::pair<uint64_t, ExecutionState *> > ranked;
+    for (std::vector<ExecutionState *>::iterator it = arr.begin(),
+                                                 ie = arr.end();
+         it != ie; ++it)
+      ranked.push_back(std::make_pair(ownedBytes[*it], *it));
+    std::stable_sort(ranked.begin(), ranked.end(), moreOwnedBytes);
+    for (unsigned i = 0, e = ranked.size(); i != e; ++i)
+      arr[i] = ranked[i].second;
+    break;
+  }
+  case EvictRandomly:
+    for (unsigned N = arr.size(); N > 1; --N) {
+      unsigned idx = rand() % N;
+      // Make two pulls to try and not hit a state that
+      // covered new code.
+      if (arr[idx]->coveredNew)
+        idx = rand() % N;
+      std::swap(arr[idx], arr[N - 1]);
+    }
+    std::reverse(arr.begin(), arr.end());
+    break;
+  }
+
+  // Evicting a state frees the memory only it holds and, for lack of a
+  // better estimate, its share of the memory held by all states together.
+  uint64_t usage = (uint64_t)mbs << 20;
+  uint64_t target = (uint64_t)(mbs - MaxMemory) << 20;
+  uint64_t sharedBytes =
+      usage > totalOwnedBytes ? (usage - totalOwnedBytes) / arr.size() : 0;
+  uint64_t reclaimed = 0;
+  unsigned numStates = 0;
+  while (numStates != arr.size() && reclaimed < target)
+    reclaimed += ownedBytes[arr[numStates++]] + sharedBytes;
+  return numStates;
+}
+
+bool Executor::spillStates(unsigned mbs) {
+  std::vector<ExecutionState *> arr;
+  for (std::vector<ExecutionState *>::iterator it = states.begin(),
+                                               ie = states.end();
+       it != ie; ++it)
+    if (!spiller->isSpilled(**it) &&
+        std::find(removedStates.begin(), removedStates.end(), *it) ==
+            removedStates.end())
+      arr.push_back(*it);
+
+  unsigned toSpill = selectStatesToEvict(arr, mbs);
+  unsigned numSpilled = 0;
+  for (unsigned i = 0; i != toSpill; ++i)
+    if (spiller->spill(*arr[i]))
+      ++numSpilled;
+  if (numSpilled)
+    klee_message("spilled %u states to disk (over memory cap, %u spilled "
+                 "in total)", numSpilled, spiller->getNumSpilled());
+  return numSpilled != 0;
+}
+
+void Executor::reloadState(ExecutionState &state) {
+  if (spiller && spiller->isSpilled(state))
+    spiller->reload(state);
+}
+
 void Executor::doDumpStates() {
   if (!DumpStatesOnHalt || states.empty())
     return;
   klee_message("halting execution, dumping remaining states");
-  for (std::set<ExecutionState *>::iterator it = states.begin(),
-                                            ie = states.end();
+  std::vector<ExecutionState *> arr(states.begin(), states.end());
+  for (std::vector<ExecutionState *>::iterator it = arr.begin(),
+                                               ie = arr.end();
        it != ie; ++it) {
     ExecutionState &state = **it;
+    // Spilled states are reloaded to output their tests, and are deleted
+    // right after, so that only one of them is back in memory at a time.
+    bool spilled = spiller && spiller->isSpilled(state);
+    reloadState(state);
     stepInstruction(state); // keep stats rolling
     terminateStateEarly(state, "Execution halting.");
+    if (spilled)
+      updateStates(0);
   }
   updateStates(0);
 }
@@ -2714,7 +3102,7 @@ void Executor::run(ExecutionState &initialState) {
   // optimization and such.
   initTimers();
 
-  states.insert(&initialState);
+  registerState(&initialState);
 
   if (usingSeeds) {
     std::vector<SeedInfo> &v = seedMap[&initialState];
@@ -2773,7 +3161,7 @@ void Executor::run(ExecutionState &initialState) {
 
     // XXX total hack, just because I like non uniform better but want
     // seed results to be equally weighted.
-    for (std::set<ExecutionState*>::iterator
+    for (std::vector<ExecutionState *>::iterator
            it = states.begin(), ie = states.end();
          it != ie; ++it) {
       (*it)->weight = 1.;
@@ -2792,6 +3180,7 @@ void Executor::run(ExecutionState &initialState) {
 
   while (!states.empty() && !haltExecution) {
     ExecutionState &state = searcher->selectState();
+    reloadState(state);
     KInstruction *ki = state.pc;
     stepInstruction(state);
 
@@ -2801,6 +3190,16 @@ void Executor::run(ExecutionState &initialState) {
     checkMemoryUsage();
 
     updateStates(&state);
+
+    if (DonateStatesAt && states.size() >= DonateStatesAt &&
+        !donatedAtThreshold) {
+      donatedAtThreshold = true;
+      donationRequested = true;
+    }
+    if (donationRequested) {
+      donationRequested = false;
+      donateStates();
+    }
   }
 
   delete searcher;
@@ -2809,6 +3208,62 @@ void Executor::run(ExecutionState &initialState) {
   doDumpStates();
 }
 
+void Executor::getStatesInTreeOrder(std::vector<ExecutionState *> &result) {
+  std::vector<PTreeNode *> stack(1, processTree->root);
+  while (!stack.empty()) {
+    PTreeNode *n = stack.back();
+    stack.pop_back();
+    if (n->data)
+      result.push_back(n->data);
+    if (n->right)
+      stack.push_back(n->right);
+    if (n->left)
+      stack.push_back(n->left);
+  }
+  assert(result.size() == states.size() && "process tree out of sync");
+}
+
+void Executor::donateStates() {
+  if (!pathWriter) {
+    klee_warning_once(0, "cannot give away states without their paths "
+                         "(see --write-paths)");
+    return;
+  }
+  if (states.size() < 2)
+    return;
+
+  std::vector<ExecutionState *> ordered;
+  getStatesInTreeOrder(ordered);
+
+  // Give away every other state, so that the subtrees kept and given away
+  // are alike.
+  static unsigned id;
+  for (unsigned i = 1; i < ordered.size(); i += 2) {
+    ExecutionState *es = ordered[i];
+    std::vector<unsigned char> branches;
+    pathWriter->readStream(getPathStreamID(*es), branches);
+
+    // Write under a temporary name first, so that the file is complete
+    // once it can be seen.
+    std::string name = "donated" + llvm::utostr(++id) + ".path";
+    llvm::raw_fd_ostream *f = interpreterHandler->openOutputFile(name + ".tmp");
+    if (!f)
+      break;
+    for (unsigned j = 0; j < branches.size(); ++j)
+      *f << branches[j] << "\n";
+    delete f;
+    if (rename(interpreterHandler->getOutputFilename(name + ".tmp").c_str(),
+               interpreterHandler->getOutputFilename(name).c_str()) < 0) {
+      klee_warning("unable to give away state: %s", strerror(errno));
+      break;
+    }
+    removedStates.push_back(es);
+  }
+  klee_message("gave away %u of %u states", (unsigned) removedStates.size(),
+               (unsigned) ordered.size());
+  updateStates(0);
+}
+
 std::string Executor::getAddressInfo(ExecutionState &state, 
                                      ref<Expr> address) const{
   std::string Str;
@@ -2867,9 +3322,7 @@ void Executor::terminateState(ExecutionState &state) {
 
   interpreterHandler->incPathsExplored();
 
-  std::vector<ExecutionState *>::iterator it =
-      std::find(addedStates.begin(), addedStates.end(), &state);
-  if (it==addedStates.end()) {
+  if (state.stateIndex != ExecutionState::NotRegistered) {
     state.pc = state.prevPC;
 
     removedStates.push_back(&state);
@@ -2879,6 +3332,9 @@ void Executor::terminateState(ExecutionState &state) {
       seedMap.find(&state);
     if (it3 != seedMap.end())
       seedMap.erase(it3);
+    std::vector<ExecutionState *>::iterator it =
+        std::find(addedStates.begin(), addedStates.end(), &state);
+    assert(it != addedStates.end() && "state neither added nor registered");
     addedStates.erase(it);
     processTree->remove(state.ptreeNode);
     delete &state;
@@ -3083,6 +3539,7 @@ void Executor::callExternalFunction(ExecutionState &state,
   
   bool success = externalDispatcher->executeCall(function, target->inst, args);
   if (!success) {
+    AddressSpace::forgetCopiedOutConcretes();
     terminateStateOnError(state, "failed external call: " + function->getName(),
                           External);
     return;
@@ -3155,6 +3612,31 @@ void Executor::executeAlloc(ExecutionState &state,
                             bool zeroMemory,
                             const ObjectState *reallocFrom) {
   size = toUnique(state, size);
+
+  // Allocate objects of bounded symbolic size at their maximal size and
+  // keep the size expression for bounds checks, instead of forking over
+  // concrete sizes.
+  ref<Expr> symbolicSize;
+  if (MaxSymSizeAlloc && !isa<ConstantExpr>(size)) {
+    std::pair< ref<Expr>, ref<Expr> > range = solver->getRange(state, size);
+    uint64_t min = cast<ConstantExpr>(range.first)->getZExtValue();
+    uint64_t max = cast<ConstantExpr>(range.second)->getZExtValue();
+    if (max <= MaxSymSizeAlloc) {
+      symbolicSize = size;
+      size = range.second;
+    } else if (min <= MaxSymSizeAlloc) {
+      ref<Expr> bound = ConstantExpr::alloc(MaxSymSizeAlloc, size->getWidth());
+      StatePair bounded = fork(state, UleExpr::create(size, bound), true);
+      if (bounded.first)
+        executeAlloc(*bounded.first, size, isLocal, target, zeroMemory,
+                     reallocFrom);
+      if (bounded.second)
+        executeAlloc(*bounded.second, size, isLocal, target, zeroMemory,
+                     reallocFrom);
+      return;
+    }
+  }
+
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(size)) {
     const llvm::Value *allocSite = state.prevPC->inst;
     size_t allocationAlignment = getAllocationAlignment(allocSite);
@@ -3165,6 +3647,7 @@ void Executor::executeAlloc(ExecutionState &state,
       bindLocal(target, state, 
                 ConstantExpr::alloc(0, Context::get().getPointerWidth()));
     } else {
+      mo->symbolicSize = symbolicSize;
       ObjectState *os = bindObjectInState(state, mo, isLocal);
       if (zeroMemory) {
         os->initializeToZero();
@@ -3323,8 +3806,7 @@ void Executor::executeMemoryOperation(ExecutionState &state,
                                       ref<Expr> address,
                                       ref<Expr> value /* undef if read */,
                                       KInstruction *target /* undef if write */) {
-  Expr::Width type = (isWrite ? value->getWidth() : 
-                     getWidthForLLVMType(target->inst->getType()));
+  Expr::Width type = (isWrite ? value->getWidth() : target->width);
   unsigned bytes = Expr::getMinBytesForWidth(type);
 
   if (SimplifySymIndices) {
@@ -3449,9 +3931,10 @@ void Executor::executeMakeSymbolic(ExecutionState &state,
     // or if that fails try adding a unique identifier.
     unsigned id = 0;
     std::string uniqueName = name;
-    while (!state.arrayNames.insert(uniqueName).second) {
+    while (state.arrayNames.count(uniqueName)) {
       uniqueName = name + "_" + llvm::utostr(++id);
     }
+    state.arrayNames = state.arrayNames.insert(uniqueName);
     const Array *array = arrayCache.CreateArray(uniqueName, mo->size);
     bindObjectInState(state, mo, false, array);
     state.addSymbolic(mo, array);
@@ -3620,6 +4103,11 @@ void Executor::runFunctionAsMain(Function *f,
 
   globalObjects.clear();
   globalAddresses.clear();
+  for (std::vector<ObjectInitializer*>::iterator
+         it = globalInitializers.begin(), ie = globalInitializers.end();
+       it != ie; ++it)
+    delete *it;
+  globalInitializers.clear();
 
   if (statsTracker)
     statsTracker->done();
@@ -3728,7 +4216,13 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
 
 void Executor::getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res) {
-  res = state.coveredLines;
+  std::vector<unsigned> ids;
+  state.coveredInstructions.getElements(ids);
+  for (std::vector<unsigned>::iterator it = ids.begin(), ie = ids.end();
+       it != ie; ++it) {
+    const InstructionInfo &ii = kmodule->infos->getInfoByID(*it);
+    res[&ii.file].insert(ii.line);
+  }
 }
 
 void Executor::doImpliedValueConcretization(ExecutionState &state,
@@ -29,6 +29,7 @@
 #include <string>
 #include <map>
 #include <set>
+#include <signal.h>
 
 struct KTest;
 
@@ -57,6 +58,7 @@ namespace klee {
   class ExecutionState;
   class ExternalDispatcher;
   class Expr;
+  class ExprBuilder;
   class InstructionInfoTable;
   struct KFunction;
   struct KInstruction;
@@ -64,12 +66,14 @@ namespace klee {
   class KModule;
   class MemoryManager;
   class MemoryObject;
+  class ObjectInitializer;
   class ObjectState;
   class PTree;
   class Searcher;
   class SeedInfo;
   class SpecialFunctionHandler;
   struct StackFrame;
+  class StateSpiller;
   class StatsTracker;
   class TimingSolver;
   class TreeStreamWriter;
@@ -83,6 +87,7 @@ namespace klee {
 
 class Executor : public Interpreter {
   friend class BumpMergingSearcher;
+  friend class GlobalObjectInitializer;
   friend class MergingSearcher;
   friend class SonarSearcher;
   friend class RandomPathSearcher;
@@ -131,7 +136,15 @@ private:
   ExternalDispatcher *externalDispatcher;
   TimingSolver *solver;
   MemoryManager *memory;
-  std::set<ExecutionState*> states;
+
+  /// Builds the expressions computed by instructions, possibly reusing
+  /// earlier results (see --cache-expr-builds).
+  ExprBuilder *exprBuilder;
+
+  /// The states being explored, in no particular order. Each state keeps
+  /// its position (see ExecutionState::stateIndex), so that it is removed
+  /// by moving the last state into its place.
+  std::vector<ExecutionState *> states;
   StatsTracker *statsTracker;
   TreeStreamWriter *pathWriter, *symPathWriter;
   SpecialFunctionHandler *specialFunctionHandler;
@@ -165,6 +178,10 @@ private:
   /// globals that have no representative object (i.e. functions).
   std::map<const llvm::GlobalValue*, ref<ConstantExpr> > globalAddresses;
 
+  /// Initializers of the lazily initialized global objects, owned by the
+  /// executor since they are shared by all states.
+  std::vector<ObjectInitializer*> globalInitializers;
+
   /// The set of legal function addresses, used to validate function
   /// pointers. We use the actual Function* address as the function address.
   std::set<uint64_t> legalFunctions;
@@ -174,8 +191,12 @@ private:
   const struct KTest *replayKTest;
   /// When non-null a list of branch decisions to be used for replay.
   const std::vector<bool> *replayPath;
-  /// The index into the current \ref replayKTest or \ref replayPath
-  /// object.
+  /// Whether the paths which extend \ref replayPath are explored, rather
+  /// than that path only.
+  bool replayPathPrefix;
+  /// The index into the current \ref replayKTest object. The position in
+  /// \ref replayPath is kept by each state (see
+  /// ExecutionState::replayPathPosition).
   unsigned replayPosition;
 
   /// When non-null a list of "seed" inputs which will be used to
@@ -186,6 +207,18 @@ private:
   /// needed to control memory usage. \see fork()
   bool atMemoryLimit;
 
+  /// The memory usage which is not accounted for by the subsystems, see
+  /// getAccountedMemoryUsage(), as of the last full measurement.
+  int64_t unaccountedMemoryUsage;
+
+  /// The number of executed instructions at the last full measurement of
+  /// the memory usage.
+  uint64_t lastMemoryMeasurement;
+
+  /// Moves states to disk when over the memory cap, null unless enabled
+  /// by --spill-states. \see checkMemoryUsage()
+  StateSpiller *spiller;
+
   /// Disables forking, set by client. \see setInhibitForking()
   bool inhibitForking;
 
@@ -193,6 +226,14 @@ private:
   /// step.
   bool haltExecution;  
 
+  /// Signals the executor to give away some of its states at the next
+  /// instruction step. \see requestStateDonation()
+  volatile sig_atomic_t donationRequested;
+
+  /// Whether the states were given away once there were enough of them
+  /// (see --donate-states-at).
+  bool donatedAtThreshold;
+
   /// Whether implied-value concretization is enabled. Currently
   /// false, it is buggy (it needs to validate its writes).
   bool ivcEnabled;
@@ -218,6 +259,11 @@ private:
   
   void executeInstruction(ExecutionState &state, KInstruction *ki);
 
+  /// Execute an integer arithmetic, comparison or cast instruction whose
+  /// operands are all unboxed constants, without building expressions.
+  /// \return false if the instruction has to take the general path.
+  bool executeImmediateInstruction(ExecutionState &state, KInstruction *ki);
+
   void printFileLine(ExecutionState &state, KInstruction *ki,
                      llvm::raw_ostream &file);
 
@@ -228,13 +274,27 @@ private:
   MemoryObject *addExternalObject(ExecutionState &state, void *addr, 
                                   unsigned size, bool isReadOnly);
 
-  void initializeGlobalObject(ExecutionState &state, ObjectState *os, 
-			      const llvm::Constant *c,
+  void initializeGlobalObject(ObjectState *os, const llvm::Constant *c,
 			      unsigned offset);
   void initializeGlobals(ExecutionState &state);
 
   void stepInstruction(ExecutionState &state);
   void updateStates(ExecutionState *current);
+
+  /// Add \a es to \ref states.
+  void registerState(ExecutionState *es);
+
+  /// Remove \a es from \ref states, moving the last state into its place.
+  void unregisterState(ExecutionState *es);
+
+  /// Get the states in the order of their position in the process tree.
+  void getStatesInTreeOrder(std::vector<ExecutionState *> &result);
+
+  /// Stop exploring half of the states, writing their paths to files
+  /// named donated<N>.path in the output directory instead, so that they
+  /// can be explored by another process (see --replay-path-prefix).
+  void donateStates();
+
   void transferToBasicBlock(llvm::BasicBlock *dst, 
 			    llvm::BasicBlock *src,
 			    ExecutionState &state);
@@ -317,6 +377,10 @@ private:
               const std::vector< ref<Expr> > &conditions,
               std::vector<ExecutionState*> &result);
 
+  /// Record in the path of \a state that it took the condition with
+  /// index \a taken of the \a n conditions of a branch().
+  void recordBranch(ExecutionState &state, unsigned taken, unsigned n);
+
   // Fork current and return states in which condition holds / does
   // not hold, respectively. One of the states is necessarily the
   // current state, and one of the states may be null.
@@ -338,12 +402,12 @@ private:
   Cell& getArgumentCell(ExecutionState &state,
                         KFunction *kf,
                         unsigned index) {
-    return state.stack.back().locals[kf->getArgRegister(index)];
+    return state.stack.back().getWriteableLocal(kf->getArgRegister(index));
   }
 
   Cell& getDestCell(ExecutionState &state,
                     KInstruction *target) {
-    return state.stack.back().locals[target->dest];
+    return state.stack.back().getWriteableLocal(target->dest);
   }
 
   void bindLocal(KInstruction *target, 
@@ -433,6 +497,28 @@ private:
   void processTimers(ExecutionState *current,
                      double maxInstTime);
   void checkMemoryUsage();
+
+  /// Get the number of bytes taken by the subsystems which account for
+  /// their own allocations: expressions, object states, constraints,
+  /// solver caches and the process tree.
+  uint64_t getAccountedMemoryUsage() const;
+
+  /// Order \a arr by the eviction policy (see --evict-states), the states
+  /// to evict first coming first, and get the number of leading states
+  /// which have to be evicted to get from the memory usage \a mbs back to
+  /// the cap.
+  unsigned selectStatesToEvict(std::vector<ExecutionState *> &arr,
+                               unsigned mbs);
+
+  /// Spill some of the states which are in memory to disk, given the
+  /// current memory usage \a mbs.
+  /// \return false if no state could be spilled.
+  bool spillStates(unsigned mbs);
+
+  /// Reload the contents of a state if it was spilled to disk. This has to
+  /// be done before a state which may be spilled is used.
+  void reloadState(ExecutionState &state);
+
   void printDebugInstructions(ExecutionState &state);
   void doDumpStates();
 
@@ -461,10 +547,11 @@ public:
     replayPosition = 0;
   }
 
-  virtual void setReplayPath(const std::vector<bool> *path) {
+  virtual void setReplayPath(const std::vector<bool> *path,
+                             bool prefixOnly = false) {
     assert(!replayKTest && "cannot replay both buffer and path");
     replayPath = path;
-    replayPosition = 0;
+    replayPathPrefix = prefixOnly;
   }
 
   virtual const llvm::Module *
@@ -489,6 +576,10 @@ public:
     inhibitForking = value;
   }
 
+  virtual void requestStateDonation() {
+    donationRequested = true;
+  }
+
   void prepareForEarlyExit();
 
   /*** State accessor methods ***/
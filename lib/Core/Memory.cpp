@@ -13,11 +13,13 @@
 #include "klee/Expr.h"
 #include "klee/Solver.h"
 #include "klee/util/BitArray.h"
+#include "klee/Internal/ADT/FixedSizeAllocator.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/util/ArrayCache.h"
 
 #include "ObjectHolder.h"
 #include "MemoryManager.h"
+#include "PageStore.h"
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
 #include <llvm/IR/Function.h>
@@ -32,6 +34,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 
@@ -42,6 +45,20 @@ namespace {
   cl::opt<bool>
   UseConstantArrays("use-constant-arrays",
                     cl::init(true));
+
+  // The pools are intentionally never destroyed, objects may still be
+  // released during static destruction.
+  FixedSizeAllocator &getMemoryObjectPool() {
+    static FixedSizeAllocator *pool =
+        new FixedSizeAllocator(sizeof(MemoryObject));
+    return *pool;
+  }
+
+  FixedSizeAllocator &getObjectStatePool() {
+    static FixedSizeAllocator *pool =
+        new FixedSizeAllocator(sizeof(ObjectState));
+    return *pool;
+  }
 }
 
 /***/
@@ -74,6 +91,15 @@ MemoryObject::~MemoryObject() {
     parent->markFreed(this);
 }
 
+void *MemoryObject::operator new(size_t size) {
+  assert(size == sizeof(MemoryObject) && "unexpected allocation size");
+  return getMemoryObjectPool().allocate();
+}
+
+void MemoryObject::operator delete(void *ptr, size_t size) {
+  getMemoryObjectPool().deallocate(ptr);
+}
+
 void MemoryObject::getAllocInfo(std::string &result) const {
   llvm::raw_string_ostream info(result);
 
@@ -102,7 +128,10 @@ ObjectState::ObjectState(const MemoryObject *mo)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
-    concreteStore(new uint8_t[mo->size]),
+    pages(0),
+    singlePage(0),
+    storeVersion(0),
+    lazyInitializer(0),
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
@@ -116,7 +145,7 @@ ObjectState::ObjectState(const MemoryObject *mo)
         getArrayCache()->CreateArray("tmp_arr" + llvm::utostr(++id), size);
     updates = UpdateList(array, 0);
   }
-  memset(concreteStore, 0, size);
+  fillPages(0);
 }
 
 
@@ -124,7 +153,10 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
-    concreteStore(new uint8_t[mo->size]),
+    pages(0),
+    singlePage(0),
+    storeVersion(0),
+    lazyInitializer(0),
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
@@ -133,14 +165,42 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
     readOnly(false) {
   mo->refCount++;
   makeSymbolic();
-  memset(concreteStore, 0, size);
+  fillPages(0);
+}
+
+ObjectState::ObjectState(const MemoryObject *mo,
+                         const ObjectInitializer *init)
+  : copyOnWriteOwner(0),
+    refCount(0),
+    object(mo),
+    pages(0),
+    singlePage(0),
+    storeVersion(0),
+    lazyInitializer(init),
+    concreteMask(0),
+    flushMask(0),
+    knownSymbolics(0),
+    updates(0, 0),
+    size(mo->size),
+    readOnly(false) {
+  assert(init && "missing initializer");
+  mo->refCount++;
+  if (!UseConstantArrays) {
+    static unsigned id = 0;
+    const Array *array =
+        getArrayCache()->CreateArray("lazy_arr" + llvm::utostr(++id), size);
+    updates = UpdateList(array, 0);
+  }
 }
 
 ObjectState::ObjectState(const ObjectState &os) 
   : copyOnWriteOwner(0),
     refCount(0),
     object(os.object),
-    concreteStore(new uint8_t[os.size]),
+    pages(0),
+    singlePage(0),
+    storeVersion(0),
+    lazyInitializer(0),
     concreteMask(os.concreteMask ? new BitArray(*os.concreteMask, os.size) : 0),
     flushMask(os.flushMask ? new BitArray(*os.flushMask, os.size) : 0),
     knownSymbolics(0),
@@ -151,20 +211,30 @@ ObjectState::ObjectState(const ObjectState &os)
   if (object)
     object->refCount++;
 
+  os.materialize();
+
   if (os.knownSymbolics) {
     knownSymbolics = new ref<Expr>[size];
     for (unsigned i=0; i<size; i++)
       knownSymbolics[i] = os.knownSymbolics[i];
   }
+  allocatedBytes += getMetadataBytes();
 
-  memcpy(concreteStore, os.concreteStore, size*sizeof(*concreteStore));
+  // Share the contents until either copy writes them.
+  allocatePages();
+  for (unsigned i = 0, e = getNumPages(); i != e; ++i) {
+    pages[i] = os.pages[i];
+    PageStore::retain(pages[i]);
+  }
+  storeVersion = os.storeVersion;
 }
 
 ObjectState::~ObjectState() {
+  allocatedBytes -= getMetadataBytes();
   if (concreteMask) delete concreteMask;
   if (flushMask) delete flushMask;
   if (knownSymbolics) delete[] knownSymbolics;
-  delete[] concreteStore;
+  releasePages();
 
   if (object)
   {
@@ -177,6 +247,134 @@ ObjectState::~ObjectState() {
   }
 }
 
+void *ObjectState::operator new(size_t size) {
+  assert(size == sizeof(ObjectState) && "unexpected allocation size");
+  allocatedBytes += size;
+  return getObjectStatePool().allocate();
+}
+
+void ObjectState::operator delete(void *ptr, size_t size) {
+  allocatedBytes -= size;
+  getObjectStatePool().deallocate(ptr);
+}
+
+size_t ObjectState::allocatedBytes = 0;
+
+size_t ObjectState::getMetadataBytes() const {
+  size_t bytes = 0;
+  if (concreteMask)
+    bytes += BitArray::getNumAllocatedBytes(size);
+  if (flushMask)
+    bytes += BitArray::getNumAllocatedBytes(size);
+  if (knownSymbolics)
+    bytes += sizeof(ref<Expr>) * size;
+  return bytes;
+}
+
+size_t ObjectState::getPrivateBytes() const {
+  size_t bytes = sizeof(ObjectState) + getMetadataBytes();
+  if (pages)
+    for (unsigned i = 0, e = getNumPages(); i != e; ++i)
+      if (pages[i]->refCount == 1)
+        bytes += sizeof(StorePage) + pages[i]->size;
+  return bytes;
+}
+
+void ObjectState::materializeSlow() const {
+  const ObjectInitializer *init = lazyInitializer;
+  // The initializer writes through the regular interface, so the object
+  // has to look materialized already.
+  lazyInitializer = 0;
+  fillPages(0);
+  init->initialize(const_cast<ObjectState *>(this));
+}
+
+unsigned ObjectState::getNumPages() const {
+  return (size + PageStore::PageSize - 1) / PageStore::PageSize;
+}
+
+void ObjectState::allocatePages() const {
+  assert(!pages && "pages already allocated");
+  unsigned numPages = getNumPages();
+  if (numPages == 1)
+    pages = &singlePage;
+  else if (numPages)
+    pages = new StorePage*[numPages];
+}
+
+void ObjectState::releasePages() {
+  if (!pages)
+    return;
+  for (unsigned i = 0, e = getNumPages(); i != e; ++i)
+    PageStore::release(pages[i]);
+  if (pages != &singlePage)
+    delete[] pages;
+  pages = 0;
+}
+
+void ObjectState::fillPages(uint8_t value) const {
+  const_cast<ObjectState *>(this)->releasePages();
+  allocatePages();
+  for (unsigned i = 0, e = getNumPages(); i != e; ++i) {
+    unsigned offset = i * PageStore::PageSize;
+    pages[i] = PageStore::getFilled(
+        std::min(size - offset, PageStore::PageSize), value);
+  }
+  storeVersion = 0;
+}
+
+uint8_t ObjectState::getConcreteByte(unsigned offset) const {
+  return pages[offset / PageStore::PageSize]
+      ->data[offset % PageStore::PageSize];
+}
+
+void ObjectState::setConcreteByte(unsigned offset, uint8_t value) {
+  StorePage *page = getWriteablePage(offset / PageStore::PageSize);
+  page->data[offset % PageStore::PageSize] = value;
+  storeVersion = 0;
+}
+
+StorePage *ObjectState::getWriteablePage(unsigned index) {
+  StorePage *&page = pages[index];
+  if (!page->isWriteable()) {
+    StorePage *copy = PageStore::clone(page);
+    PageStore::release(page);
+    page = copy;
+  }
+  return page;
+}
+
+void ObjectState::copyConcreteTo(uint8_t *dest) const {
+  materialize();
+  for (unsigned i = 0, e = getNumPages(); i != e; ++i)
+    memcpy(dest + i * PageStore::PageSize, pages[i]->data, pages[i]->size);
+}
+
+bool ObjectState::concreteEquals(const uint8_t *src) const {
+  materialize();
+  for (unsigned i = 0, e = getNumPages(); i != e; ++i)
+    if (memcmp(src + i * PageStore::PageSize, pages[i]->data,
+               pages[i]->size) != 0)
+      return false;
+  return true;
+}
+
+bool ObjectState::copyConcreteFrom(const uint8_t *src) {
+  materialize();
+  bool changed = false;
+  for (unsigned i = 0, e = getNumPages(); i != e; ++i) {
+    const uint8_t *pageSrc = src + i * PageStore::PageSize;
+    if (memcmp(pageSrc, pages[i]->data, pages[i]->size) != 0) {
+      StorePage *page = getWriteablePage(i);
+      memcpy(page->data, pageSrc, page->size);
+      changed = true;
+    }
+  }
+  if (changed)
+    storeVersion = 0;
+  return changed;
+}
+
 ArrayCache *ObjectState::getArrayCache() const {
   assert(object && "object was NULL");
   return object->parent->getArrayCache();
@@ -236,6 +434,7 @@ const UpdateList &ObjectState::getUpdates() const {
 }
 
 void ObjectState::makeConcrete() {
+  allocatedBytes -= getMetadataBytes();
   if (concreteMask) delete concreteMask;
   if (flushMask) delete flushMask;
   if (knownSymbolics) delete[] knownSymbolics;
@@ -258,15 +457,16 @@ void ObjectState::makeSymbolic() {
 
 void ObjectState::initializeToZero() {
   makeConcrete();
-  memset(concreteStore, 0, size);
+  // Any lazily computed contents are overwritten anyway.
+  lazyInitializer = 0;
+  fillPages(0);
 }
 
 void ObjectState::initializeToRandom() {  
   makeConcrete();
-  for (unsigned i=0; i<size; i++) {
-    // randomly selected by 256 sided die
-    concreteStore[i] = 0xAB;
-  }
+  lazyInitializer = 0;
+  // randomly selected by 256 sided die
+  fillPages(0xAB);
 }
 
 /*
@@ -286,13 +486,16 @@ void ObjectState::fastRangeCheckOffset(ref<Expr> offset,
 
 void ObjectState::flushRangeForRead(unsigned rangeBase, 
                                     unsigned rangeSize) const {
-  if (!flushMask) flushMask = new BitArray(size, true);
+  if (!flushMask) {
+    flushMask = new BitArray(size, true);
+    allocatedBytes += BitArray::getNumAllocatedBytes(size);
+  }
  
   for (unsigned offset=rangeBase; offset<rangeBase+rangeSize; offset++) {
     if (!isByteFlushed(offset)) {
       if (isByteConcrete(offset)) {
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(concreteStore[offset], Expr::Int8));
+                       ConstantExpr::create(getConcreteByte(offset), Expr::Int8));
       } else {
         assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
@@ -306,13 +509,16 @@ void ObjectState::flushRangeForRead(unsigned rangeBase,
 
 void ObjectState::flushRangeForWrite(unsigned rangeBase, 
                                      unsigned rangeSize) {
-  if (!flushMask) flushMask = new BitArray(size, true);
+  if (!flushMask) {
+    flushMask = new BitArray(size, true);
+    allocatedBytes += BitArray::getNumAllocatedBytes(size);
+  }
 
   for (unsigned offset=rangeBase; offset<rangeBase+rangeSize; offset++) {
     if (!isByteFlushed(offset)) {
       if (isByteConcrete(offset)) {
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(concreteStore[offset], Expr::Int8));
+                       ConstantExpr::create(getConcreteByte(offset), Expr::Int8));
         markByteSymbolic(offset);
       } else {
         assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
@@ -352,8 +558,10 @@ void ObjectState::markByteConcrete(unsigned offset) {
 }
 
 void ObjectState::markByteSymbolic(unsigned offset) {
-  if (!concreteMask)
+  if (!concreteMask) {
     concreteMask = new BitArray(size, true);
+    allocatedBytes += BitArray::getNumAllocatedBytes(size);
+  }
   concreteMask->unset(offset);
 }
 
@@ -365,6 +573,7 @@ void ObjectState::markByteUnflushed(unsigned offset) {
 void ObjectState::markByteFlushed(unsigned offset) {
   if (!flushMask) {
     flushMask = new BitArray(size, false);
+    allocatedBytes += BitArray::getNumAllocatedBytes(size);
   } else {
     flushMask->unset(offset);
   }
@@ -378,6 +587,7 @@ void ObjectState::setKnownSymbolic(unsigned offset,
     if (value) {
       knownSymbolics = new ref<Expr>[size];
       knownSymbolics[offset] = value;
+      allocatedBytes += sizeof(ref<Expr>) * size;
     }
   }
 }
@@ -385,8 +595,9 @@ void ObjectState::setKnownSymbolic(unsigned offset,
 /***/
 
 ref<Expr> ObjectState::read8(unsigned offset) const {
+  materialize();
   if (isByteConcrete(offset)) {
-    return ConstantExpr::create(concreteStore[offset], Expr::Int8);
+    return ConstantExpr::create(getConcreteByte(offset), Expr::Int8);
   } else if (isByteKnownSymbolic(offset)) {
     return knownSymbolics[offset];
   } else {
@@ -416,7 +627,8 @@ ref<Expr> ObjectState::read8(ref<Expr> offset) const {
 
 void ObjectState::write8(unsigned offset, uint8_t value) {
   //assert(read_only == false && "writing to read-only object!");
-  concreteStore[offset] = value;
+  materialize();
+  setConcreteByte(offset, value);
   setKnownSymbolic(offset, 0);
 
   markByteConcrete(offset);
@@ -455,6 +667,8 @@ void ObjectState::write8(ref<Expr> offset, ref<Expr> value) {
 /***/
 
 ref<Expr> ObjectState::read(ref<Expr> offset, Expr::Width width) const {
+  materialize();
+
   // Truncate offset to 32-bits.
   offset = ZExtExpr::create(offset, Expr::Int32);
 
@@ -482,6 +696,8 @@ ref<Expr> ObjectState::read(ref<Expr> offset, Expr::Width width) const {
 }
 
 ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
+  materialize();
+
   // Treat bool specially, it is the only non-byte sized write we allow.
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
@@ -500,6 +716,8 @@ ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
 }
 
 void ObjectState::write(ref<Expr> offset, ref<Expr> value) {
+  materialize();
+
   // Truncate offset to 32-bits.
   offset = ZExtExpr::create(offset, Expr::Int32);
 
@@ -527,6 +745,8 @@ void ObjectState::write(ref<Expr> offset, ref<Expr> value) {
 }
 
 void ObjectState::write(unsigned offset, ref<Expr> value) {
+  materialize();
+
   // Check for writes of constant values.
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
     Expr::Width w = CE->getWidth();
@@ -584,6 +804,7 @@ void ObjectState::write64(unsigned offset, uint64_t value) {
 }
 
 void ObjectState::print() {
+  materialize();
   llvm::errs() << "-- ObjectState --\n";
   llvm::errs() << "\tMemoryObject ID: " << object->id << "\n";
   llvm::errs() << "\tRoot Object: " << updates.root << "\n";
@@ -26,6 +26,7 @@ namespace klee {
 
 class BitArray;
 class MemoryManager;
+struct StorePage;
 class Solver;
 class ArrayCache;
 
@@ -33,6 +34,8 @@ class MemoryObject {
   friend class STPBuilder;
   friend class ObjectState;
   friend class ExecutionState;
+  friend struct Symbolic;
+  friend class StateSpiller;
 
 private:
   static int counter;
@@ -61,6 +64,16 @@ public:
   /// it was allocated for (or whatever else makes sense).
   const llvm::Value *allocSite;
   
+  /// For objects allocated with a symbolic size, the size expression
+  /// (null otherwise). Such objects reserve \a size bytes, the maximal
+  /// value of the expression, and are bounds checked against it.
+  ref<Expr> symbolicSize;
+
+  /// The store version of the object state whose concrete contents were
+  /// last copied out to the object's address, see
+  /// AddressSpace::copyOutConcretes().
+  mutable uint64_t copiedOutVersion;
+
   /// A list of boolean expressions the user has requested be true of
   /// a counterexample. Mutable since we play a little fast and loose
   /// with allowing it to be added to during execution (although
@@ -81,7 +94,8 @@ public:
       size(0),
       isFixed(true),
       parent(NULL),
-      allocSite(0) {
+      allocSite(0),
+      copiedOutVersion(0) {
   }
 
   MemoryObject(uint64_t _address, unsigned _size, 
@@ -99,11 +113,16 @@ public:
       fake_object(false),
       isUserSpecified(false),
       parent(_parent), 
-      allocSite(_allocSite) {
+      allocSite(_allocSite),
+      copiedOutVersion(0) {
   }
 
   ~MemoryObject();
 
+  /// Memory objects are recycled through a pool, see FixedSizeAllocator.
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr, size_t size);
+
   /// Get an identifying string for this allocation.
   void getAllocInfo(std::string &result) const;
 
@@ -117,6 +136,13 @@ public:
   ref<ConstantExpr> getSizeExpr() const { 
     return ConstantExpr::create(size, Context::get().getPointerWidth());
   }
+  /// Get the size of the object, which is symbolic for objects allocated
+  /// with a symbolic size.
+  ref<Expr> getActualSizeExpr() const {
+    if (symbolicSize.isNull())
+      return getSizeExpr();
+    return ZExtExpr::create(symbolicSize, Context::get().getPointerWidth());
+  }
   ref<Expr> getOffsetExpr(ref<Expr> pointer) const {
     return SubExpr::create(pointer, getBaseExpr());
   }
@@ -128,7 +154,13 @@ public:
   }
 
   ref<Expr> getBoundsCheckOffset(ref<Expr> offset) const {
-    if (size==0) {
+    if (!symbolicSize.isNull()) {
+      ref<Expr> sizeExpr = getActualSizeExpr();
+      ref<Expr> zero = ConstantExpr::alloc(0, Context::get().getPointerWidth());
+      return OrExpr::create(UltExpr::create(offset, sizeExpr),
+                            AndExpr::create(EqExpr::create(sizeExpr, zero),
+                                            EqExpr::create(offset, zero)));
+    } else if (size==0) {
       return EqExpr::create(offset, 
                             ConstantExpr::alloc(0, Context::get().getPointerWidth()));
     } else {
@@ -136,7 +168,15 @@ public:
     }
   }
   ref<Expr> getBoundsCheckOffset(ref<Expr> offset, unsigned bytes) const {
-    if (bytes<=size) {
+    if (!symbolicSize.isNull()) {
+      // offset + bytes <= size, phrased to avoid overflow
+      ref<Expr> sizeExpr = getActualSizeExpr();
+      ref<Expr> bytesExpr =
+          ConstantExpr::alloc(bytes, Context::get().getPointerWidth());
+      return AndExpr::create(
+          UleExpr::create(bytesExpr, sizeExpr),
+          UleExpr::create(offset, SubExpr::create(sizeExpr, bytesExpr)));
+    } else if (bytes<=size) {
       return UltExpr::create(offset, 
                              ConstantExpr::alloc(size - bytes + 1, 
                                                  Context::get().getPointerWidth()));
@@ -146,6 +186,16 @@ public:
   }
 };
 
+/// Computes the initial contents of an object state on demand, see
+/// ObjectState::setLazyInitializer().
+class ObjectInitializer {
+public:
+  virtual ~ObjectInitializer() {}
+
+  /// Write the initial contents of the object into \a os.
+  virtual void initialize(ObjectState *os) const = 0;
+};
+
 class ObjectState {
 private:
   friend class AddressSpace;
@@ -154,9 +204,25 @@ private:
   friend class ObjectHolder;
   unsigned refCount;
 
+  friend class StateSpiller;
+
   const MemoryObject *object;
 
-  uint8_t *concreteStore;
+  /// The concrete contents, split into reference counted pages which are
+  /// shared with copies of this object state until either is written.
+  /// Points to singlePage for objects which fit into a single page.
+  /// mutable because the contents may be materialized during read of const
+  mutable StorePage **pages;
+  mutable StorePage *singlePage;
+
+  /// Identifies the concrete contents, copies share the version of the
+  /// original until either is written. Zero if the contents were changed
+  /// since a version was last assigned, see AddressSpace.
+  mutable uint64_t storeVersion;
+
+  /// Non-null while the contents have not been materialized yet.
+  mutable const ObjectInitializer *lazyInitializer;
+
   // XXX cleanup name of flushMask (its backwards or something)
   BitArray *concreteMask;
 
@@ -168,6 +234,14 @@ private:
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
+  /// The number of bytes taken by the allocated object states and their
+  /// masks and known symbolic contents, see getNumAllocatedBytes().
+  static size_t allocatedBytes;
+
+  /// Get the number of bytes taken by the masks and the known symbolic
+  /// contents of this object state.
+  size_t getMetadataBytes() const;
+
 public:
   unsigned size;
 
@@ -183,13 +257,36 @@ public:
   /// contents.
   ObjectState(const MemoryObject *mo, const Array *array);
 
+  /// Create a new object state for the given memory object whose
+  /// contents are computed by \a init when the object is first
+  /// accessed. Materializing the contents does not change them
+  /// observably, so the object can be shared between states as usual.
+  /// The initializer must outlive the object state.
+  ObjectState(const MemoryObject *mo, const ObjectInitializer *init);
+
   ObjectState(const ObjectState &os);
   ~ObjectState();
 
+  /// Object states are recycled through a pool, see FixedSizeAllocator.
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr, size_t size);
+
+  /// Get the number of bytes taken by the object states which are
+  /// currently allocated, not counting their pages, see
+  /// PageStore::getAllocatedSize().
+  static size_t getNumAllocatedBytes() { return allocatedBytes; }
+
+  /// Get the number of bytes which are freed when this object state is
+  /// deleted: the object state, its masks and known symbolic contents and
+  /// the pages it does not share.
+  size_t getPrivateBytes() const;
+
   const MemoryObject *getObject() const { return object; }
 
   void setReadOnly(bool ro) { readOnly = ro; }
 
+  bool isMaterialized() const { return !lazyInitializer; }
+
   // make contents all concrete and zero
   void initializeToZero();
   // make contents all concrete and random
@@ -209,6 +306,30 @@ public:
   void write64(unsigned offset, uint64_t value);
 
 private:
+  /// Compute the contents of a lazily initialized object.
+  void materialize() const {
+    if (lazyInitializer)
+      materializeSlow();
+  }
+  void materializeSlow() const;
+
+  unsigned getNumPages() const;
+  void allocatePages() const;
+  void releasePages();
+  /// Replace the concrete contents by \a value, sharing filled pages.
+  void fillPages(uint8_t value) const;
+
+  uint8_t getConcreteByte(unsigned offset) const;
+  void setConcreteByte(unsigned offset, uint8_t value);
+  StorePage *getWriteablePage(unsigned index);
+
+  /// Copy the concrete contents to \a dest.
+  void copyConcreteTo(uint8_t *dest) const;
+  /// Update the concrete contents from \a src, cloning only the pages
+  /// which differ. Returns false if the contents were not changed.
+  bool copyConcreteFrom(const uint8_t *src);
+  bool concreteEquals(const uint8_t *src) const;
+
   const UpdateList &getUpdates() const;
 
   void makeConcrete();
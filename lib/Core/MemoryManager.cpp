@@ -30,10 +30,24 @@ llvm::cl::opt<bool> DeterministicAllocation(
 
 llvm::cl::opt<unsigned> DeterministicAllocationSize(
     "allocate-determ-size",
-    llvm::cl::desc(
-        "Preallocated memory for deterministic allocation in MB (default=100)"),
+    llvm::cl::desc("Address space reserved for deterministic allocation in MB. "
+                   "Memory is only committed when used (default=65536)"),
+    llvm::cl::init(65536));
+
+llvm::cl::opt<unsigned> DeterministicAllocationCommitSize(
+    "allocate-determ-commit-size",
+    llvm::cl::desc("Granularity in which memory for deterministic allocation "
+                   "is committed in MB (default=100)"),
     llvm::cl::init(100));
 
+llvm::cl::opt<unsigned> DeterministicAllocationQuarantine(
+    "allocate-determ-quarantine",
+    llvm::cl::desc("Number of freed deterministic slots of each size class "
+                   "which are held back before the oldest one is reused. "
+                   "Delays the reuse of memory to expose use-after-free "
+                   "bugs (default=16)"),
+    llvm::cl::init(16));
+
 llvm::cl::opt<bool>
     NullOnZeroMalloc("return-null-on-zero-malloc",
                      llvm::cl::desc("Returns NULL in case malloc(size) was "
@@ -51,19 +65,44 @@ llvm::cl::opt<unsigned long long> DeterministicStartAddress(
     llvm::cl::desc("Start address for deterministic allocation. Has to be page "
                    "aligned (default=0x7ff30000000)."),
     llvm::cl::init(0x7ff30000000));
+
+/// Smallest slot handed out by the deterministic allocator; all slots are
+/// aligned to at least this.
+const uint64_t MinSlotSize = 16;
+/// Requests up to this size are rounded up to a power-of-two size class.
+const uint64_t MaxSizeClass = 1 << 16;
+/// Size classes up to this size are carved out of slabs in bulk.
+const uint64_t MaxSlabClass = 4096;
+const uint64_t SlabSize = 1 << 16;
+const uint64_t PageSize = 4096;
+
+/// Returns the size of the deterministic slot used for an object of the
+/// given size (not including its red zone).
+uint64_t getSlotSize(uint64_t size) {
+  if (size <= MinSlotSize)
+    return MinSlotSize;
+  if (size <= MaxSizeClass)
+    return llvm::NextPowerOf2(size - 1);
+  return llvm::RoundUpToAlignment(size, PageSize);
+}
 }
 
 /***/
 MemoryManager::MemoryManager(ArrayCache *_arrayCache)
     : arrayCache(_arrayCache), deterministicSpace(0), nextFreeSlot(0),
-      spaceSize(DeterministicAllocationSize.getValue() * 1024 * 1024) {
+      committedEnd(0),
+      spaceSize((size_t)DeterministicAllocationSize.getValue() * 1024 * 1024),
+      chunkSize((size_t)DeterministicAllocationCommitSize.getValue() * 1024 *
+                1024) {
   if (DeterministicAllocation) {
     // Page boundary
     void *expectedAddress = (void *)DeterministicStartAddress.getValue();
 
+    // Only reserve the address range, pages are committed chunk by chunk
+    // as the allocator reaches them.
     char *newSpace =
-        (char *)mmap(expectedAddress, spaceSize, PROT_READ | PROT_WRITE,
-                     MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        (char *)mmap(expectedAddress, spaceSize, PROT_NONE,
+                     MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
 
     if (newSpace == MAP_FAILED) {
       klee_error("Couldn't mmap() memory for deterministic allocations");
@@ -75,6 +114,11 @@ MemoryManager::MemoryManager(ArrayCache *_arrayCache)
     klee_message("Deterministic memory allocation starting from %p", newSpace);
     deterministicSpace = newSpace;
     nextFreeSlot = newSpace;
+    committedEnd = newSpace;
+    if (!chunkSize)
+      chunkSize = PageSize;
+    if (!commitSpace(std::min(chunkSize, spaceSize)))
+      klee_error("Couldn't commit memory for deterministic allocations");
   }
 }
 
@@ -111,21 +155,11 @@ MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
 
   uint64_t address = 0;
   if (DeterministicAllocation) {
-
-    address = llvm::RoundUpToAlignment((uint64_t)nextFreeSlot + alignment - 1,
-                                       alignment);
-
-    // Handle the case of 0-sized allocations as 1-byte allocations.
-    // This way, we make sure we have this allocation between its own red zones
-    size_t alloc_size = std::max(size, (uint64_t)1);
-    if ((char *)address + alloc_size < deterministicSpace + spaceSize) {
-      nextFreeSlot = (char *)address + alloc_size + RedZoneSpace;
-    } else {
+    address = allocateDeterministic(size, alignment);
+    if (!address)
       klee_warning_once(0, "Couldn't allocate %" PRIu64
                            " bytes. Not enough deterministic space left.",
                         size);
-      address = 0;
-    }
   } else {
     // Use malloc for the standard case
     if (alignment <= 8)
@@ -167,12 +201,91 @@ MemoryObject *MemoryManager::allocateFixed(uint64_t address, uint64_t size,
   return res;
 }
 
+bool MemoryManager::commitSpace(size_t size) {
+  size_t committed = committedEnd - deterministicSpace;
+  if (size <= committed)
+    return true;
+
+  // Grow in whole chunks, but never beyond the reserved range.
+  size_t newCommitted =
+      std::min((size_t)llvm::RoundUpToAlignment(size, chunkSize), spaceSize);
+  if (size > newCommitted)
+    return false;
+  if (mprotect(committedEnd, newCommitted - committed,
+               PROT_READ | PROT_WRITE) != 0) {
+    klee_warning("Couldn't commit memory for deterministic allocations");
+    return false;
+  }
+  committedEnd = deterministicSpace + newCommitted;
+  return true;
+}
+
+uint64_t MemoryManager::allocateFromSpace(uint64_t size, size_t alignment) {
+  uint64_t address =
+      llvm::RoundUpToAlignment((uint64_t)nextFreeSlot, alignment);
+  size_t end = (char *)address + size - deterministicSpace;
+  if (end > spaceSize || !commitSpace(end))
+    return 0;
+  nextFreeSlot = (char *)address + size;
+  return address;
+}
+
+uint64_t MemoryManager::allocateDeterministic(uint64_t size,
+                                              size_t alignment) {
+  uint64_t slotSize = getSlotSize(size);
+
+  // Every slot is aligned to MinSlotSize, so only over-aligned requests
+  // cannot be served from the size classes.
+  if (alignment <= MinSlotSize) {
+    SizeClass &sc = sizeClasses[slotSize];
+    if (sc.freed.size() > DeterministicAllocationQuarantine) {
+      uint64_t address = sc.freed.front();
+      sc.freed.pop_front();
+      return address;
+    }
+
+    if (sc.fresh.empty() && slotSize <= MaxSlabClass) {
+      uint64_t stride =
+          llvm::RoundUpToAlignment(slotSize + RedZoneSpace, MinSlotSize);
+      uint64_t count = std::max(SlabSize / stride, (uint64_t)1);
+      if (uint64_t slab = allocateFromSpace(count * stride, MinSlotSize)) {
+        // Push in reverse so that slots are handed out in address order.
+        for (uint64_t i = count; i != 0; --i)
+          sc.fresh.push_back(slab + (i - 1) * stride);
+      }
+    }
+    if (!sc.fresh.empty()) {
+      uint64_t address = sc.fresh.back();
+      sc.fresh.pop_back();
+      return address;
+    }
+
+    if (uint64_t address =
+            allocateFromSpace(slotSize + RedZoneSpace, MinSlotSize))
+      return address;
+
+    // The space is used up, so cut the quarantine short.
+    if (!sc.freed.empty()) {
+      uint64_t address = sc.freed.front();
+      sc.freed.pop_front();
+      return address;
+    }
+    return 0;
+  }
+
+  return allocateFromSpace(slotSize + RedZoneSpace, alignment);
+}
+
 void MemoryManager::deallocate(const MemoryObject *mo) { assert(0); }
 
 void MemoryManager::markFreed(MemoryObject *mo) {
   if (objects.find(mo) != objects.end()) {
-    if (!mo->isFixed && !DeterministicAllocation)
-      free((void *)mo->address);
+    if (!mo->isFixed) {
+      if (DeterministicAllocation)
+        sizeClasses[getSlotSize(mo->size)].freed.push_back(mo->address);
+      else
+        free((void *)mo->address);
+    }
     objects.erase(mo);
   }
 }
@@ -10,7 +10,10 @@
 #ifndef KLEE_MEMORYMANAGER_H
 #define KLEE_MEMORYMANAGER_H
 
+#include <deque>
+#include <map>
 #include <set>
+#include <vector>
 #include <stdint.h>
 
 namespace llvm {
@@ -27,9 +30,45 @@ private:
   objects_ty objects;
   ArrayCache *const arrayCache;
 
+  /// The deterministic space is a reserved address range of spaceSize
+  /// bytes. Only [deterministicSpace, committedEnd) is backed by memory,
+  /// it grows in steps of chunkSize as allocation proceeds.
   char *deterministicSpace;
   char *nextFreeSlot;
+  char *committedEnd;
   size_t spaceSize;
+  size_t chunkSize;
+
+  /// The slots of one size class of the deterministic space.
+  struct SizeClass {
+    /// Slots carved out of a slab which were never handed out, the next
+    /// one last.
+    std::vector<uint64_t> fresh;
+    /// Freed slots, oldest first. They are reused in FIFO order and only
+    /// once more than --allocate-determ-quarantine slots of the class were
+    /// freed, so that a dangling pointer does not point into the next
+    /// object allocated.
+    std::deque<uint64_t> freed;
+  };
+
+  /// The size classes of the deterministic space, keyed by slot size.
+  /// Small requests are rounded up to a power-of-two size class and served
+  /// from slabs, larger ones are rounded up to whole pages. The order in
+  /// which slots are reused keeps addresses reproducible across runs.
+  typedef std::map<uint64_t, SizeClass> size_classes_ty;
+  size_classes_ty sizeClasses;
+
+  /// Make sure that the first \a size bytes of the deterministic space
+  /// are committed. Returns false if the reserved range is too small.
+  bool commitSpace(size_t size);
+
+  /// Reserve \a size bytes with the given alignment from the unused tail
+  /// of the deterministic space. Returns 0 if the space is exhausted.
+  uint64_t allocateFromSpace(uint64_t size, size_t alignment);
+
+  /// Obtain a slot for an object of \a size bytes from the deterministic
+  /// space, reusing a freed slot of the same size class if possible.
+  uint64_t allocateDeterministic(uint64_t size, size_t alignment);
 
 public:
   MemoryManager(ArrayCache *arrayCache);
@@ -18,7 +18,8 @@ using namespace klee;
 
   /* *** */
 
-PTree::PTree(const data_type &_root) : root(new Node(0,_root)) {
+PTree::PTree(const data_type &_root)
+  : numNodes(1), root(new Node(0,_root)) {
 }
 
 PTree::~PTree() {}
@@ -30,6 +31,7 @@ PTree::split(Node *n,
   assert(n && !n->left && !n->right);
   n->left = new Node(n, leftData);
   n->right = new Node(n, rightData);
+  numNodes += 2;
   return std::make_pair(n->left, n->right);
 }
 
@@ -46,10 +48,15 @@ void PTree::remove(Node *n) {
       }
     }
     delete n;
+    --numNodes;
     n = p;
   } while (n && !n->left && !n->right);
 }
 
+size_t PTree::getNumAllocatedBytes() const {
+  return numNodes * sizeof(PTreeNode);
+}
+
 void PTree::dump(llvm::raw_ostream &os) {
   ExprPPrinter *pp = ExprPPrinter::create(os);
   pp->setNewline("\\l");
@@ -18,6 +18,8 @@ namespace klee {
   class PTree { 
     typedef ExecutionState* data_type;
 
+    unsigned numNodes;
+
   public:
     typedef class PTreeNode Node;
     Node *root;
@@ -30,6 +32,9 @@ namespace klee {
                                  const data_type &rightData);
     void remove(Node *n);
 
+    /// Get the number of bytes taken by the nodes of the tree.
+    size_t getNumAllocatedBytes() const;
+
     void dump(llvm::raw_ostream &os);
   };
 
@@ -0,0 +1,128 @@
+//===-- PageStore.cpp -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PageStore.h"
+
+#include "klee/Internal/ADT/FixedSizeAllocator.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+#include <sys/mman.h>
+
+using namespace klee;
+
+namespace {
+  /// Number of full pages reserved with a single mmap() call.
+  const unsigned PagesPerChunk = 256;
+
+  struct PageStoreImpl {
+    FixedSizeAllocator headers;
+    std::vector<uint8_t *> freePages;
+    std::map<uint8_t, StorePage *> filledPages;
+    uint64_t reservedSize;
+    /// Bytes taken by the live pages, including their headers.
+    uint64_t allocatedSize;
+
+    PageStoreImpl()
+        : headers(sizeof(StorePage)), reservedSize(0), allocatedSize(0) {}
+
+    uint8_t *allocateFullPage() {
+      if (freePages.empty()) {
+        size_t chunkSize = (size_t)PagesPerChunk * PageStore::PageSize;
+        void *chunk = mmap(0, chunkSize, PROT_READ | PROT_WRITE,
+                           MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (chunk == MAP_FAILED)
+          klee_error("Couldn't mmap() memory for object contents");
+        reservedSize += chunkSize;
+        for (unsigned i = PagesPerChunk; i != 0; --i)
+          freePages.push_back((uint8_t *)chunk +
+                              (size_t)(i - 1) * PageStore::PageSize);
+      }
+      uint8_t *data = freePages.back();
+      freePages.pop_back();
+      return data;
+    }
+  };
+
+  // Intentionally never destroyed, pages may still be released during
+  // static destruction.
+  PageStoreImpl &getImpl() {
+    static PageStoreImpl *impl = new PageStoreImpl();
+    return *impl;
+  }
+}
+
+const unsigned PageStore::PageSize;
+
+StorePage *PageStore::allocate(unsigned size) {
+  assert(size && size <= PageSize && "invalid page size");
+  PageStoreImpl &impl = getImpl();
+  StorePage *page;
+  impl.allocatedSize += sizeof(StorePage) + size;
+  if (size == PageSize) {
+    page = static_cast<StorePage *>(impl.headers.allocate());
+    page->data = impl.allocateFullPage();
+  } else {
+    // Partial pages keep their data right behind the header.
+    page = static_cast<StorePage *>(malloc(sizeof(StorePage) + size));
+    if (!page)
+      klee_error("Couldn't allocate memory for object contents");
+    page->data = reinterpret_cast<uint8_t *>(page + 1);
+  }
+  page->refCount = 1;
+  page->size = size;
+  page->immutable = false;
+  return page;
+}
+
+StorePage *PageStore::getFilled(unsigned size, uint8_t value) {
+  if (size != PageSize) {
+    StorePage *page = allocate(size);
+    memset(page->data, value, size);
+    return page;
+  }
+
+  StorePage *&page = getImpl().filledPages[value];
+  if (!page) {
+    // The store itself holds one reference, so the page is never freed.
+    page = allocate(PageSize);
+    memset(page->data, value, PageSize);
+    page->immutable = true;
+  }
+  retain(page);
+  return page;
+}
+
+StorePage *PageStore::clone(const StorePage *page) {
+  StorePage *res = allocate(page->size);
+  memcpy(res->data, page->data, page->size);
+  return res;
+}
+
+uint64_t PageStore::getUsedSize() {
+  PageStoreImpl &impl = getImpl();
+  return impl.reservedSize - (uint64_t)impl.freePages.size() * PageSize;
+}
+
+uint64_t PageStore::getAllocatedSize() { return getImpl().allocatedSize; }
+
+void PageStore::deallocate(StorePage *page) {
+  PageStoreImpl &impl = getImpl();
+  impl.allocatedSize -= sizeof(StorePage) + page->size;
+  if (page->size == PageSize) {
+    impl.freePages.push_back(page->data);
+    impl.headers.deallocate(page);
+  } else {
+    free(page);
+  }
+}
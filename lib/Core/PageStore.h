@@ -0,0 +1,76 @@
+//===-- PageStore.h ---------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PAGESTORE_H
+#define KLEE_PAGESTORE_H
+
+#include <stdint.h>
+
+namespace klee {
+
+/// A reference counted block of concrete bytes backing (part of) the
+/// concrete contents of one or more object states.
+///
+/// A page may be written in place only by its single owner. Pages which
+/// are referenced more than once, or which belong to the process wide set
+/// of immutable pages, have to be cloned before they are written.
+struct StorePage {
+  unsigned refCount;
+  unsigned size;
+  /// Immutable pages are never written in place, even by a single owner.
+  bool immutable;
+  uint8_t *data;
+
+  bool isWriteable() const { return refCount == 1 && !immutable; }
+};
+
+/// Process wide store of the pages backing object states.
+///
+/// Full pages are carved out of mmap'ed anonymous memory and recycled
+/// through a free list; the last, partial page of an object is allocated
+/// on its own. Objects which are filled with a single byte value (as
+/// zeroed and uninitialized allocations are) all share the same
+/// immutable page until they are written.
+class PageStore {
+public:
+  static const unsigned PageSize = 4096;
+
+  /// Allocate a private page of \a size bytes (at most PageSize), with
+  /// undefined contents and a reference count of one.
+  static StorePage *allocate(unsigned size);
+
+  /// Get a page of \a size bytes which are all \a value. Full pages are
+  /// shared and immutable. The returned reference is owned by the caller.
+  static StorePage *getFilled(unsigned size, uint8_t value);
+
+  /// Allocate a private copy of the given page.
+  static StorePage *clone(const StorePage *page);
+
+  static void retain(StorePage *page) { ++page->refCount; }
+
+  static void release(StorePage *page) {
+    if (--page->refCount == 0)
+      deallocate(page);
+  }
+
+  /// Number of bytes of mmap'ed memory taken by the full pages in use.
+  /// Released pages are kept for reuse, but are not counted.
+  static uint64_t getUsedSize();
+
+  /// Number of bytes taken by the pages which are currently allocated,
+  /// including their headers.
+  static uint64_t getAllocatedSize();
+
+private:
+  static void deallocate(StorePage *page);
+};
+
+} // End klee namespace
+
+#endif
@@ -41,9 +41,11 @@
 #include "llvm/IR/CallSite.h"
 #endif
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <climits>
+#include <limits>
 
 using namespace klee;
 using namespace llvm;
@@ -60,6 +62,45 @@ namespace klee {
 Searcher::~Searcher() {
 }
 
+namespace {
+  typedef std::pair<double, ExecutionState *> RankedState;
+
+  bool lessRank(const RankedState &a, const RankedState &b) {
+    return a.first < b.first;
+  }
+}
+
+/// Order \a states by their ranks, lowest first.
+static void sortByRank(std::vector<RankedState> &ranked,
+                       std::vector<ExecutionState *> &states) {
+  std::stable_sort(ranked.begin(), ranked.end(), lessRank);
+  for (unsigned i = 0, e = ranked.size(); i != e; ++i)
+    states[i] = ranked[i].second;
+}
+
+/// Order \a states like the range [\a begin, \a end), putting the states
+/// which are not in the range last.
+template <class Iterator>
+static void rankByOrder(std::vector<ExecutionState *> &states,
+                        Iterator begin, Iterator end) {
+  std::map<ExecutionState *, unsigned> positions;
+  unsigned position = 0;
+  for (; begin != end; ++begin)
+    positions[*begin] = position++;
+
+  std::vector<RankedState> ranked;
+  for (std::vector<ExecutionState *>::iterator it = states.begin(),
+                                               ie = states.end();
+       it != ie; ++it) {
+    std::map<ExecutionState *, unsigned>::iterator pos = positions.find(*it);
+    ranked.push_back(std::make_pair(
+        pos == positions.end() ? std::numeric_limits<double>::infinity()
+                               : double(pos->second),
+        *it));
+  }
+  sortByRank(ranked, states);
+}
+
 ///
 
 ExecutionState &DFSSearcher::selectState() {
@@ -95,6 +136,12 @@ void DFSSearcher::update(ExecutionState *current,
   }
 }
 
+bool DFSSearcher::rankForEviction(std::vector<ExecutionState *> &states) {
+  // The states which were added first are selected last.
+  rankByOrder(states, this->states.begin(), this->states.end());
+  return true;
+}
+
 ///
 
 ExecutionState &BFSSearcher::selectState() {
@@ -140,6 +187,12 @@ void BFSSearcher::update(ExecutionState *current,
   }
 }
 
+bool BFSSearcher::rankForEviction(std::vector<ExecutionState *> &states) {
+  // The states which were added last are selected last.
+  rankByOrder(states, this->states.rbegin(), this->states.rend());
+  return true;
+}
+
 ///
 
 ExecutionState &RandomSearcher::selectState() {
@@ -264,6 +317,22 @@ bool WeightedRandomSearcher::empty() {
   return states->empty(); 
 }
 
+bool WeightedRandomSearcher::rankForEviction(
+    std::vector<ExecutionState *> &states) {
+  // The states with the lowest weights are the least likely to be selected.
+  std::vector<RankedState> ranked;
+  for (std::vector<ExecutionState *>::iterator it = states.begin(),
+                                               ie = states.end();
+       it != ie; ++it) {
+    ExecutionState *es = *it;
+    double weight = this->states->inTree(es) ? this->states->getWeight(es)
+                                             : getWeight(es);
+    ranked.push_back(std::make_pair(weight, es));
+  }
+  sortByRank(ranked, states);
+  return true;
+}
+
 ///
 
 RandomPathSearcher::RandomPathSearcher(Executor &_executor)
@@ -345,6 +414,18 @@ void SonarSearcher::update(
   }
 }
 
+bool SonarSearcher::rankForEviction(std::vector<ExecutionState *> &states) {
+  // The states farthest from the target are selected last.
+  std::vector<ExecutionState *> order;
+  for (std::multimap<uint64_t, ExecutionState *>::reverse_iterator
+           it = distanceStore.rbegin(),
+           ie = distanceStore.rend();
+       it != ie; ++it)
+    order.push_back(it->second);
+  rankByOrder(states, order.begin(), order.end());
+  return true;
+}
+
 uint64_t SonarSearcher::calcFutureDistance(ExecutionState* state) {
   return this->scanner.getDistance2Target(state);
 }
@@ -537,6 +618,8 @@ entry:
       statesAtMerge.insert(std::make_pair(mp, &es));
     } else {
       ExecutionState *mergeWith = it->second;
+      executor.reloadState(*mergeWith);
+      executor.reloadState(es);
       if (mergeWith->merge(es)) {
         // hack, because we are terminating the state we need to let
         // the baseSearcher know about it again
@@ -629,6 +712,9 @@ ExecutionState &MergingSearcher::selectState() {
 
     // merge states
     std::set<ExecutionState*> toMerge(it->second.begin(), it->second.end());
+    for (std::set<ExecutionState*>::iterator sit = toMerge.begin(),
+           sie = toMerge.end(); sit != sie; ++sit)
+      executor.reloadState(**sit);
     while (!toMerge.empty()) {
       ExecutionState *base = *toMerge.begin();
       toMerge.erase(toMerge.begin());
@@ -825,3 +911,13 @@ void InterleavedSearcher::update(
          ie = searchers.end(); it != ie; ++it)
     (*it)->update(current, addedStates, removedStates);
 }
+
+bool InterleavedSearcher::rankForEviction(
+    std::vector<ExecutionState *> &states) {
+  // Use the ranking of the first searcher which has a preference.
+  for (searchers_ty::iterator it = searchers.begin(), ie = searchers.end();
+       it != ie; ++it)
+    if ((*it)->rankForEviction(states))
+      return true;
+  return false;
+}
@@ -55,6 +55,15 @@ namespace klee {
     virtual void activate() {}
     virtual void deactivate() {}
 
+    /// Order \a states by their utility to the search, least useful first,
+    /// so that the executor can evict the least useful states when it is
+    /// over the memory cap.
+    /// \return false if the searcher has no preference, in which case
+    /// \a states is left unchanged.
+    virtual bool rankForEviction(std::vector<ExecutionState *> &states) {
+      return false;
+    }
+
     // utility functions
 
     void addState(ExecutionState *es, ExecutionState *current = 0) {
@@ -93,6 +102,7 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return states.empty(); }
+    bool rankForEviction(std::vector<ExecutionState *> &states);
     void printName(llvm::raw_ostream &os) {
       os << "DFSSearcher\n";
     }
@@ -107,6 +117,7 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return states.empty(); }
+    bool rankForEviction(std::vector<ExecutionState *> &states);
     void printName(llvm::raw_ostream &os) {
       os << "BFSSearcher\n";
     }
@@ -153,6 +164,7 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty();
+    bool rankForEviction(std::vector<ExecutionState *> &states);
     void printName(llvm::raw_ostream &os) {
       os << "WeightedRandomSearcher::";
       switch(type) {
@@ -206,6 +218,7 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return distanceStore.empty(); }
+    bool rankForEviction(std::vector<ExecutionState *> &states);
     void printName(llvm::raw_ostream &os) {
       os << "SonarSearcher\n";
     }
@@ -245,6 +258,9 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return baseSearcher->empty() && statesAtMerge.empty(); }
+    bool rankForEviction(std::vector<ExecutionState *> &states) {
+      return baseSearcher->rankForEviction(states);
+    }
     void printName(llvm::raw_ostream &os) {
       os << "MergingSearcher\n";
     }
@@ -268,6 +284,9 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return baseSearcher->empty() && statesAtMerge.empty(); }
+    bool rankForEviction(std::vector<ExecutionState *> &states) {
+      return baseSearcher->rankForEviction(states);
+    }
     void printName(llvm::raw_ostream &os) {
       os << "BumpMergingSearcher\n";
     }
@@ -293,6 +312,9 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return baseSearcher->empty(); }
+    bool rankForEviction(std::vector<ExecutionState *> &states) {
+      return baseSearcher->rankForEviction(states);
+    }
     void printName(llvm::raw_ostream &os) {
       os << "<BatchingSearcher> timeBudget: " << timeBudget
          << ", instructionBudget: " << instructionBudget
@@ -316,6 +338,9 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return baseSearcher->empty() && pausedStates.empty(); }
+    bool rankForEviction(std::vector<ExecutionState *> &states) {
+      return baseSearcher->rankForEviction(states);
+    }
     void printName(llvm::raw_ostream &os) {
       os << "IterativeDeepeningTimeSearcher\n";
     }
@@ -336,6 +361,7 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return searchers[0]->empty(); }
+    bool rankForEviction(std::vector<ExecutionState *> &states);
     void printName(llvm::raw_ostream &os) {
       os << "<InterleavedSearcher> containing "
          << searchers.size() << " searchers:\n";
@@ -549,9 +549,9 @@ void SpecialFunctionHandler::handleGetObjSize(ExecutionState &state,
          ie = rl.end(); it != ie; ++it) {
     executor.bindLocal(
         target, *it->second,
-        ConstantExpr::create(it->first.first->size,
-                             executor.kmodule->targetData->getTypeSizeInBits(
-                                 target->inst->getType())));
+        ZExtExpr::create(it->first.first->getActualSizeExpr(),
+                         executor.kmodule->targetData->getTypeSizeInBits(
+                             target->inst->getType())));
   }
 }
 
@@ -723,7 +723,7 @@ void SpecialFunctionHandler::handleMakeSymbolic(ExecutionState &state,
       executor.solver->mustBeTrue(*s, 
                                   EqExpr::create(ZExtExpr::create(arguments[1],
                                                                   Context::get().getPointerWidth()),
-                                                 mo->getSizeExpr()),
+                                                 mo->getActualSizeExpr()),
                                   res);
     assert(success && "FIXME: Unhandled solver failure");
     
@@ -0,0 +1,519 @@
+//===-- StateSpiller.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "StateSpiller.h"
+
+#include "Memory.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Expr.h"
+#include "klee/Internal/Module/Cell.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/util/BitArray.h"
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+  // Tags of the values in a record.
+  enum {
+    NullTag,
+    ExprRefTag,
+    ExprTag,
+    UpdateNodeTag,
+    UpdateListTag
+  };
+
+  /// Terminates the list of spilled registers of a stack frame.
+  const uint32_t NoRegister = ~0U;
+}
+
+/// Serializes the contents of a state. Expressions and update nodes are
+/// written once and referred to by number afterwards, kids before their
+/// parents, so that they can be rebuilt bottom up.
+class StateSpiller::Writer {
+  std::string buffer;
+  std::map<const Expr *, unsigned> exprIds;
+  std::map<const UpdateNode *, unsigned> updateIds;
+
+  void writeUpdateNodeRef(const UpdateNode *un) {
+    write<uint32_t>(un ? updateIds[un] + 1 : 0);
+  }
+
+public:
+  template <typename T> void write(const T &value) {
+    buffer.append((const char *) &value, sizeof(value));
+  }
+
+  void writeBytes(const void *data, unsigned size) {
+    buffer.append((const char *) data, size);
+  }
+
+  void writeBits(BitArray *bits, unsigned size) {
+    write<uint8_t>(bits != 0);
+    if (!bits)
+      return;
+    for (unsigned i = 0; i < size; i += 8) {
+      uint8_t byte = 0;
+      for (unsigned j = i; j < i + 8 && j < size; ++j)
+        byte |= bits->get(j) << (j - i);
+      write(byte);
+    }
+  }
+
+  void writeExpr(const ref<Expr> &e) {
+    if (e.isNull()) {
+      write<uint8_t>(NullTag);
+      return;
+    }
+    std::map<const Expr *, unsigned>::iterator it = exprIds.find(e.get());
+    if (it != exprIds.end()) {
+      write<uint8_t>(ExprRefTag);
+      write<uint32_t>(it->second);
+      return;
+    }
+
+    write<uint8_t>(ExprTag);
+    write<uint8_t>(e->getKind());
+    write<uint32_t>(e->getWidth());
+    switch (e->getKind()) {
+    case Expr::Constant: {
+      const llvm::APInt &value = cast<ConstantExpr>(e)->getAPValue();
+      writeBytes(value.getRawData(), value.getNumWords() * sizeof(uint64_t));
+      break;
+    }
+    case Expr::Read: {
+      ReadExpr *re = cast<ReadExpr>(e);
+      writeUpdates(re->updates);
+      writeExpr(re->index);
+      break;
+    }
+    case Expr::Extract:
+      write<uint32_t>(cast<ExtractExpr>(e)->offset);
+      // Fall through.
+    default:
+      for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+        writeExpr(e->getKid(i));
+    }
+    unsigned id = exprIds.size();
+    exprIds[e.get()] = id;
+  }
+
+  void writeUpdates(const UpdateList &ul) {
+    // The nodes which were not written yet, newest first.
+    std::vector<const UpdateNode *> nodes;
+    for (const UpdateNode *un = ul.head; un && !updateIds.count(un);
+         un = un->next)
+      nodes.push_back(un);
+
+    for (std::vector<const UpdateNode *>::reverse_iterator
+           it = nodes.rbegin(), ie = nodes.rend(); it != ie; ++it) {
+      const UpdateNode *un = *it;
+      // The index or value may read an older version of the same list,
+      // which writes the older nodes itself.
+      if (updateIds.count(un))
+        continue;
+      write<uint8_t>(UpdateNodeTag);
+      writeUpdateNodeRef(un->next);
+      writeExpr(un->index);
+      writeExpr(un->value);
+      unsigned id = updateIds.size();
+      updateIds[un] = id;
+    }
+
+    write<uint8_t>(UpdateListTag);
+    write(ul.root);
+    writeUpdateNodeRef(ul.head);
+  }
+
+  const std::string &getBuffer() const { return buffer; }
+};
+
+/// Reads back what a Writer wrote.
+class StateSpiller::Reader {
+  const char *pos, *end;
+  std::vector<ref<Expr> > exprs;
+  /// The rebuilt update nodes, held by lists without a root.
+  std::vector<UpdateList> updateNodes;
+
+  const UpdateNode *readUpdateNodeRef() {
+    uint32_t id = read<uint32_t>();
+    return id ? updateNodes[id - 1].head : 0;
+  }
+
+public:
+  Reader(const std::vector<char> &buffer)
+    : pos(&buffer[0]), end(&buffer[0] + buffer.size()) {}
+
+  template <typename T> T read() {
+    T value;
+    readBytes(&value, sizeof(value));
+    return value;
+  }
+
+  void readBytes(void *data, unsigned size) {
+    assert(pos + size <= end && "truncated record");
+    memcpy(data, pos, size);
+    pos += size;
+  }
+
+  BitArray *readBits(unsigned size) {
+    if (!read<uint8_t>())
+      return 0;
+    BitArray *bits = new BitArray(size);
+    for (unsigned i = 0; i < size; i += 8) {
+      uint8_t byte = read<uint8_t>();
+      for (unsigned j = i; j < i + 8 && j < size; ++j)
+        bits->set(j, (byte >> (j - i)) & 1);
+    }
+    return bits;
+  }
+
+  ref<Expr> readExpr() {
+    switch (read<uint8_t>()) {
+    case NullTag:
+      return 0;
+    case ExprRefTag:
+      return exprs[read<uint32_t>()];
+    default:
+      break;
+    }
+
+    Expr::Kind kind = (Expr::Kind) read<uint8_t>();
+    Expr::Width width = read<uint32_t>();
+    ref<Expr> res;
+    switch (kind) {
+    case Expr::Constant: {
+      assert(width && "invalid constant width");
+      std::vector<uint64_t> words((width + 63) / 64);
+      readBytes(&words[0], words.size() * sizeof(uint64_t));
+      res = ConstantExpr::alloc(
+          llvm::APInt(width, llvm::ArrayRef<uint64_t>(words)));
+      break;
+    }
+    case Expr::Read: {
+      UpdateList ul = readUpdates();
+      ref<Expr> index = readExpr();
+      res = ReadExpr::alloc(ul, index);
+      break;
+    }
+    case Expr::Extract: {
+      unsigned offset = read<uint32_t>();
+      ref<Expr> kid = readExpr();
+      res = ExtractExpr::alloc(kid, offset, width);
+      break;
+    }
+    case Expr::Select: {
+      ref<Expr> cond = readExpr();
+      ref<Expr> trueExpr = readExpr();
+      ref<Expr> falseExpr = readExpr();
+      res = SelectExpr::alloc(cond, trueExpr, falseExpr);
+      break;
+    }
+    case Expr::NotOptimized:
+      res = NotOptimizedExpr::alloc(readExpr());
+      break;
+    case Expr::Not:
+      res = NotExpr::alloc(readExpr());
+      break;
+    case Expr::ZExt:
+      res = ZExtExpr::alloc(readExpr(), width);
+      break;
+    case Expr::SExt:
+      res = SExtExpr::alloc(readExpr(), width);
+      break;
+
+#define BINARY_EXPR_CASE(T)                                                    \
+    case Expr::T: {                                                            \
+      ref<Expr> left = readExpr();                                             \
+      ref<Expr> right = readExpr();                                            \
+      res = T##Expr::alloc(left, right);                                       \
+      break;                                                                   \
+    }
+
+    BINARY_EXPR_CASE(Concat)
+    BINARY_EXPR_CASE(Add)
+    BINARY_EXPR_CASE(Sub)
+    BINARY_EXPR_CASE(Mul)
+    BINARY_EXPR_CASE(UDiv)
+    BINARY_EXPR_CASE(SDiv)
+    BINARY_EXPR_CASE(URem)
+    BINARY_EXPR_CASE(SRem)
+    BINARY_EXPR_CASE(And)
+    BINARY_EXPR_CASE(Or)
+    BINARY_EXPR_CASE(Xor)
+    BINARY_EXPR_CASE(Shl)
+    BINARY_EXPR_CASE(LShr)
+    BINARY_EXPR_CASE(AShr)
+    BINARY_EXPR_CASE(Eq)
+    BINARY_EXPR_CASE(Ne)
+    BINARY_EXPR_CASE(Ult)
+    BINARY_EXPR_CASE(Ule)
+    BINARY_EXPR_CASE(Ugt)
+    BINARY_EXPR_CASE(Uge)
+    BINARY_EXPR_CASE(Slt)
+    BINARY_EXPR_CASE(Sle)
+    BINARY_EXPR_CASE(Sgt)
+    BINARY_EXPR_CASE(Sge)
+#undef BINARY_EXPR_CASE
+
+    default:
+      assert(0 && "invalid expression kind in record");
+    }
+    exprs.push_back(res);
+    return res;
+  }
+
+  UpdateList readUpdates() {
+    while (read<uint8_t>() == UpdateNodeTag) {
+      const UpdateNode *next = readUpdateNodeRef();
+      ref<Expr> index = readExpr();
+      ref<Expr> value = readExpr();
+      UpdateList node(0, next);
+      node.extend(index, value);
+      updateNodes.push_back(node);
+    }
+    const Array *root = read<const Array *>();
+    return UpdateList(root, readUpdateNodeRef());
+  }
+
+  bool done() const { return pos == end; }
+};
+
+/***/
+
+StateSpiller::StateSpiller(const std::string &path) : fileSize(0) {
+  fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    klee_warning("unable to open \"%s\": %s", path.c_str(), strerror(errno));
+    return;
+  }
+  unlink(path.c_str());
+}
+
+StateSpiller::~StateSpiller() {
+  for (record_iterator it = records.begin(), ie = records.end(); it != ie;
+       ++it)
+    releaseObjects(it->second);
+  if (fd >= 0)
+    close(fd);
+}
+
+uint64_t StateSpiller::allocate(uint64_t size) {
+  // Reuse the smallest released record which is large enough.
+  std::multimap<uint64_t, uint64_t>::iterator it = freeSpace.lower_bound(size);
+  if (it == freeSpace.end()) {
+    uint64_t offset = fileSize;
+    fileSize += size;
+    return offset;
+  }
+
+  uint64_t offset = it->second, available = it->first;
+  freeSpace.erase(it);
+  if (available > size)
+    freeSpace.insert(std::make_pair(available - size, offset + size));
+  return offset;
+}
+
+void StateSpiller::releaseSpace(const Record &record) {
+  if (record.offset + record.size == fileSize)
+    fileSize = record.offset;
+  else
+    freeSpace.insert(std::make_pair(record.size, record.offset));
+}
+
+void StateSpiller::releaseObjects(const Record &record) {
+  for (std::vector<const MemoryObject *>::const_iterator
+         it = record.objects.begin(), ie = record.objects.end(); it != ie;
+       ++it) {
+    const MemoryObject *mo = *it;
+    assert(mo->refCount > 0);
+    if (--mo->refCount == 0)
+      delete mo;
+  }
+}
+
+void StateSpiller::remove(record_iterator it) {
+  releaseObjects(it->second);
+  releaseSpace(it->second);
+  records.erase(it);
+  if (records.empty()) {
+    // Start over with an empty file.
+    freeSpace.clear();
+    fileSize = 0;
+    if (ftruncate(fd, 0) < 0)
+      klee_warning_once(0, "unable to truncate spilled states: %s",
+                        strerror(errno));
+  }
+}
+
+void StateSpiller::writeObject(Writer &w, const ObjectState &os) {
+  w.write<uint8_t>(os.readOnly);
+  if (os.size) {
+    std::vector<uint8_t> concrete(os.size);
+    os.copyConcreteTo(&concrete[0]);
+    w.writeBytes(&concrete[0], os.size);
+  }
+  w.writeBits(os.concreteMask, os.size);
+  w.writeBits(os.flushMask, os.size);
+  w.write<uint8_t>(os.knownSymbolics != 0);
+  if (os.knownSymbolics)
+    for (unsigned i = 0; i < os.size; ++i)
+      w.writeExpr(os.knownSymbolics[i]);
+  w.writeUpdates(os.updates);
+}
+
+ObjectState *StateSpiller::readObject(Reader &r, const MemoryObject *mo) {
+  ObjectState *os = new ObjectState(mo);
+  os->readOnly = r.read<uint8_t>();
+  if (os->size) {
+    std::vector<uint8_t> concrete(os->size);
+    r.readBytes(&concrete[0], os->size);
+    os->copyConcreteFrom(&concrete[0]);
+  }
+  os->concreteMask = r.readBits(os->size);
+  os->flushMask = r.readBits(os->size);
+  if (r.read<uint8_t>()) {
+    os->knownSymbolics = new ref<Expr>[os->size];
+    for (unsigned i = 0; i < os->size; ++i)
+      os->knownSymbolics[i] = r.readExpr();
+  }
+  ObjectState::allocatedBytes += os->getMetadataBytes();
+  os->updates = r.readUpdates();
+  return os;
+}
+
+bool StateSpiller::spill(ExecutionState &state) {
+  assert(!isSpilled(state) && "state is already spilled");
+  if (fd < 0)
+    return false;
+
+  Writer w;
+  // The constraints shared with other states would stay in memory anyway.
+  unsigned numShared = state.constraints.getNumSharedConstraints();
+  w.write<uint32_t>(state.constraints.size() - numShared);
+  for (unsigned i = numShared, e = state.constraints.size(); i != e; ++i)
+    w.writeExpr(state.constraints[i]);
+
+  // Constants are cheap to keep, and are kept unboxed in the registers.
+  // Registers shared with another frame are kept as well.
+  for (ExecutionState::stack_ty::iterator it = state.stack.begin(),
+         ie = state.stack.end(); it != ie; ++it) {
+    if (it->hasSharedLocals()) {
+      w.write<uint32_t>(NoRegister);
+      continue;
+    }
+    for (unsigned i = 0, e = it->kf->numRegisters; i != e; ++i) {
+      const Cell &cell = it->getLocal(i);
+      if (cell.isImmediate() || cell.getValue().isNull())
+        continue;
+      w.write<uint32_t>(i);
+      w.writeExpr(cell.getValue());
+    }
+    w.write<uint32_t>(NoRegister);
+  }
+
+  // Only the objects which belong to this state alone are spilled, the
+  // others would stay in memory anyway.
+  std::vector<ObjectPair> objects;
+  for (MemoryMap::iterator it = state.addressSpace.objects.begin(),
+         ie = state.addressSpace.objects.end(); it != ie; ++it) {
+    const ObjectState *os = it->second;
+    if (state.addressSpace.owns(os) && os->refCount == 1 &&
+        os->isMaterialized())
+      objects.push_back(*it);
+  }
+  w.write<uint32_t>(objects.size());
+  for (std::vector<ObjectPair>::iterator it = objects.begin(),
+         ie = objects.end(); it != ie; ++it) {
+    w.write(it->first);
+    writeObject(w, *it->second);
+  }
+
+  const std::string &buffer = w.getBuffer();
+  Record record;
+  record.size = buffer.size();
+  record.offset = allocate(record.size);
+  for (uint64_t done = 0; done < record.size;) {
+    ssize_t res = pwrite(fd, buffer.data() + done, record.size - done,
+                         record.offset + done);
+    if (res < 0) {
+      klee_warning_once(0, "unable to spill states: %s", strerror(errno));
+      releaseSpace(record);
+      return false;
+    }
+    done += res;
+  }
+
+  // Release the contents, keeping the memory objects alive.
+  state.constraints.truncate(numShared);
+  for (ExecutionState::stack_ty::iterator it = state.stack.begin(),
+         ie = state.stack.end(); it != ie; ++it)
+    if (!it->hasSharedLocals())
+      for (unsigned i = 0, e = it->kf->numRegisters; i != e; ++i)
+        if (!it->getLocal(i).isImmediate())
+          it->getWriteableLocal(i).setValue(0);
+  for (std::vector<ObjectPair>::iterator it = objects.begin(),
+         ie = objects.end(); it != ie; ++it) {
+    record.objects.push_back(it->first);
+    ++it->first->refCount;
+    state.addressSpace.unbindObject(it->first);
+  }
+  records[&state] = record;
+  return true;
+}
+
+void StateSpiller::reload(ExecutionState &state) {
+  record_iterator it = records.find(&state);
+  assert(it != records.end() && "state is not spilled");
+  Record &record = it->second;
+
+  std::vector<char> buffer(record.size);
+  for (uint64_t done = 0; done < record.size;) {
+    ssize_t res = pread(fd, &buffer[done], record.size - done,
+                        record.offset + done);
+    if (res <= 0)
+      klee_error("unable to reload spilled state: %s",
+                 res < 0 ? strerror(errno) : "unexpected end of file");
+    done += res;
+  }
+
+  Reader r(buffer);
+  for (unsigned i = 0, e = r.read<uint32_t>(); i != e; ++i)
+    state.constraints.restoreConstraint(r.readExpr());
+
+  for (ExecutionState::stack_ty::iterator sit = state.stack.begin(),
+         sie = state.stack.end(); sit != sie; ++sit)
+    for (uint32_t i = r.read<uint32_t>(); i != NoRegister;
+         i = r.read<uint32_t>())
+      sit->getWriteableLocal(i).setValue(r.readExpr());
+
+  for (unsigned i = 0, e = r.read<uint32_t>(); i != e; ++i) {
+    const MemoryObject *mo = r.read<const MemoryObject *>();
+    state.addressSpace.bindObject(mo, readObject(r, mo));
+  }
+  assert(r.done() && "record not read completely");
+
+  // The object states hold on to the memory objects now.
+  remove(it);
+}
+
+void StateSpiller::discard(ExecutionState &state) {
+  record_iterator it = records.find(&state);
+  assert(it != records.end() && "state is not spilled");
+  remove(it);
+}
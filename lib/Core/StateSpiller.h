@@ -0,0 +1,101 @@
+//===-- StateSpiller.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATESPILLER_H
+#define KLEE_STATESPILLER_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace klee {
+  class ExecutionState;
+  class MemoryObject;
+  class ObjectState;
+
+  /// Moves the contents of execution states to a file on disk and back, so
+  /// that states waiting to be selected do not hold on to memory.
+  ///
+  /// A spilled state keeps everything needed to schedule it (its program
+  /// counter, stack frames, process tree node, statistics and symbolics),
+  /// but loses the data which belongs to it alone: the constraints it does
+  /// not share with other states, the non-constant values of the registers
+  /// of frames it does not share, and the objects its address space owns,
+  /// i.e. which it wrote since it was last forked. These are written to the
+  /// file and have to be reloaded before the state is used for anything
+  /// else.
+  ///
+  /// The file is only ever read by the process which wrote it, so records
+  /// refer to objects which outlive the states (arrays, memory objects,
+  /// instructions) by address.
+  class StateSpiller {
+    /// A spilled state's record in the file.
+    struct Record {
+      uint64_t offset, size;
+
+      /// The memory objects of the spilled object states, which are kept
+      /// alive while the state is spilled.
+      std::vector<const MemoryObject *> objects;
+    };
+
+    class Reader;
+    class Writer;
+
+    int fd;
+    std::map<const ExecutionState *, Record> records;
+
+    /// The end of the records in the file.
+    uint64_t fileSize;
+
+    /// The space of released records, by size.
+    std::multimap<uint64_t, uint64_t> freeSpace;
+
+    typedef std::map<const ExecutionState *, Record>::iterator record_iterator;
+
+    uint64_t allocate(uint64_t size);
+    void releaseSpace(const Record &record);
+    static void releaseObjects(const Record &record);
+    /// Release the space and the memory objects of a record and remove it.
+    void remove(record_iterator it);
+
+    static void writeObject(Writer &w, const ObjectState &os);
+    static ObjectState *readObject(Reader &r, const MemoryObject *mo);
+
+  public:
+    /// Create a spiller writing to the file \a path. The file is removed
+    /// right away, so that its space is reclaimed once it is closed.
+    explicit StateSpiller(const std::string &path);
+    ~StateSpiller();
+
+    bool isOpen() const { return fd >= 0; }
+
+    /// Get the number of states which are currently spilled.
+    unsigned getNumSpilled() const { return records.size(); }
+
+    bool isSpilled(const ExecutionState &state) const {
+      return !records.empty() && records.count(&state);
+    }
+
+    /// Write the contents of a state to disk and release them.
+    ///
+    /// \return false if the state could not be written, in which case it
+    /// is left unchanged.
+    bool spill(ExecutionState &state);
+
+    /// Restore the contents of a spilled state.
+    void reload(ExecutionState &state);
+
+    /// Forget the contents of a spilled state, which is about to be
+    /// deleted.
+    void discard(ExecutionState &state);
+  };
+}
+
+#endif
@@ -19,12 +19,17 @@
 #include "klee/Internal/System/MemoryUsage.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
 #include "klee/SolverStats.h"
 
 #include "CallPathManager.h"
 #include "CoreStats.h"
 #include "Executor.h"
+#include "Memory.h"
 #include "MemoryManager.h"
+#include "PageStore.h"
+#include "PTree.h"
 #include "UserSearcher.h"
 
 #if LLVM_VERSION_CODE > LLVM_VERSION(3, 2)
@@ -325,7 +330,8 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
         //
         // FIXME: This trick no longer works, we should fix this in the line
         // number propogation.
-          es.coveredLines[&ii.file].insert(ii.line);
+        if (executor.interpreterOpts.TrackCoveredLines)
+          es.coveredInstructions.set(ii.id);
 	es.coveredNew = true;
         es.instsSinceCovNew = 1;
 	++stats::coveredInstructions;
@@ -421,6 +427,15 @@ void StatsTracker::writeStatsHeader() {
              << "'CexCacheTime',"
              << "'ForkTime',"
              << "'ResolveTime',"
+             << "'QueryConstructTime',"
+             << "'ExprBuilderCacheHits',"
+             << "'ExprBuilderCacheMisses',"
+             << "'QueryNormalizationHits',"
+             << "'ExprMemory',"
+             << "'ObjectMemory',"
+             << "'ConstraintMemory',"
+             << "'SolverCacheMemory',"
+             << "'PTreeMemory',"
 #ifdef DEBUG
 	     << "'ArrayHashTime',"
 #endif
@@ -439,7 +454,9 @@ void StatsTracker::writeStatsLine() {
              << "," << numBranches
              << "," << util::getUserTime()
              << "," << executor.states.size()
-             << "," << util::GetTotalMallocUsage() + executor.memory->getUsedDeterministicSize()
+             << "," << util::GetTotalMallocUsage() +
+                       executor.memory->getUsedDeterministicSize() +
+                       PageStore::getUsedSize()
              << "," << stats::queries
              << "," << stats::queryConstructs
              << "," << 0 // was numObjects
@@ -451,6 +468,17 @@ void StatsTracker::writeStatsLine() {
              << "," << stats::cexCacheTime / 1000000.
              << "," << stats::forkTime / 1000000.
              << "," << stats::resolveTime / 1000000.
+             << "," << stats::queryConstructTime / 1000000.
+             << "," << stats::exprBuilderCacheHits
+             << "," << stats::exprBuilderCacheMisses
+             << "," << stats::queryNormalizationHits
+             << "," << Expr::getNumAllocatedBytes()
+             << "," << ObjectState::getNumAllocatedBytes() +
+                       PageStore::getAllocatedSize()
+             << "," << ConstraintManager::getNumAllocatedBytes()
+             << "," << SolverImpl::cacheBytes
+             << "," << (executor.processTree ?
+                        executor.processTree->getNumAllocatedBytes() : 0)
 #ifdef DEBUG
              << "," << stats::arrayHashTime / 1000000.
 #endif
@@ -459,7 +487,7 @@ void StatsTracker::writeStatsLine() {
 }
 
 void StatsTracker::updateStateStatistics(uint64_t addend) {
-  for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
+  for (std::vector<ExecutionState *>::iterator it = executor.states.begin(),
          ie = executor.states.end(); it != ie; ++it) {
     ExecutionState &state = **it;
     const InstructionInfo &ii = *state.pc->info;
@@ -888,7 +916,7 @@ void StatsTracker::computeReachableUncovered() {
     }
   } while (changed);
 
-  for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
+  for (std::vector<ExecutionState *>::iterator it = executor.states.begin(),
          ie = executor.states.end(); it != ie; ++it) {
     ExecutionState *es = *it;
     uint64_t currentFrameMinDist = 0;
@@ -0,0 +1,429 @@
+//===-- CompiledExpr.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/CompiledExpr.h"
+
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprHashMap.h"
+#include "klee/util/Bits.h"
+#include "klee/Internal/Support/IntEvaluation.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <map>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+  cl::opt<bool>
+  CompileExprs("compile-exprs",
+               cl::init(true),
+               cl::desc("Compile expressions which are evaluated under assignments repeatedly (default=on)"));
+
+  cl::opt<unsigned>
+  CompileExprsThreshold("compile-exprs-threshold",
+                        cl::init(2),
+                        cl::desc("Number of evaluations of an expression after which it is compiled (default=2)"));
+
+  /// Maximal number of cached compiled expressions, the cache is flushed
+  /// once it grows larger.
+  const unsigned MaxCachedExprs = 16384;
+
+  struct CacheEntry {
+    unsigned uses;
+    /// Null until compiled, and for expressions which cannot be compiled.
+    CompiledExpr *compiled;
+
+    CacheEntry() : uses(0), compiled(0) {}
+  };
+
+  typedef ExprHashMap<CacheEntry> cache_ty;
+
+  // Intentionally never destroyed, see Expr.cpp.
+  cache_ty &getCache() {
+    static cache_ty *cache = new cache_ty();
+    return *cache;
+  }
+
+  class Compiler {
+    std::vector<CompiledExpr::Instruction> &program;
+    std::vector<CompiledExpr::Update> &updates;
+    std::vector<const Array*> &arrays;
+
+    std::map<const Expr*, unsigned> registers;
+    std::map<const Array*, unsigned> arrayIds;
+    std::map<const UpdateNode*, std::pair<unsigned, unsigned> > updateRanges;
+
+  public:
+    Compiler(std::vector<CompiledExpr::Instruction> &_program,
+             std::vector<CompiledExpr::Update> &_updates,
+             std::vector<const Array*> &_arrays)
+      : program(_program), updates(_updates), arrays(_arrays) {}
+
+    /// Compile \a e into a register, returns false if it cannot be
+    /// compiled.
+    bool compile(const ref<Expr> &e, unsigned &reg);
+
+  private:
+    bool compileUpdates(const UpdateList &ul,
+                        std::pair<unsigned, unsigned> &range);
+  };
+}
+
+bool Compiler::compileUpdates(const UpdateList &ul,
+                              std::pair<unsigned, unsigned> &range) {
+  std::map<const UpdateNode*, std::pair<unsigned, unsigned> >::iterator it =
+    updateRanges.find(ul.head);
+  if (it != updateRanges.end()) {
+    range = it->second;
+    return true;
+  }
+
+  // Compile all indices and values first, so the updates of this list are
+  // contiguous. The newest update comes first.
+  std::vector<CompiledExpr::Update> list;
+  for (const UpdateNode *un = ul.head; un; un = un->next) {
+    CompiledExpr::Update u;
+    if (!compile(un->index, u.index) || !compile(un->value, u.value))
+      return false;
+    list.push_back(u);
+  }
+
+  range.first = updates.size();
+  updates.insert(updates.end(), list.begin(), list.end());
+  range.second = updates.size();
+  updateRanges.insert(std::make_pair(ul.head, range));
+  return true;
+}
+
+bool Compiler::compile(const ref<Expr> &e, unsigned &reg) {
+  std::map<const Expr*, unsigned>::iterator it = registers.find(e.get());
+  if (it != registers.end()) {
+    reg = it->second;
+    return true;
+  }
+
+  if (e->getWidth() > Expr::Int64)
+    return false;
+
+  CompiledExpr::Instruction inst;
+  inst.kind = e->getKind();
+  inst.width = e->getWidth();
+  inst.kidWidth = inst.width;
+  for (unsigned i = 0; i != 4; ++i)
+    inst.ops[i] = 0;
+
+  switch (e->getKind()) {
+  case Expr::Constant: {
+    uint64_t value = cast<ConstantExpr>(e)->getZExtValue();
+    inst.ops[0] = (unsigned) value;
+    inst.ops[1] = (unsigned) (value >> 32);
+    break;
+  }
+
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    std::pair<unsigned, unsigned> range;
+    if (!compile(re->index, inst.ops[0]) || !compileUpdates(re->updates, range))
+      return false;
+    const Array *array = re->updates.root;
+    std::map<const Array*, unsigned>::iterator id = arrayIds.find(array);
+    if (id == arrayIds.end()) {
+      id = arrayIds.insert(std::make_pair(array, arrays.size())).first;
+      arrays.push_back(array);
+    }
+    inst.ops[1] = id->second;
+    inst.ops[2] = range.first;
+    inst.ops[3] = range.second;
+    break;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    if (!compile(ee->expr, inst.ops[0]))
+      return false;
+    inst.ops[1] = ee->offset;
+    break;
+  }
+
+  default:
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i) {
+      assert(i < 3 && "unexpected number of kids");
+      if (!compile(e->getKid(i), inst.ops[i]))
+        return false;
+    }
+    if (e->getNumKids())
+      inst.kidWidth = e->getKid(0)->getWidth();
+    break;
+  }
+
+  reg = program.size();
+  program.push_back(inst);
+  registers.insert(std::make_pair(e.get(), reg));
+  return true;
+}
+
+CompiledExpr *CompiledExpr::compile(const ref<Expr> &e) {
+  CompiledExpr *res = new CompiledExpr();
+  Compiler compiler(res->program, res->updates, res->arrays);
+  unsigned reg;
+  if (!compiler.compile(e, reg)) {
+    delete res;
+    return 0;
+  }
+  assert(reg + 1 == res->program.size() && "expression not last");
+  return res;
+}
+
+/***/
+
+// The loops over all assignments for one instruction.
+#define FOR_EACH_LANE for (unsigned l = 0; l != n; ++l)
+
+void CompiledExpr::run(const Assignment *const *assignments, unsigned n,
+                       uint64_t *results, bool *valid) const {
+  // The bindings of each array under each assignment, null if unbound.
+  std::vector<const std::vector<unsigned char> *> bindings(arrays.size() * n);
+  for (unsigned i = 0, e = arrays.size(); i != e; ++i) {
+    FOR_EACH_LANE {
+      Assignment::bindings_ty::const_iterator it =
+        assignments[l]->bindings.find(arrays[i]);
+      bindings[i * n + l] =
+        it == assignments[l]->bindings.end() ? 0 : &it->second;
+    }
+  }
+
+  std::vector<uint64_t> registers(program.size() * n);
+  FOR_EACH_LANE
+    valid[l] = true;
+
+  for (unsigned i = 0, e = program.size(); i != e; ++i) {
+    const Instruction &inst = program[i];
+    uint64_t *res = &registers[i * n];
+    const uint64_t *a = &registers[inst.ops[0] * n];
+    const uint64_t *b = &registers[inst.ops[1] * n];
+    const uint64_t *c = &registers[inst.ops[2] * n];
+    Expr::Width w = inst.width, kw = inst.kidWidth;
+
+    switch (inst.kind) {
+    case Expr::Constant: {
+      uint64_t value = inst.ops[0] | ((uint64_t) inst.ops[1] << 32);
+      FOR_EACH_LANE res[l] = value;
+      break;
+    }
+
+    case Expr::NotOptimized:
+    case Expr::ZExt:
+      FOR_EACH_LANE res[l] = a[l];
+      break;
+
+    case Expr::Read: {
+      const Array *array = arrays[inst.ops[1]];
+      FOR_EACH_LANE {
+        uint64_t index = a[l];
+        unsigned u = inst.ops[2];
+        for (; u != inst.ops[3]; ++u) {
+          if (registers[updates[u].index * n + l] == index) {
+            res[l] = registers[updates[u].value * n + l];
+            break;
+          }
+        }
+        if (u != inst.ops[3])
+          continue;
+
+        if (array->isConstantArray() && index < array->size) {
+          res[l] = array->constantValues[index]->getZExtValue();
+          continue;
+        }
+        const std::vector<unsigned char> *values =
+          bindings[inst.ops[1] * n + l];
+        if (values && index < values->size())
+          res[l] = (*values)[index];
+        else if (assignments[l]->allowFreeValues)
+          valid[l] = false;
+        else
+          res[l] = 0;
+      }
+      break;
+    }
+
+    case Expr::Select:
+      FOR_EACH_LANE res[l] = a[l] ? b[l] : c[l];
+      break;
+
+    case Expr::Concat: {
+      Expr::Width rightWidth = w - kw;
+      FOR_EACH_LANE res[l] = (a[l] << rightWidth) | b[l];
+      break;
+    }
+
+    case Expr::Extract: {
+      unsigned offset = inst.ops[1];
+      FOR_EACH_LANE res[l] = bits64::truncateToNBits(a[l] >> offset, w);
+      break;
+    }
+
+    case Expr::SExt:
+      FOR_EACH_LANE res[l] = ints::sext(a[l], w, kw);
+      break;
+
+    case Expr::Not:
+      FOR_EACH_LANE res[l] = bits64::truncateToNBits(~a[l], w);
+      break;
+
+    case Expr::Add: FOR_EACH_LANE res[l] = ints::add(a[l], b[l], w); break;
+    case Expr::Sub: FOR_EACH_LANE res[l] = ints::sub(a[l], b[l], w); break;
+    case Expr::Mul: FOR_EACH_LANE res[l] = ints::mul(a[l], b[l], w); break;
+    case Expr::And: FOR_EACH_LANE res[l] = ints::land(a[l], b[l], w); break;
+    case Expr::Or: FOR_EACH_LANE res[l] = ints::lor(a[l], b[l], w); break;
+    case Expr::Xor: FOR_EACH_LANE res[l] = ints::lxor(a[l], b[l], w); break;
+
+    // Division by zero leaves the expression unevaluated, see
+    // ExprEvaluator::protectedDivOperation(). Signed division by -1 is
+    // computed as negation, to avoid overflowing on 64 bits.
+    case Expr::UDiv:
+      FOR_EACH_LANE {
+        if (b[l]) res[l] = ints::udiv(a[l], b[l], w); else valid[l] = false;
+      }
+      break;
+    case Expr::URem:
+      FOR_EACH_LANE {
+        if (b[l]) res[l] = ints::urem(a[l], b[l], w); else valid[l] = false;
+      }
+      break;
+    case Expr::SDiv:
+      FOR_EACH_LANE {
+        if (!b[l])
+          valid[l] = false;
+        else if (b[l] == bits64::maxValueOfNBits(w))
+          res[l] = ints::sub(0, a[l], w);
+        else
+          res[l] = ints::sdiv(a[l], b[l], w);
+      }
+      break;
+    case Expr::SRem:
+      FOR_EACH_LANE {
+        if (!b[l])
+          valid[l] = false;
+        else if (b[l] == bits64::maxValueOfNBits(w))
+          res[l] = 0;
+        else
+          res[l] = ints::srem(a[l], b[l], w);
+      }
+      break;
+
+    // Oversized shifts are left to the expression library.
+    case Expr::Shl:
+      FOR_EACH_LANE {
+        if (b[l] < w) res[l] = ints::shl(a[l], b[l], w); else valid[l] = false;
+      }
+      break;
+    case Expr::LShr:
+      FOR_EACH_LANE {
+        if (b[l] < w) res[l] = ints::lshr(a[l], b[l], w); else valid[l] = false;
+      }
+      break;
+    case Expr::AShr:
+      FOR_EACH_LANE {
+        if (b[l] < w) res[l] = ints::ashr(a[l], b[l], w); else valid[l] = false;
+      }
+      break;
+
+    case Expr::Eq: FOR_EACH_LANE res[l] = ints::eq(a[l], b[l], kw); break;
+    case Expr::Ne: FOR_EACH_LANE res[l] = ints::ne(a[l], b[l], kw); break;
+    case Expr::Ult: FOR_EACH_LANE res[l] = ints::ult(a[l], b[l], kw); break;
+    case Expr::Ule: FOR_EACH_LANE res[l] = ints::ule(a[l], b[l], kw); break;
+    case Expr::Ugt: FOR_EACH_LANE res[l] = ints::ugt(a[l], b[l], kw); break;
+    case Expr::Uge: FOR_EACH_LANE res[l] = ints::uge(a[l], b[l], kw); break;
+    case Expr::Slt: FOR_EACH_LANE res[l] = ints::slt(a[l], b[l], kw); break;
+    case Expr::Sle: FOR_EACH_LANE res[l] = ints::sle(a[l], b[l], kw); break;
+    case Expr::Sgt: FOR_EACH_LANE res[l] = ints::sgt(a[l], b[l], kw); break;
+    case Expr::Sge: FOR_EACH_LANE res[l] = ints::sge(a[l], b[l], kw); break;
+
+    default:
+      assert(0 && "unhandled Expr type");
+      FOR_EACH_LANE valid[l] = false;
+      break;
+    }
+  }
+
+  const uint64_t *res = &registers[(program.size() - 1) * n];
+  FOR_EACH_LANE results[l] = res[l];
+}
+
+#undef FOR_EACH_LANE
+
+bool CompiledExpr::evaluate(const Assignment &a, uint64_t &result) const {
+  const Assignment *assignments[1] = { &a };
+  bool valid;
+  run(assignments, 1, &result, &valid);
+  return valid;
+}
+
+void CompiledExpr::evaluate(const std::vector<const Assignment*> &assignments,
+                            std::vector<uint64_t> &results,
+                            std::vector<bool> &valid) const {
+  unsigned n = assignments.size();
+  results.resize(n);
+  valid.resize(n);
+  if (!n)
+    return;
+  bool *isValid = new bool[n];
+  run(&assignments[0], n, &results[0], isValid);
+  for (unsigned i = 0; i != n; ++i)
+    valid[i] = isValid[i];
+  delete[] isValid;
+}
+
+/***/
+
+static CacheEntry &getCacheEntry(const ref<Expr> &e) {
+  cache_ty &cache = getCache();
+  if (cache.size() >= MaxCachedExprs) {
+    for (cache_ty::iterator it = cache.begin(), ie = cache.end(); it != ie;
+         ++it)
+      delete it->second.compiled;
+    cache.clear();
+  }
+  return cache[e];
+}
+
+/// Count a use of \a e, and compile it once it was used
+/// --compile-exprs-threshold times.
+/// \return null while \a e is not compiled.
+static const CompiledExpr *useCompiled(const ref<Expr> &e) {
+  CacheEntry &entry = getCacheEntry(e);
+  if (!entry.compiled) {
+    if (entry.uses == ~0U || ++entry.uses < CompileExprsThreshold)
+      return 0;
+    entry.compiled = CompiledExpr::compile(e);
+    if (!entry.compiled) {
+      // Remember that it cannot be compiled.
+      entry.uses = ~0U;
+    }
+  }
+  return entry.compiled;
+}
+
+bool CompiledExpr::evaluateCached(const ref<Expr> &e, const Assignment &a,
+                                  uint64_t &result) {
+  if (!CompileExprs || isa<ConstantExpr>(e) || e->getWidth() > Expr::Int64)
+    return false;
+
+  const CompiledExpr *compiled = useCompiled(e);
+  return compiled && compiled->evaluate(a, result);
+}
+
+const CompiledExpr *CompiledExpr::getCached(const ref<Expr> &e) {
+  if (!CompileExprs || e->getWidth() > Expr::Int64)
+    return 0;
+
+  return useCompiled(e);
+}
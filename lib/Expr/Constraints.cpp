@@ -10,6 +10,7 @@
 #include "klee/Constraints.h"
 
 #include "klee/util/ExprPPrinter.h"
+#include "klee/util/ExprUtil.h"
 #include "klee/util/ExprVisitor.h"
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
 #include "llvm/IR/Function.h"
@@ -19,7 +20,6 @@
 #include "llvm/Support/CommandLine.h"
 #include "klee/Internal/Module/KModule.h"
 
-#include <map>
 
 using namespace klee;
 
@@ -57,15 +57,15 @@ public:
 
 class ExprReplaceVisitor2 : public ExprVisitor {
 private:
-  const std::map< ref<Expr>, ref<Expr> > &replacements;
+  const ExprHashMap< ref<Expr> > &replacements;
 
 public:
-  ExprReplaceVisitor2(const std::map< ref<Expr>, ref<Expr> > &_replacements) 
+  ExprReplaceVisitor2(const ExprHashMap< ref<Expr> > &_replacements) 
     : ExprVisitor(true),
       replacements(_replacements) {}
 
   Action visitExprPost(const Expr &e) {
-    std::map< ref<Expr>, ref<Expr> >::const_iterator it =
+    ExprHashMap< ref<Expr> >::const_iterator it =
       replacements.find(ref<Expr>(const_cast<Expr*>(&e)));
     if (it!=replacements.end()) {
       return Action::changeTo(it->second);
@@ -75,54 +75,187 @@ public:
   }
 };
 
-bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
-  ConstraintManager::constraints_ty old;
-  bool changed = false;
+size_t ConstraintManager::allocatedBytes = 0;
 
-  constraints.swap(old);
-  for (ConstraintManager::constraints_ty::iterator 
-         it = old.begin(), ie = old.end(); it != ie; ++it) {
-    ref<Expr> &ce = *it;
+/// Estimated number of bytes taken by an entry of an ExprHashMap: the
+/// node holding the key, the value and the next pointer, the cached hash
+/// and its bucket.
+static const size_t ExprHashMapEntryBytes =
+  sizeof(std::pair< ref<Expr>, ref<Expr> >) + 3 * sizeof(void*);
+
+/// Estimated number of bytes taken by a node of a std::map, not counting
+/// its value.
+static const size_t MapNodeBytes = 4 * sizeof(void*);
+
+ConstraintManager::SimplificationCache::SimplificationCache()
+  : refCount(0), numIndexed(0) {
+  allocatedBytes += getNumBytes();
+}
+
+ConstraintManager::SimplificationCache::SimplificationCache(
+    const SimplificationCache &b)
+  : refCount(0), numIndexed(b.numIndexed), equalities(b.equalities) {
+  allocatedBytes += getNumBytes();
+}
+
+ConstraintManager::SimplificationCache::~SimplificationCache() {
+  allocatedBytes -= getNumBytes();
+}
+
+size_t ConstraintManager::SimplificationCache::getNumBytes() const {
+  return sizeof(SimplificationCache) +
+         (equalities.size() + simplified.size()) * ExprHashMapEntryBytes;
+}
+
+void ConstraintManager::ArrayIndex::add(
+    const std::vector<const Array*> &objects) {
+  unsigned position = arrays.size();
+  size_t bytes = sizeof(objects) + objects.size() * sizeof(const Array*);
+  arrays.push_back(objects);
+  for (std::vector<const Array*>::const_iterator it = objects.begin(),
+         ie = objects.end(); it != ie; ++it) {
+    std::vector<unsigned> &positions = uses[*it];
+    if (positions.empty())
+      bytes += MapNodeBytes + sizeof(std::pair<const Array*,
+                                               std::vector<unsigned> >);
+    positions.push_back(position);
+    bytes += sizeof(unsigned);
+  }
+  numBytes += bytes;
+  allocatedBytes += bytes;
+}
+
+ConstraintManager::ArrayIndex &ConstraintManager::getArrayIndex() {
+  if (arrayIndex.isNull())
+    arrayIndex = new ArrayIndex();
+  if (arrayIndex->arrays.size() == constraints.size())
+    return *arrayIndex;
+
+  if (arrayIndex->refCount > 1)
+    arrayIndex = new ArrayIndex(*arrayIndex);
+  for (unsigned i = arrayIndex->arrays.size(), e = constraints.size(); i != e;
+       ++i) {
+    std::vector<const Array*> objects;
+    findSymbolicObjects(constraints[i], objects);
+    arrayIndex->add(objects);
+  }
+
+  return *arrayIndex;
+}
+
+bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor,
+                                           const ref<Expr> &src) {
+  ArrayIndex &index = getArrayIndex();
+
+  // A constraint containing src reads all arrays src reads, so only the
+  // users of the least used of them have to be visited.
+  std::vector<const Array*> objects;
+  findSymbolicObjects(src, objects);
+  const std::vector<unsigned> *candidates = 0;
+  for (std::vector<const Array*>::iterator it = objects.begin(),
+         ie = objects.end(); it != ie; ++it) {
+    std::map<const Array*, std::vector<unsigned> >::iterator uses =
+      index.uses.find(*it);
+    if (uses == index.uses.end())
+      return false;
+    if (!candidates || uses->second.size() < candidates->size())
+      candidates = &uses->second;
+  }
+
+  std::vector<bool> rewritten(constraints.size());
+  std::vector< ref<Expr> > results;
+  unsigned numCandidates = candidates ? candidates->size() : constraints.size();
+  for (unsigned i = 0; i != numCandidates; ++i) {
+    unsigned position = candidates ? (*candidates)[i] : i;
+    const ref<Expr> &ce = constraints[position];
     ref<Expr> e = visitor.visit(ce);
 
     if (e!=ce) {
-      addConstraintInternal(e); // enable further reductions
-      changed = true;
-    } else {
-      constraints.push_back(ce);
+      rewritten[position] = true;
+      results.push_back(e);
     }
   }
 
-  return changed;
+  if (results.empty())
+    return false;
+
+  // Drop the rewritten constraints, keeping the order of the others.
+  ConstraintManager::constraints_ty old;
+  constraints.swap(old);
+  ref<ArrayIndex> oldIndex = arrayIndex;
+  arrayIndex = new ArrayIndex();
+  for (unsigned i = 0, e = old.size(); i != e; ++i) {
+    if (!rewritten[i]) {
+      constraints.push_back(old[i]);
+      arrayIndex->add(oldIndex->arrays[i]);
+    }
+  }
+  // The indexed constraints are no longer a prefix of the new ones.
+  cache = 0;
+
+  for (std::vector< ref<Expr> >::iterator it = results.begin(),
+         ie = results.end(); it != ie; ++it)
+    addConstraintInternal(*it); // enable further reductions
+
+  return true;
 }
 
 void ConstraintManager::simplifyForValidConstraint(ref<Expr> e) {
   // XXX 
 }
 
-ref<Expr> ConstraintManager::simplifyExpr(ref<Expr> e) const {
-  if (isa<ConstantExpr>(e))
-    return e;
+ConstraintManager::SimplificationCache &
+ConstraintManager::getSimplificationCache() const {
+  if (cache.isNull())
+    cache = new SimplificationCache();
+  if (cache->numIndexed == constraints.size())
+    return *cache;
 
-  std::map< ref<Expr>, ref<Expr> > equalities;
-  
-  for (ConstraintManager::constraints_ty::const_iterator 
-         it = constraints.begin(), ie = constraints.end(); it != ie; ++it) {
-    if (const EqExpr *ee = dyn_cast<EqExpr>(*it)) {
+  // The memoised results are stale, start over with a private copy of the
+  // equalities if other constraint managers still use them.
+  if (cache->refCount > 1)
+    cache = new SimplificationCache(*cache);
+  allocatedBytes -= cache->getNumBytes();
+  {
+    ExprHashMap< ref<Expr> > empty;
+    cache->simplified.swap(empty);
+  }
+
+  ExprHashMap< ref<Expr> > &equalities = cache->equalities;
+  for (unsigned i = cache->numIndexed, e = constraints.size(); i != e; ++i) {
+    const ref<Expr> &constraint = constraints[i];
+    if (const EqExpr *ee = dyn_cast<EqExpr>(constraint)) {
       if (isa<ConstantExpr>(ee->left)) {
         equalities.insert(std::make_pair(ee->right,
                                          ee->left));
       } else {
-        equalities.insert(std::make_pair(*it,
+        equalities.insert(std::make_pair(constraint,
                                          ConstantExpr::alloc(1, Expr::Bool)));
       }
     } else {
-      equalities.insert(std::make_pair(*it,
+      equalities.insert(std::make_pair(constraint,
                                        ConstantExpr::alloc(1, Expr::Bool)));
     }
   }
+  cache->numIndexed = constraints.size();
+  allocatedBytes += cache->getNumBytes();
 
-  return ExprReplaceVisitor2(equalities).visit(e);
+  return *cache;
+}
+
+ref<Expr> ConstraintManager::simplifyExpr(ref<Expr> e) const {
+  if (isa<ConstantExpr>(e))
+    return e;
+
+  SimplificationCache &c = getSimplificationCache();
+  ExprHashMap< ref<Expr> >::iterator it = c.simplified.find(e);
+  if (it != c.simplified.end())
+    return it->second;
+
+  ref<Expr> res = ExprReplaceVisitor2(c.equalities).visit(e);
+  c.simplified.insert(std::make_pair(e, res));
+  allocatedBytes += ExprHashMapEntryBytes;
+  return res;
 }
 
 void ConstraintManager::addConstraintInternal(ref<Expr> e) {
@@ -152,7 +285,7 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
       BinaryExpr *be = cast<BinaryExpr>(e);
       if (isa<ConstantExpr>(be->left)) {
 	ExprReplaceVisitor visitor(be->right, be->left);
-	rewriteConstraints(visitor);
+	rewriteConstraints(visitor, be->right);
       }
     }
     constraints.push_back(e);
@@ -165,6 +298,13 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
   }
 }
 
+void ConstraintManager::truncate(unsigned n) {
+  constraints.truncate(n);
+  // The caches are rebuilt for the constraints when they are needed.
+  cache = 0;
+  arrayIndex = 0;
+}
+
 void ConstraintManager::addConstraint(ref<Expr> e) {
   e = simplifyExpr(e);
   addConstraintInternal(e);
@@ -21,7 +21,9 @@
 
 #include "klee/util/ExprPPrinter.h"
 
+#include <algorithm>
 #include <sstream>
+#include <vector>
 
 using namespace klee;
 using namespace llvm;
@@ -31,11 +33,208 @@ namespace {
   ConstArrayOpt("const-array-opt",
 	 cl::init(false),
 	 cl::desc("Enable various optimizations involving all-constant arrays."));
+
+  cl::opt<bool, true>
+  HashConsExprs("hash-cons-exprs",
+                cl::location(Expr::hashConsing),
+                cl::init(false),
+                cl::desc("Allocate structurally equal expressions only once, "
+                         "so that they can be compared by address (default=off)"));
 }
 
 /***/
 
 unsigned Expr::count = 0;
+bool Expr::hashConsing = false;
+
+/***/
+
+namespace {
+  /// Marks a slot of the hash-consing table whose expression was removed.
+  Expr *const HashConsTombstone = reinterpret_cast<Expr *>(1);
+
+  /// An open addressing table of the hash-consed expressions, probed
+  /// linearly from the hash of the expression.
+  struct HashConsTable {
+    std::vector<Expr *> slots;
+    /// Number of expressions in the table.
+    unsigned size;
+    /// Number of slots holding an expression or a tombstone.
+    unsigned used;
+
+    HashConsTable() : slots(1024, (Expr *) 0), size(0), used(0) {}
+
+    unsigned getMask() const { return slots.size() - 1; }
+
+    /// Reinsert the expressions into a table of \a capacity slots, which
+    /// drops the tombstones.
+    void rehash(unsigned capacity) {
+      std::vector<Expr *> old(capacity, (Expr *) 0);
+      old.swap(slots);
+      for (std::vector<Expr *>::iterator it = old.begin(), ie = old.end();
+           it != ie; ++it) {
+        if (!*it || *it == HashConsTombstone)
+          continue;
+        unsigned i = (*it)->hash() & getMask();
+        while (slots[i])
+          i = (i + 1) & getMask();
+        slots[i] = *it;
+      }
+      used = size;
+    }
+  };
+
+  // Intentionally never destroyed, expressions may still be deleted
+  // during static destruction.
+  HashConsTable &getHashConsTable() {
+    static HashConsTable *table = new HashConsTable();
+    return *table;
+  }
+}
+
+/// Whether two expressions of equal hash are structurally equal, given
+/// that their kids are hash-consed.
+static bool isHashConsEqual(const Expr *a, const Expr *b) {
+  if (a->getKind() != b->getKind() || a->hash() != b->hash())
+    return false;
+  for (unsigned i = 0, e = a->getNumKids(); i != e; ++i)
+    if (a->getKid(i).get() != b->getKid(i).get())
+      return false;
+  return a->compare(*b) == 0;
+}
+
+Expr *Expr::lookupOrInsert(Expr *e) {
+  assert(!e->hashConsed && "expression already hash-consed");
+
+  // Only expressions with unique kids can be compared shallowly.
+  for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+    if (!e->getKid(i)->isHashConsed())
+      return e;
+
+  HashConsTable &table = getHashConsTable();
+  Expr **free = 0;
+  unsigned i = e->hashValue & table.getMask();
+  for (; table.slots[i]; i = (i + 1) & table.getMask()) {
+    if (table.slots[i] == HashConsTombstone) {
+      if (!free)
+        free = &table.slots[i];
+    } else if (isHashConsEqual(table.slots[i], e)) {
+      return table.slots[i];
+    }
+  }
+
+  if (!free) {
+    free = &table.slots[i];
+    ++table.used;
+  }
+  *free = e;
+  e->hashConsed = true;
+  ++table.size;
+
+  // Keep at least a quarter of the slots empty so that probes terminate
+  // quickly, growing only if the expressions themselves need the space.
+  if (table.used * 4 > table.slots.size() * 3)
+    table.rehash(table.size * 2 > table.slots.size() ? table.slots.size() * 2
+                                                     : table.slots.size());
+
+  return e;
+}
+
+void Expr::removeHashConsed() {
+  HashConsTable &table = getHashConsTable();
+  unsigned i = hashValue & table.getMask();
+  while (table.slots[i] != this)
+    i = (i + 1) & table.getMask();
+  table.slots[i] = HashConsTombstone;
+  hashConsed = false;
+  --table.size;
+}
+
+unsigned Expr::getNumHashConsed() { return getHashConsTable().size; }
+
+namespace {
+  /// Allocates expressions from slabs, keeping a free list for each object
+  /// size. Memory is reused for expressions of the same size but never
+  /// returned to the system.
+  class ExprAllocator {
+    static const size_t Alignment = 8;
+    static const size_t MaxObjectSize = 128;
+    static const size_t SlabSize = 64 * 1024;
+
+    struct FreeObject {
+      FreeObject *next;
+    };
+
+    /// The free objects of each size class.
+    FreeObject *freeLists[MaxObjectSize / Alignment + 1];
+    /// The unused end of the current slab.
+    char *slabPtr, *slabEnd;
+
+  public:
+    size_t allocatedBytes;
+
+    ExprAllocator() : slabPtr(0), slabEnd(0), allocatedBytes(0) {
+      std::fill(freeLists, freeLists + MaxObjectSize / Alignment + 1,
+                (FreeObject *) 0);
+    }
+
+    static size_t getSizeClass(size_t size) {
+      return (size + Alignment - 1) / Alignment;
+    }
+
+    void *allocate(size_t size) {
+      size_t sizeClass = getSizeClass(size);
+      allocatedBytes += sizeClass * Alignment;
+      if (size > MaxObjectSize)
+        return ::operator new(size);
+
+      if (FreeObject *object = freeLists[sizeClass]) {
+        freeLists[sizeClass] = object->next;
+        return object;
+      }
+
+      size_t bytes = sizeClass * Alignment;
+      if (slabPtr + bytes > slabEnd) {
+        slabPtr = static_cast<char *>(::operator new(SlabSize));
+        slabEnd = slabPtr + SlabSize;
+      }
+      void *result = slabPtr;
+      slabPtr += bytes;
+      return result;
+    }
+
+    void deallocate(void *ptr, size_t size) {
+      size_t sizeClass = getSizeClass(size);
+      allocatedBytes -= sizeClass * Alignment;
+      if (size > MaxObjectSize) {
+        ::operator delete(ptr);
+        return;
+      }
+
+      FreeObject *object = static_cast<FreeObject *>(ptr);
+      object->next = freeLists[sizeClass];
+      freeLists[sizeClass] = object;
+    }
+  };
+
+  // Intentionally never destroyed, see getHashConsTable().
+  ExprAllocator &getExprAllocator() {
+    static ExprAllocator *allocator = new ExprAllocator();
+    return *allocator;
+  }
+}
+
+void *Expr::operator new(size_t size) {
+  return getExprAllocator().allocate(size);
+}
+
+void Expr::operator delete(void *ptr, size_t size) {
+  getExprAllocator().deallocate(ptr, size);
+}
+
+size_t Expr::getNumAllocatedBytes() {
+  return getExprAllocator().allocatedBytes;
+}
 
 ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
   UpdateList ul(array, 0);
@@ -185,9 +384,9 @@ unsigned Expr::computeHash() {
 
 unsigned ConstantExpr::computeHash() {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 1)
-  hashValue = hash_value(value) ^ (getWidth() * MAGIC_HASH_CONSTANT);
+  hashValue = hash_value(getAPValue()) ^ (getWidth() * MAGIC_HASH_CONSTANT);
 #else
-  hashValue = value.getHashValue() ^ (getWidth() * MAGIC_HASH_CONSTANT);
+  hashValue = getAPValue().getHashValue() ^ (getWidth() * MAGIC_HASH_CONSTANT);
 #endif
   return hashValue;
 }
@@ -349,135 +548,135 @@ void ConstantExpr::toMemory(void *address) {
   case Expr::Int64: *((uint64_t*) address) = getZExtValue(64); break;
   // FIXME: what about machines without x87 support?
   case Expr::Fl80:
-    *((long double*) address) = *(const long double*) value.getRawData();
+    *((long double*) address) = *(const long double*) getAPValue().getRawData();
     break;
   }
 }
 
 void ConstantExpr::toString(std::string &Res, unsigned radix) const {
-  Res = value.toString(radix, false);
+  Res = getAPValue().toString(radix, false);
 }
 
 ref<ConstantExpr> ConstantExpr::Concat(const ref<ConstantExpr> &RHS) {
   Expr::Width W = getWidth() + RHS->getWidth();
-  APInt Tmp(value);
+  APInt Tmp(getAPValue());
   Tmp=Tmp.zext(W);
   Tmp <<= RHS->getWidth();
-  Tmp |= APInt(RHS->value).zext(W);
+  Tmp |= APInt(RHS->getAPValue()).zext(W);
 
   return ConstantExpr::alloc(Tmp);
 }
 
 ref<ConstantExpr> ConstantExpr::Extract(unsigned Offset, Width W) {
-  return ConstantExpr::alloc(APInt(value.ashr(Offset)).zextOrTrunc(W));
+  return ConstantExpr::alloc(APInt(getAPValue().ashr(Offset)).zextOrTrunc(W));
 }
 
 ref<ConstantExpr> ConstantExpr::ZExt(Width W) {
-  return ConstantExpr::alloc(APInt(value).zextOrTrunc(W));
+  return ConstantExpr::alloc(APInt(getAPValue()).zextOrTrunc(W));
 }
 
 ref<ConstantExpr> ConstantExpr::SExt(Width W) {
-  return ConstantExpr::alloc(APInt(value).sextOrTrunc(W));
+  return ConstantExpr::alloc(APInt(getAPValue()).sextOrTrunc(W));
 }
 
 ref<ConstantExpr> ConstantExpr::Add(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value + RHS->value);
+  return ConstantExpr::alloc(getAPValue() + RHS->getAPValue());
 }
 
 ref<ConstantExpr> ConstantExpr::Neg() {
-  return ConstantExpr::alloc(-value);
+  return ConstantExpr::alloc(-getAPValue());
 }
 
 ref<ConstantExpr> ConstantExpr::Sub(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value - RHS->value);
+  return ConstantExpr::alloc(getAPValue() - RHS->getAPValue());
 }
 
 ref<ConstantExpr> ConstantExpr::Mul(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value * RHS->value);
+  return ConstantExpr::alloc(getAPValue() * RHS->getAPValue());
 }
 
 ref<ConstantExpr> ConstantExpr::UDiv(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.udiv(RHS->value));
+  return ConstantExpr::alloc(getAPValue().udiv(RHS->getAPValue()));
 }
 
 ref<ConstantExpr> ConstantExpr::SDiv(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.sdiv(RHS->value));
+  return ConstantExpr::alloc(getAPValue().sdiv(RHS->getAPValue()));
 }
 
 ref<ConstantExpr> ConstantExpr::URem(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.urem(RHS->value));
+  return ConstantExpr::alloc(getAPValue().urem(RHS->getAPValue()));
 }
 
 ref<ConstantExpr> ConstantExpr::SRem(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.srem(RHS->value));
+  return ConstantExpr::alloc(getAPValue().srem(RHS->getAPValue()));
 }
 
 ref<ConstantExpr> ConstantExpr::And(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value & RHS->value);
+  return ConstantExpr::alloc(getAPValue() & RHS->getAPValue());
 }
 
 ref<ConstantExpr> ConstantExpr::Or(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value | RHS->value);
+  return ConstantExpr::alloc(getAPValue() | RHS->getAPValue());
 }
 
 ref<ConstantExpr> ConstantExpr::Xor(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value ^ RHS->value);
+  return ConstantExpr::alloc(getAPValue() ^ RHS->getAPValue());
 }
 
 ref<ConstantExpr> ConstantExpr::Shl(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.shl(RHS->value));
+  return ConstantExpr::alloc(getAPValue().shl(RHS->getAPValue()));
 }
 
 ref<ConstantExpr> ConstantExpr::LShr(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.lshr(RHS->value));
+  return ConstantExpr::alloc(getAPValue().lshr(RHS->getAPValue()));
 }
 
 ref<ConstantExpr> ConstantExpr::AShr(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.ashr(RHS->value));
+  return ConstantExpr::alloc(getAPValue().ashr(RHS->getAPValue()));
 }
 
 ref<ConstantExpr> ConstantExpr::Not() {
-  return ConstantExpr::alloc(~value);
+  return ConstantExpr::alloc(~getAPValue());
 }
 
 ref<ConstantExpr> ConstantExpr::Eq(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value == RHS->value, Expr::Bool);
+  return ConstantExpr::alloc(getAPValue() == RHS->getAPValue(), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Ne(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value != RHS->value, Expr::Bool);
+  return ConstantExpr::alloc(getAPValue() != RHS->getAPValue(), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Ult(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.ult(RHS->value), Expr::Bool);
+  return ConstantExpr::alloc(getAPValue().ult(RHS->getAPValue()), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Ule(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.ule(RHS->value), Expr::Bool);
+  return ConstantExpr::alloc(getAPValue().ule(RHS->getAPValue()), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Ugt(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.ugt(RHS->value), Expr::Bool);
+  return ConstantExpr::alloc(getAPValue().ugt(RHS->getAPValue()), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Uge(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.uge(RHS->value), Expr::Bool);
+  return ConstantExpr::alloc(getAPValue().uge(RHS->getAPValue()), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Slt(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.slt(RHS->value), Expr::Bool);
+  return ConstantExpr::alloc(getAPValue().slt(RHS->getAPValue()), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Sle(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.sle(RHS->value), Expr::Bool);
+  return ConstantExpr::alloc(getAPValue().sle(RHS->getAPValue()), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Sgt(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.sgt(RHS->value), Expr::Bool);
+  return ConstantExpr::alloc(getAPValue().sgt(RHS->getAPValue()), Expr::Bool);
 }
 
 ref<ConstantExpr> ConstantExpr::Sge(const ref<ConstantExpr> &RHS) {
-  return ConstantExpr::alloc(value.sge(RHS->value), Expr::Bool);
+  return ConstantExpr::alloc(getAPValue().sge(RHS->getAPValue()), Expr::Bool);
 }
 
 /***/
@@ -151,6 +151,142 @@ namespace {
     }
   };
 
+  /// CanonicalExprBuilder - Expression builder which uses the create
+  /// functions of the expression classes, and so applies the same folds and
+  /// canonicalizations as expressions built directly with them.
+  class CanonicalExprBuilder : public ExprBuilder {
+    virtual ref<Expr> Constant(const llvm::APInt &Value) {
+      return ConstantExpr::alloc(Value);
+    }
+
+    virtual ref<Expr> NotOptimized(const ref<Expr> &Index) {
+      return NotOptimizedExpr::create(Index);
+    }
+
+    virtual ref<Expr> Read(const UpdateList &Updates,
+                           const ref<Expr> &Index) {
+      return ReadExpr::create(Updates, Index);
+    }
+
+    virtual ref<Expr> Select(const ref<Expr> &Cond,
+                             const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SelectExpr::create(Cond, LHS, RHS);
+    }
+
+    virtual ref<Expr> Concat(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return ConcatExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Extract(const ref<Expr> &LHS,
+                              unsigned Offset, Expr::Width W) {
+      return ExtractExpr::create(LHS, Offset, W);
+    }
+
+    virtual ref<Expr> ZExt(const ref<Expr> &LHS, Expr::Width W) {
+      return ZExtExpr::create(LHS, W);
+    }
+
+    virtual ref<Expr> SExt(const ref<Expr> &LHS, Expr::Width W) {
+      return SExtExpr::create(LHS, W);
+    }
+
+    virtual ref<Expr> Not(const ref<Expr> &LHS) {
+      return NotExpr::create(LHS);
+    }
+
+    virtual ref<Expr> Add(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return AddExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Sub(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SubExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Mul(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return MulExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> UDiv(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return UDivExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> SDiv(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SDivExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> URem(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return URemExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> SRem(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SRemExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> And(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return AndExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Or(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return OrExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Xor(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return XorExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Shl(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return ShlExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> LShr(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return LShrExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> AShr(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return AShrExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Eq(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return EqExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Ne(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return NeExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Ult(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return UltExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Ule(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return UleExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Ugt(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return UgtExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Uge(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return UgeExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Slt(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SltExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Sle(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SleExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Sgt(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SgtExpr::create(LHS, RHS);
+    }
+
+    virtual ref<Expr> Sge(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return SgeExpr::create(LHS, RHS);
+    }
+  };
+
   /// ChainedBuilder - Helper class for construct specialized expression
   /// builders, which implements (non-virtual) methods which forward to a base
   /// expression builder, for all expressions.
@@ -1058,6 +1194,10 @@ ExprBuilder *klee::createDefaultExprBuilder() {
   return new DefaultExprBuilder();
 }
 
+ExprBuilder *klee::createCanonicalExprBuilder() {
+  return new CanonicalExprBuilder();
+}
+
 ExprBuilder *klee::createConstantFoldingExprBuilder(ExprBuilder *Base) {
   return new ConstantFoldingExprBuilder(Base);
 }
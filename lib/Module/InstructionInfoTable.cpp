@@ -144,9 +144,11 @@ InstructionInfoTable::InstructionInfoTable(Module *m)
       // Update our source level debug information.
       getInstructionDebugInfo(instr, file, line);
 
-      infos.insert(std::make_pair(instr,
-                                  InstructionInfo(id++, *file, line,
-                                                  assemblyLine)));
+      const InstructionInfo &info =
+        infos.insert(std::make_pair(instr,
+                                    InstructionInfo(id++, *file, line,
+                                                    assemblyLine))).first->second;
+      infosByID.push_back(&info);
     }
   }
 }
@@ -523,6 +523,49 @@ static int getOperandNum(Value *v,
   }
 }
 
+/// Compute the properties of an instruction which the executor would
+/// otherwise derive from the LLVM instruction each time it is executed.
+static void decodeInstruction(KInstruction *ki, KModule *km) {
+  Instruction *inst = ki->inst;
+  ki->opcode = inst->getOpcode();
+  if (CmpInst *ci = dyn_cast<CmpInst>(inst))
+    ki->predicate = ci->getPredicate();
+  else
+    ki->predicate = 0;
+  LLVM_TYPE_Q Type *type = inst->getType();
+  ki->width = type->isSized() ? km->targetData->getTypeSizeInBits(type) : 0;
+
+  switch (ki->opcode) {
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+  case Instruction::IntToPtr:
+  case Instruction::PtrToInt:
+  case Instruction::BitCast:
+    ki->isImmediateOp = ki->width <= 64;
+    break;
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::ICmp:
+    ki->isImmediateOp = true;
+    break;
+  default:
+    ki->isImmediateOp = false;
+    break;
+  }
+}
+
 KFunction::KFunction(llvm::Function *_function,
                      KModule *km) 
   : function(_function),
@@ -569,6 +612,7 @@ KFunction::KFunction(llvm::Function *_function,
       Instruction *inst = static_cast<Instruction *>(it);
       ki->inst = inst;
       ki->dest = registerMap[inst];
+      decodeInstruction(ki, km);
 
       if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
         CallSite cs(inst);
@@ -70,12 +70,21 @@ private:
                         IncompleteSolver::PartialValidity, 
                         CacheEntryHash> cache_map;
   
+  /// Estimated number of bytes taken by an entry of the cache, not
+  /// counting its constraints (see ConstraintManager::getNumAllocatedBytes).
+  static const size_t EntryBytes =
+    sizeof(cache_map::value_type) + 3 * sizeof(void*);
+
   Solver *solver;
   cache_map cache;
 
 public:
   CachingSolver(Solver *s) : solver(s) {}
-  ~CachingSolver() { cache.clear(); delete solver; }
+  ~CachingSolver() {
+    cacheBytes -= cache.size() * EntryBytes;
+    cache.clear();
+    delete solver;
+  }
 
   bool computeValidity(const Query&, Solver::Validity &result);
   bool computeTruth(const Query&, bool &isValid);
@@ -143,7 +152,8 @@ void CachingSolver::cacheInsert(const Query& query,
   IncompleteSolver::PartialValidity cachedResult = 
     (negationUsed ? IncompleteSolver::negatePartialValidity(result) : result);
   
-  cache.insert(std::make_pair(ce, cachedResult));
+  if (cache.insert(std::make_pair(ce, cachedResult)).second)
+    cacheBytes += EntryBytes;
 }
 
 bool CachingSolver::computeValidity(const Query& query,
@@ -66,6 +66,15 @@ class CexCachingSolver : public SolverImpl {
   // memo table
   assignmentsTable_ty assignmentsTable;
 
+  /// The (estimated) number of bytes taken by the cache and the memo
+  /// table, which are accounted for in SolverImpl::cacheBytes.
+  size_t numCacheBytes;
+
+  void accountCacheBytes(size_t bytes) {
+    numCacheBytes += bytes;
+    cacheBytes += bytes;
+  }
+
   bool searchForAssignment(KeyType &key, 
                            Assignment *&result);
   
@@ -79,7 +88,7 @@ class CexCachingSolver : public SolverImpl {
   bool getAssignment(const Query& query, Assignment *&result);
   
 public:
-  CexCachingSolver(Solver *_solver) : solver(_solver) {}
+  CexCachingSolver(Solver *_solver) : solver(_solver), numCacheBytes(0) {}
   ~CexCachingSolver();
   
   bool computeTruth(const Query&, bool &isValid);
@@ -146,14 +155,39 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result) {
     }
 
     // Otherwise, iterate through the set of current assignments to see if one
-    // of them satisfies the query.
-    for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
-           ie = assignmentsTable.end(); it != ie; ++it) {
-      Assignment *a = *it;
-      if (a->satisfies(key.begin(), key.end())) {
-        result = a;
-        return true;
+    // of them satisfies the query. The candidates are filtered one constraint
+    // at a time, evaluating compiled constraints under all of them at once.
+    std::vector<Assignment*> candidates(assignmentsTable.begin(),
+                                        assignmentsTable.end());
+    std::vector<const Assignment*> lanes;
+    std::vector<uint64_t> values;
+    std::vector<bool> valid;
+    for (KeyType::const_iterator it = key.begin(), ie = key.end();
+         it != ie && !candidates.empty(); ++it) {
+      const CompiledExpr *ce = CompiledExpr::getCached(*it);
+      if (ce) {
+        lanes.assign(candidates.begin(), candidates.end());
+        ce->evaluate(lanes, values, valid);
+      }
+
+      unsigned numSatisfying = 0;
+      for (unsigned i = 0, e = candidates.size(); i != e; ++i) {
+        bool satisfies;
+        if (ce && valid[i]) {
+          satisfies = values[i] != 0;
+        } else {
+          AssignmentEvaluator v(*candidates[i]);
+          satisfies = v.visit(*it)->isTrue();
+        }
+        if (satisfies)
+          candidates[numSatisfying++] = candidates[i];
       }
+      candidates.resize(numSatisfying);
+    }
+
+    if (!candidates.empty()) {
+      result = candidates.front();
+      return true;
     }
   } else {
     // FIXME: Which order? one is sure to be better.
@@ -237,6 +271,12 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
     if (!res.second) {
       delete binding;
       binding = *res.first;
+    } else {
+      size_t bytes = sizeof(Assignment) + 4 * sizeof(void*);
+      for (Assignment::bindings_ty::iterator it = binding->bindings.begin(),
+             ie = binding->bindings.end(); it != ie; ++it)
+        bytes += sizeof(*it) + 4 * sizeof(void*) + it->second.size();
+      accountCacheBytes(bytes);
     }
     
     if (DebugCexCacheCheckBinding)
@@ -251,6 +291,8 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
   
   result = binding;
   cache.insert(key, binding);
+  // Each element of the key takes (at most) one node of the trie.
+  accountCacheBytes(key.size() * (sizeof(ref<Expr>) + 6 * sizeof(void*)));
 
   return true;
 }
@@ -258,6 +300,7 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
 ///
 
 CexCachingSolver::~CexCachingSolver() {
+  cacheBytes -= numCacheBytes;
   cache.clear();
   delete solver;
   for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
@@ -0,0 +1,879 @@
+//===-- IntervalSolver.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/IncompleteSolver.h"
+#include "klee/SolverStats.h"
+#include "klee/util/Bits.h"
+#include "klee/util/ExprHashMap.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+using namespace klee;
+
+/***/
+
+namespace {
+
+/// The abstract value of an expression of at most 64 bits, as the bits
+/// known to be zero and one, and an unsigned interval. The interval is
+/// empty (min > max) if the expression cannot take any value.
+struct AbstractValue {
+  Expr::Width width;
+  uint64_t knownZero, knownOne, min, max;
+
+  AbstractValue() : width(0), knownZero(0), knownOne(0), min(0), max(0) {}
+
+  static uint64_t mask(Expr::Width w) { return bits64::maxValueOfNBits(w); }
+
+  static AbstractValue top(Expr::Width w) {
+    AbstractValue v;
+    v.width = w;
+    v.max = mask(w);
+    return v;
+  }
+
+  static AbstractValue constant(uint64_t value, Expr::Width w) {
+    AbstractValue v;
+    v.width = w;
+    v.knownZero = ~value & mask(w);
+    v.knownOne = v.min = v.max = value;
+    return v;
+  }
+
+  static AbstractValue range(uint64_t min, uint64_t max, Expr::Width w) {
+    AbstractValue v = top(w);
+    v.min = min;
+    v.max = max;
+    v.normalize();
+    return v;
+  }
+
+  bool isEmpty() const { return min > max; }
+  bool isConstant() const { return min == max; }
+  uint64_t getMask() const { return mask(width); }
+
+  bool operator==(const AbstractValue &b) const {
+    return width == b.width && knownZero == b.knownZero &&
+      knownOne == b.knownOne && min == b.min && max == b.max;
+  }
+  bool operator!=(const AbstractValue &b) const { return !(*this == b); }
+
+  /// Make the known bits and the interval agree with each other.
+  void normalize() {
+    uint64_t m = getMask();
+    knownZero &= m;
+    knownOne &= m;
+    if (isEmpty() || (knownZero & knownOne)) {
+      setEmpty();
+      return;
+    }
+    if (min < knownOne)
+      min = knownOne;
+    if (max > (m & ~knownZero))
+      max = m & ~knownZero;
+    if (isEmpty()) {
+      setEmpty();
+      return;
+    }
+
+    // The bits above the highest bit in which the bounds differ are
+    // common to all values of the interval.
+    uint64_t diff = min ^ max, prefix = m;
+    while (diff) {
+      prefix <<= 1;
+      diff >>= 1;
+    }
+    prefix &= m;
+    if ((knownZero & min & prefix) || (knownOne & ~min & prefix)) {
+      setEmpty();
+      return;
+    }
+    knownOne |= min & prefix;
+    knownZero |= ~min & prefix & m;
+  }
+
+  void setEmpty() {
+    min = 1;
+    max = 0;
+  }
+
+  /// The values of both this and \a b.
+  AbstractValue intersect(const AbstractValue &b) const {
+    assert(width == b.width && "intersecting values of different widths");
+    AbstractValue v = *this;
+    if (isEmpty() || b.isEmpty()) {
+      v.setEmpty();
+      return v;
+    }
+    v.knownZero |= b.knownZero;
+    v.knownOne |= b.knownOne;
+    v.min = std::max(min, b.min);
+    v.max = std::min(max, b.max);
+    v.normalize();
+    return v;
+  }
+
+  /// The values of either this or \a b.
+  AbstractValue join(const AbstractValue &b) const {
+    assert(width == b.width && "joining values of different widths");
+    if (isEmpty())
+      return b;
+    if (b.isEmpty())
+      return *this;
+    AbstractValue v = *this;
+    v.knownZero &= b.knownZero;
+    v.knownOne &= b.knownOne;
+    v.min = std::min(min, b.min);
+    v.max = std::max(max, b.max);
+    return v;
+  }
+
+  /// The number of low bits which are known.
+  unsigned getNumLowKnownBits() const {
+    uint64_t known = knownZero | knownOne;
+    unsigned n = 0;
+    while (n < width && (known & ((uint64_t) 1 << n)))
+      ++n;
+    return n;
+  }
+
+  /// The signed interval, if it is contiguous.
+  bool getSignedRange(int64_t &smin, int64_t &smax) const {
+    uint64_t signBit = (uint64_t) 1 << (width - 1);
+    if ((min & signBit) != (max & signBit))
+      return false;
+    smin = (int64_t) (min | ((min & signBit) ? ~getMask() : 0));
+    smax = (int64_t) (max | ((max & signBit) ? ~getMask() : 0));
+    return true;
+  }
+};
+
+typedef std::pair<const Array*, unsigned> ByteKey;
+
+/// The abstract values of the bytes of symbolic arrays which are implied
+/// by a set of constraints. Bytes which are not mentioned are unconstrained.
+struct AbstractState {
+  std::map<ByteKey, AbstractValue> bytes;
+  /// Whether the constraints are known to be unsatisfiable.
+  bool empty;
+
+  AbstractState() : empty(false) {}
+};
+
+/// Evaluates expressions over an abstract state, and refines the state
+/// with constraints.
+class AbstractEvaluator {
+  AbstractState &state;
+  ExprHashMap<AbstractValue> cache;
+  bool changed;
+
+  AbstractValue evaluateRead(const ReadExpr *re);
+  AbstractValue evaluateUncached(const ref<Expr> &e);
+
+  void refineByte(const ByteKey &key, const AbstractValue &v);
+  void refineEquality(const ref<Expr> &a, const ref<Expr> &b, bool isTrue);
+  void refineUlt(const ref<Expr> &a, const ref<Expr> &b, bool orEqual,
+                 bool isTrue);
+
+public:
+  AbstractEvaluator(AbstractState &_state) : state(_state), changed(false) {}
+
+  /// Evaluate \a e, returns false if it is wider than 64 bits.
+  bool evaluate(const ref<Expr> &e, AbstractValue &result);
+
+  /// Restrict the bytes read by \a e to values for which \a e is in \a v.
+  void refine(const ref<Expr> &e, const AbstractValue &v);
+
+  /// Add the constraint \a e to the state.
+  void addConstraint(const ref<Expr> &e) {
+    refine(e, AbstractValue::constant(1, Expr::Bool));
+  }
+
+  bool hasChanged() const { return changed; }
+  void resetChanged() { changed = false; }
+};
+
+}
+
+bool AbstractEvaluator::evaluate(const ref<Expr> &e, AbstractValue &result) {
+  if (e->getWidth() > Expr::Int64)
+    return false;
+
+  ExprHashMap<AbstractValue>::iterator it = cache.find(e);
+  if (it != cache.end()) {
+    result = it->second;
+    return result.width != 0;
+  }
+
+  result = evaluateUncached(e);
+  cache.insert(std::make_pair(e, result));
+  return result.width != 0;
+}
+
+AbstractValue AbstractEvaluator::evaluateRead(const ReadExpr *re) {
+  AbstractValue top = AbstractValue::top(re->getWidth());
+  const ConstantExpr *ce = dyn_cast<ConstantExpr>(re->index);
+  if (!ce)
+    return top;
+  uint64_t index = ce->getZExtValue();
+
+  // The most recent update to the index wins, updates to unknown indices
+  // are not tracked.
+  for (const UpdateNode *un = re->updates.head; un; un = un->next) {
+    const ConstantExpr *ui = dyn_cast<ConstantExpr>(un->index);
+    if (!ui)
+      return top;
+    if (ui->getZExtValue() == index) {
+      AbstractValue v;
+      if (!evaluate(un->value, v))
+        return top;
+      return v;
+    }
+  }
+
+  const Array *array = re->updates.root;
+  if (index >= array->size)
+    return top;
+  if (array->isConstantArray())
+    return AbstractValue::constant(
+        array->constantValues[index]->getZExtValue(), re->getWidth());
+
+  std::map<ByteKey, AbstractValue>::iterator it =
+    state.bytes.find(ByteKey(array, index));
+  return it == state.bytes.end() ? top : it->second;
+}
+
+AbstractValue AbstractEvaluator::evaluateUncached(const ref<Expr> &e) {
+  Expr::Width w = e->getWidth();
+  uint64_t m = AbstractValue::mask(w);
+  AbstractValue top = AbstractValue::top(w);
+
+  if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e))
+    return AbstractValue::constant(ce->getZExtValue(), w);
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e))
+    return evaluateRead(re);
+
+  AbstractValue kids[3];
+  for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+    if (!evaluate(e->getKid(i), kids[i]))
+      return AbstractValue();
+  const AbstractValue &a = kids[0], &b = kids[1];
+  for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+    if (kids[i].isEmpty())
+      return AbstractValue::range(1, 0, w);
+
+  AbstractValue v = top;
+  switch (e->getKind()) {
+  case Expr::NotOptimized:
+    return a;
+
+  case Expr::Select: {
+    if (a.isConstant())
+      return a.min ? kids[1] : kids[2];
+    return kids[1].join(kids[2]);
+  }
+
+  case Expr::Concat: {
+    Expr::Width rw = b.width;
+    v.knownZero = (a.knownZero << rw) | b.knownZero;
+    v.knownOne = (a.knownOne << rw) | b.knownOne;
+    v.min = (a.min << rw) | b.min;
+    v.max = (a.max << rw) | b.max;
+    break;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    unsigned offset = ee->offset;
+    v.knownZero = a.knownZero >> offset;
+    v.knownOne = a.knownOne >> offset;
+    if (offset == 0 && a.max <= m) {
+      v.min = a.min;
+      v.max = a.max;
+    } else if (offset + w == a.width) {
+      // Taking the high bits is monotone.
+      v.min = a.min >> offset;
+      v.max = a.max >> offset;
+    }
+    break;
+  }
+
+  case Expr::ZExt:
+    v.knownZero = a.knownZero | (m & ~a.getMask());
+    v.knownOne = a.knownOne;
+    v.min = a.min;
+    v.max = a.max;
+    break;
+
+  case Expr::SExt: {
+    uint64_t signBit = (uint64_t) 1 << (a.width - 1);
+    uint64_t ext = m & ~a.getMask();
+    v.knownZero = a.knownZero;
+    v.knownOne = a.knownOne;
+    if (a.knownZero & signBit) {
+      v.knownZero |= ext;
+      v.min = a.min;
+      v.max = a.max;
+    } else if (a.knownOne & signBit) {
+      v.knownOne |= ext;
+      v.min = a.min | ext;
+      v.max = a.max | ext;
+    }
+    break;
+  }
+
+  case Expr::Not:
+    v.knownZero = a.knownOne;
+    v.knownOne = a.knownZero;
+    v.min = m - a.max;
+    v.max = m - a.min;
+    break;
+
+  case Expr::And:
+    v.knownZero = a.knownZero | b.knownZero;
+    v.knownOne = a.knownOne & b.knownOne;
+    v.max = std::min(a.max, b.max);
+    break;
+
+  case Expr::Or:
+    v.knownZero = a.knownZero & b.knownZero;
+    v.knownOne = a.knownOne | b.knownOne;
+    v.min = std::max(a.min, b.min);
+    break;
+
+  case Expr::Xor:
+    v.knownZero = (a.knownZero & b.knownZero) | (a.knownOne & b.knownOne);
+    v.knownOne = (a.knownZero & b.knownOne) | (a.knownOne & b.knownZero);
+    break;
+
+  case Expr::Add:
+  case Expr::Sub:
+  case Expr::Mul: {
+    // The low bits of the result only depend on the low bits of the
+    // operands.
+    unsigned low = std::min(a.getNumLowKnownBits(), b.getNumLowKnownBits());
+    uint64_t lowMask = AbstractValue::mask(low);
+    uint64_t lowValue;
+    if (e->getKind() == Expr::Add) {
+      lowValue = a.knownOne + b.knownOne;
+      if (a.max <= m - b.max) {
+        v.min = a.min + b.min;
+        v.max = a.max + b.max;
+      }
+    } else if (e->getKind() == Expr::Sub) {
+      lowValue = a.knownOne - b.knownOne;
+      if (a.min >= b.max) {
+        v.min = a.min - b.max;
+        v.max = a.max - b.min;
+      }
+    } else {
+      lowValue = a.knownOne * b.knownOne;
+      if (b.max == 0 || a.max <= m / b.max) {
+        v.min = a.min * b.min;
+        v.max = a.max * b.max;
+      }
+    }
+    v.knownZero = ~lowValue & lowMask;
+    v.knownOne = lowValue & lowMask;
+    break;
+  }
+
+  case Expr::UDiv:
+    if (b.min) {
+      v.min = a.min / b.max;
+      v.max = a.max / b.min;
+    }
+    break;
+
+  case Expr::URem:
+    if (b.min) {
+      if (a.max < b.min)
+        return a;
+      v.max = std::min(a.max, b.max - 1);
+    }
+    break;
+
+  case Expr::Shl:
+    if (b.isConstant() && b.min < w) {
+      unsigned shift = b.min;
+      v.knownZero = (a.knownZero << shift) | AbstractValue::mask(shift);
+      v.knownOne = a.knownOne << shift;
+      if (a.max <= m >> shift) {
+        v.min = a.min << shift;
+        v.max = a.max << shift;
+      }
+    }
+    break;
+
+  case Expr::LShr:
+    if (b.isConstant() && b.min < w) {
+      unsigned shift = b.min;
+      v.knownZero = (a.knownZero >> shift) | (m & ~(m >> shift));
+      v.knownOne = a.knownOne >> shift;
+      v.min = a.min >> shift;
+      v.max = a.max >> shift;
+    } else {
+      v.max = a.max;
+    }
+    break;
+
+  case Expr::AShr: {
+    uint64_t signBit = (uint64_t) 1 << (w - 1);
+    if (b.isConstant() && b.min < w && (a.knownZero & signBit)) {
+      unsigned shift = b.min;
+      v.knownZero = (a.knownZero >> shift) | (m & ~(m >> shift));
+      v.knownOne = a.knownOne >> shift;
+      v.min = a.min >> shift;
+      v.max = a.max >> shift;
+    }
+    break;
+  }
+
+  case Expr::Eq:
+    if (a.isConstant() && b.isConstant())
+      return AbstractValue::constant(a.min == b.min, w);
+    if ((a.knownZero & b.knownOne) || (a.knownOne & b.knownZero) ||
+        a.max < b.min || b.max < a.min)
+      return AbstractValue::constant(0, w);
+    break;
+
+  case Expr::Ne:
+    if (a.isConstant() && b.isConstant())
+      return AbstractValue::constant(a.min != b.min, w);
+    if ((a.knownZero & b.knownOne) || (a.knownOne & b.knownZero) ||
+        a.max < b.min || b.max < a.min)
+      return AbstractValue::constant(1, w);
+    break;
+
+  case Expr::Ult:
+  case Expr::Ugt: {
+    const AbstractValue &l = e->getKind() == Expr::Ult ? a : b;
+    const AbstractValue &r = e->getKind() == Expr::Ult ? b : a;
+    if (l.max < r.min)
+      return AbstractValue::constant(1, w);
+    if (l.min >= r.max)
+      return AbstractValue::constant(0, w);
+    break;
+  }
+
+  case Expr::Ule:
+  case Expr::Uge: {
+    const AbstractValue &l = e->getKind() == Expr::Ule ? a : b;
+    const AbstractValue &r = e->getKind() == Expr::Ule ? b : a;
+    if (l.max <= r.min)
+      return AbstractValue::constant(1, w);
+    if (l.min > r.max)
+      return AbstractValue::constant(0, w);
+    break;
+  }
+
+  case Expr::Slt:
+  case Expr::Sgt:
+  case Expr::Sle:
+  case Expr::Sge: {
+    bool swap = e->getKind() == Expr::Sgt || e->getKind() == Expr::Sge;
+    bool orEqual = e->getKind() == Expr::Sle || e->getKind() == Expr::Sge;
+    int64_t lmin, lmax, rmin, rmax;
+    if (!(swap ? b : a).getSignedRange(lmin, lmax) ||
+        !(swap ? a : b).getSignedRange(rmin, rmax))
+      break;
+    if (orEqual ? lmax <= rmin : lmax < rmin)
+      return AbstractValue::constant(1, w);
+    if (orEqual ? lmin > rmax : lmin >= rmax)
+      return AbstractValue::constant(0, w);
+    break;
+  }
+
+  default:
+    break;
+  }
+
+  v.normalize();
+  return v;
+}
+
+void AbstractEvaluator::refineByte(const ByteKey &key,
+                                   const AbstractValue &v) {
+  std::map<ByteKey, AbstractValue>::iterator it = state.bytes.find(key);
+  AbstractValue old =
+    it == state.bytes.end() ? AbstractValue::top(v.width) : it->second;
+  AbstractValue res = old.intersect(v);
+  if (res == old)
+    return;
+  if (res.isEmpty())
+    state.empty = true;
+  state.bytes[key] = res;
+  // The values of all expressions reading the byte may have changed.
+  cache.clear();
+  changed = true;
+}
+
+void AbstractEvaluator::refineEquality(const ref<Expr> &a, const ref<Expr> &b,
+                                       bool isTrue) {
+  AbstractValue av, bv;
+  if (!evaluate(a, av) || !evaluate(b, bv))
+    return;
+
+  if (isTrue) {
+    refine(a, bv);
+    if (!evaluate(a, av))
+      return;
+    refine(b, av);
+    return;
+  }
+
+  // Only disequalities with constants are tracked, by cutting them off
+  // the bounds of the interval.
+  if (!av.isConstant())
+    return;
+  if (bv.width == Expr::Bool) {
+    refine(b, AbstractValue::constant(!av.min, Expr::Bool));
+  } else if (bv.min == av.min) {
+    refine(b, av.min == bv.getMask() ?
+           AbstractValue::range(1, 0, bv.width) :
+           AbstractValue::range(av.min + 1, bv.getMask(), bv.width));
+  } else if (bv.max == av.min) {
+    refine(b, av.min == 0 ?
+           AbstractValue::range(1, 0, bv.width) :
+           AbstractValue::range(0, av.min - 1, bv.width));
+  }
+}
+
+void AbstractEvaluator::refineUlt(const ref<Expr> &a, const ref<Expr> &b,
+                                  bool orEqual, bool isTrue) {
+  AbstractValue av, bv;
+  if (!evaluate(a, av) || !evaluate(b, bv))
+    return;
+  uint64_t m = av.getMask();
+
+  // a < b and a <= b, or else b <= a and b < a.
+  const ref<Expr> &l = isTrue ? a : b, &r = isTrue ? b : a;
+  const AbstractValue &lv = isTrue ? av : bv, &rv = isTrue ? bv : av;
+  bool strict = isTrue ? !orEqual : orEqual;
+  AbstractValue empty = AbstractValue::range(1, 0, av.width);
+
+  if (strict) {
+    refine(l, rv.max ? AbstractValue::range(0, rv.max - 1, av.width) : empty);
+    refine(r, lv.min < m ? AbstractValue::range(lv.min + 1, m, av.width)
+                         : empty);
+  } else {
+    refine(l, AbstractValue::range(0, rv.max, av.width));
+    refine(r, AbstractValue::range(lv.min, m, av.width));
+  }
+}
+
+void AbstractEvaluator::refine(const ref<Expr> &e, const AbstractValue &v) {
+  if (state.empty)
+    return;
+
+  AbstractValue current;
+  if (!evaluate(e, current))
+    return;
+  AbstractValue res = current.intersect(v);
+  if (res.isEmpty()) {
+    state.empty = true;
+    return;
+  }
+  if (res == current)
+    return;
+
+  Expr::Width w = e->getWidth();
+  uint64_t m = res.getMask();
+
+  switch (e->getKind()) {
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    const ConstantExpr *ce = dyn_cast<ConstantExpr>(re->index);
+    const Array *array = re->updates.root;
+    if (ce && !re->updates.head && !array->isConstantArray() &&
+        ce->getZExtValue() < array->size)
+      refineByte(ByteKey(array, ce->getZExtValue()), res);
+    break;
+  }
+
+  case Expr::NotOptimized:
+    refine(e->getKid(0), res);
+    break;
+
+  case Expr::ZExt:
+  case Expr::SExt: {
+    Expr::Width kw = e->getKid(0)->getWidth();
+    uint64_t km = AbstractValue::mask(kw);
+    AbstractValue kv = AbstractValue::top(kw);
+    kv.knownZero = res.knownZero & km;
+    kv.knownOne = res.knownOne & km;
+    // Sign extension preserves the order of non-negative values only.
+    if (e->getKind() == Expr::ZExt || res.max <= (km >> 1)) {
+      kv.min = res.min;
+      kv.max = res.max;
+    }
+    kv.normalize();
+    refine(e->getKid(0), kv);
+    break;
+  }
+
+  case Expr::Concat: {
+    Expr::Width rw = e->getKid(1)->getWidth();
+    uint64_t rm = AbstractValue::mask(rw);
+    AbstractValue lv = AbstractValue::top(w - rw);
+    lv.knownZero = res.knownZero >> rw;
+    lv.knownOne = res.knownOne >> rw;
+    lv.min = res.min >> rw;
+    lv.max = res.max >> rw;
+    lv.normalize();
+    AbstractValue rv = AbstractValue::top(rw);
+    rv.knownZero = res.knownZero & rm;
+    rv.knownOne = res.knownOne & rm;
+    if ((res.min >> rw) == (res.max >> rw)) {
+      rv.min = res.min & rm;
+      rv.max = res.max & rm;
+    }
+    rv.normalize();
+    refine(e->getKid(0), lv);
+    refine(e->getKid(1), rv);
+    break;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    Expr::Width kw = ee->expr->getWidth();
+    AbstractValue kv = AbstractValue::top(kw);
+    kv.knownZero = res.knownZero << ee->offset;
+    kv.knownOne = res.knownOne << ee->offset;
+    if (ee->offset + w == kw) {
+      kv.min = res.min << ee->offset;
+      kv.max = (res.max << ee->offset) | AbstractValue::mask(ee->offset);
+    }
+    kv.normalize();
+    refine(ee->expr, kv);
+    break;
+  }
+
+  case Expr::Not: {
+    AbstractValue kv = res;
+    kv.knownZero = res.knownOne;
+    kv.knownOne = res.knownZero;
+    kv.min = m - res.max;
+    kv.max = m - res.min;
+    refine(e->getKid(0), kv);
+    break;
+  }
+
+  case Expr::And:
+  case Expr::Or: {
+    // Bits which are one in a conjunction are one in both operands, bits
+    // which are zero in a disjunction are zero in both.
+    bool isAnd = e->getKind() == Expr::And;
+    for (unsigned i = 0; i != 2; ++i) {
+      AbstractValue kv = AbstractValue::top(w);
+      if (isAnd)
+        kv.knownOne = res.knownOne;
+      else
+        kv.knownZero = res.knownZero;
+      // With a constant operand the other one is known where the constant
+      // does not decide the result.
+      if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e->getKid(1 - i))) {
+        uint64_t c = ce->getZExtValue();
+        if (isAnd)
+          kv.knownZero |= res.knownZero & c;
+        else
+          kv.knownOne |= res.knownOne & ~c;
+      }
+      kv.normalize();
+      refine(e->getKid(i), kv);
+    }
+    break;
+  }
+
+  case Expr::Xor:
+    if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e->getKid(0))) {
+      uint64_t c = ce->getZExtValue();
+      AbstractValue kv = AbstractValue::top(w);
+      kv.knownZero = (res.knownZero & ~c) | (res.knownOne & c);
+      kv.knownOne = (res.knownOne & ~c) | (res.knownZero & c);
+      kv.normalize();
+      refine(e->getKid(1), kv);
+    }
+    break;
+
+  case Expr::Add:
+    // c + x in [min, max] gives x in [min - c, max - c], unless the
+    // interval wraps around.
+    if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e->getKid(0))) {
+      uint64_t c = ce->getZExtValue();
+      if ((res.min >= c) == (res.max >= c))
+        refine(e->getKid(1), AbstractValue::range((res.min - c) & m,
+                                                  (res.max - c) & m, w));
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  if (!res.isConstant() || w != Expr::Bool)
+    return;
+  bool isTrue = res.min != 0;
+
+  switch (e->getKind()) {
+  case Expr::Eq:
+    refineEquality(e->getKid(0), e->getKid(1), isTrue);
+    break;
+  case Expr::Ne:
+    refineEquality(e->getKid(0), e->getKid(1), !isTrue);
+    break;
+  case Expr::Ult:
+    refineUlt(e->getKid(0), e->getKid(1), false, isTrue);
+    break;
+  case Expr::Ule:
+    refineUlt(e->getKid(0), e->getKid(1), true, isTrue);
+    break;
+  case Expr::Ugt:
+    refineUlt(e->getKid(1), e->getKid(0), false, isTrue);
+    break;
+  case Expr::Uge:
+    refineUlt(e->getKid(1), e->getKid(0), true, isTrue);
+    break;
+  default:
+    break;
+  }
+}
+
+/***/
+
+namespace {
+
+class IntervalSolver : public IncompleteSolver {
+  struct CacheEntry {
+    std::vector< ref<Expr> > constraints;
+    AbstractState state;
+  };
+
+  /// The abstract states for recently seen constraint sets, by the hash
+  /// of the constraints. Queries of a state mostly extend the constraints
+  /// of previous queries, whose abstract state is then only refined with
+  /// the new constraints.
+  typedef std::map<uint64_t, CacheEntry> cache_ty;
+  cache_ty cache;
+
+  /// Maximal number of cached abstract states.
+  static const unsigned MaxCacheSize = 1024;
+
+  /// The state for the constraints of \a query.
+  AbstractState *getState(const Query &query);
+
+  /// Evaluate the expression of \a query under its constraints.
+  bool evaluate(const Query &query, AbstractValue &result);
+
+public:
+  IncompleteSolver::PartialValidity computeTruth(const Query&);
+  IncompleteSolver::PartialValidity computeValidity(const Query&);
+  bool computeValue(const Query&, ref<Expr> &result);
+  bool computeInitialValues(const Query&,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution) {
+    return false;
+  }
+};
+
+}
+
+AbstractState *IntervalSolver::getState(const Query &query) {
+  const ConstraintManager &constraints = query.constraints;
+  unsigned n = constraints.size();
+
+  std::vector<uint64_t> hashes(n + 1);
+  hashes[0] = 0;
+  for (unsigned i = 0; i != n; ++i)
+    hashes[i + 1] = hashes[i] * Expr::MAGIC_HASH_CONSTANT +
+      constraints[i]->hash();
+
+  // Find the longest prefix of the constraints with a known state.
+  AbstractState state;
+  unsigned known = 0;
+  for (unsigned i = n; i != 0; --i) {
+    cache_ty::iterator it = cache.find(hashes[i]);
+    if (it == cache.end() || it->second.constraints.size() != i)
+      continue;
+    if (!std::equal(it->second.constraints.begin(),
+                    it->second.constraints.end(), constraints.begin()))
+      continue;
+    if (i == n)
+      return &it->second.state;
+    state = it->second.state;
+    known = i;
+    break;
+  }
+
+  // Refine with the new constraints, twice so that constraints can make
+  // use of the bytes refined by later ones.
+  AbstractEvaluator evaluator(state);
+  for (unsigned pass = 0; pass != 2 && !state.empty; ++pass) {
+    evaluator.resetChanged();
+    for (unsigned i = known; i != n; ++i)
+      evaluator.addConstraint(constraints[i]);
+    if (!evaluator.hasChanged())
+      break;
+  }
+
+  if (cache.size() >= MaxCacheSize)
+    cache.clear();
+  CacheEntry &entry = cache[hashes[n]];
+  entry.constraints.assign(constraints.begin(), constraints.end());
+  entry.state = state;
+  return &entry.state;
+}
+
+bool IntervalSolver::evaluate(const Query &query, AbstractValue &result) {
+  AbstractState *state = getState(query);
+  // Leave queries with unsatisfiable constraints to the core solver.
+  if (state->empty)
+    return false;
+  AbstractEvaluator evaluator(*state);
+  if (!evaluator.evaluate(query.expr, result) || result.isEmpty())
+    return false;
+  return true;
+}
+
+// The constraints of a query are satisfiable (as guaranteed by the
+// executor), so an expression which must be false under them is invalid.
+
+IncompleteSolver::PartialValidity
+IntervalSolver::computeTruth(const Query &query) {
+  AbstractValue v;
+  if (!evaluate(query, v) || !v.isConstant())
+    return None;
+  ++stats::queryIntervalSolverHits;
+  return v.min ? MustBeTrue : MustBeFalse;
+}
+
+IncompleteSolver::PartialValidity
+IntervalSolver::computeValidity(const Query &query) {
+  return computeTruth(query);
+}
+
+bool IntervalSolver::computeValue(const Query &query, ref<Expr> &result) {
+  AbstractValue v;
+  if (!evaluate(query, v) || !v.isConstant())
+    return false;
+  ++stats::queryIntervalSolverHits;
+  result = ConstantExpr::create(v.min, v.width);
+  return true;
+}
+
+Solver *klee::createIntervalSolver(Solver *s) {
+  return new Solver(new StagedSolverImpl(new IntervalSolver(), s));
+}
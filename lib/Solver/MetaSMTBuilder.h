@@ -190,7 +190,7 @@ MetaSMTBuilder<SolverContext>::getArrayForUpdate(const Array *root,
                          metaSMT::logic::Array::store(
                              getArrayForUpdate(root, un->next),
                              construct(un->index, 0), construct(un->value, 0)));
-      _arr_hash.hashUpdateNodeExpr(un, un_expr);
+      _arr_hash.hashUpdateNodeExpr(root, un, un_expr);
     }
     return (un_expr);
   }
@@ -586,6 +586,7 @@ typename SolverContext::result_type
 MetaSMTBuilder<SolverContext>::construct(ref<Expr> e) {
   typename SolverContext::result_type res = construct(e, 0);
   _constructed.clear();
+  _arr_hash.clearUpdateNodeExprs();
   return res;
 }
 
@@ -0,0 +1,380 @@
+//===-- NormalizingSolver.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
+#include "klee/util/ExprLRUCache.h"
+#include "klee/util/ExprVisitor.h"
+
+#include <vector>
+
+using namespace klee;
+
+/***/
+
+namespace {
+
+/// Rewrites the byte-level patterns which dominate the queries on parsers
+/// into forms which are smaller and more often decided by construction:
+///
+///   Extract(ZExt(x))        -> Extract(x), 0 or ZExt(Extract(x))
+///   ZExt(ZExt(x))           -> ZExt(x)
+///   Concat(0, x)            -> ZExt(x)
+///   Eq(C, Concat(a, b))     -> And(Eq(C.hi, a), Eq(C.lo, b))
+///   Eq(Concat(a, b), Concat(c, d)) -> And(Eq(a, c), Eq(b, d))
+///   Cmp(ZExt(x), C)         -> Cmp(x, C.lo), or a constant if C is out of
+///                              the range of x (likewise for ZExt on both
+///                              sides, and for signed comparisons)
+///
+/// The expressions built by a rewrite are visited in turn, so the result
+/// is a fixed point of the rewrites.
+class QueryNormalizer : public ExprVisitor {
+public:
+  QueryNormalizer() : ExprVisitor(false) {}
+
+protected:
+  Action visitExprPost(const Expr &e) {
+    ref<Expr> ep(const_cast<Expr *>(&e));
+    ref<Expr> res = rewrite(ep);
+    // The rewrites build new expressions which may be rewritten again.
+    if (res != ep)
+      res = visit(res);
+    return Action::changeTo(res);
+  }
+
+private:
+  /// Apply a single rewrite to \a e, whose kids are normalized.
+  static ref<Expr> rewrite(const ref<Expr> &e);
+  static ref<Expr> rewriteExtract(const ref<Expr> &e, unsigned off,
+                                  Expr::Width w);
+  static ref<Expr> rewriteConcat(const ref<Expr> &l, const ref<Expr> &r);
+  static ref<Expr> rewriteEq(const ref<Expr> &l, const ref<Expr> &r);
+  static ref<Expr> rewriteUnsignedCmp(Expr::Kind k, const ref<Expr> &l,
+                                      const ref<Expr> &r);
+  static ref<Expr> rewriteSignedCmp(Expr::Kind k, const ref<Expr> &l,
+                                    const ref<Expr> &r);
+};
+
+ref<Expr> QueryNormalizer::rewrite(const ref<Expr> &e) {
+  switch (e->getKind()) {
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    ref<Expr> res = rewriteExtract(ee->expr, ee->offset, ee->width);
+    return res.isNull() ? e : res;
+  }
+  case Expr::ZExt: {
+    const ZExtExpr *ze = cast<ZExtExpr>(e);
+    if (const ZExtExpr *inner = dyn_cast<ZExtExpr>(ze->src))
+      return ZExtExpr::create(inner->src, ze->width);
+    return e;
+  }
+  case Expr::Concat: {
+    ref<Expr> res = rewriteConcat(e->getKid(0), e->getKid(1));
+    return res.isNull() ? e : res;
+  }
+  case Expr::Eq: {
+    ref<Expr> res = rewriteEq(e->getKid(0), e->getKid(1));
+    return res.isNull() ? e : res;
+  }
+  case Expr::Ult:
+  case Expr::Ule: {
+    ref<Expr> res =
+        rewriteUnsignedCmp(e->getKind(), e->getKid(0), e->getKid(1));
+    return res.isNull() ? e : res;
+  }
+  case Expr::Slt:
+  case Expr::Sle: {
+    ref<Expr> res =
+        rewriteSignedCmp(e->getKind(), e->getKid(0), e->getKid(1));
+    return res.isNull() ? e : res;
+  }
+  default:
+    return e;
+  }
+}
+
+/// \return the rewritten extract of \a e, or null if no rewrite applies.
+ref<Expr> QueryNormalizer::rewriteExtract(const ref<Expr> &e, unsigned off,
+                                          Expr::Width w) {
+  const ZExtExpr *ze = dyn_cast<ZExtExpr>(e);
+  if (!ze)
+    return 0;
+
+  Expr::Width srcWidth = ze->src->getWidth();
+  if (off >= srcWidth)
+    return ConstantExpr::create(0, w);
+  if (off + w <= srcWidth)
+    return ExtractExpr::create(ze->src, off, w);
+  return ZExtExpr::create(ExtractExpr::create(ze->src, off, srcWidth - off),
+                          w);
+}
+
+/// \return the rewritten concatenation of \a l and \a r, or null if no
+/// rewrite applies.
+ref<Expr> QueryNormalizer::rewriteConcat(const ref<Expr> &l, const ref<Expr> &r) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(l))
+    if (CE->isZero())
+      return ZExtExpr::create(r, l->getWidth() + r->getWidth());
+  return 0;
+}
+
+/// \return the rewritten equality of \a l and \a r, or null if no
+/// rewrite applies.
+ref<Expr> QueryNormalizer::rewriteEq(const ref<Expr> &l, const ref<Expr> &r) {
+  if (l->getWidth() == Expr::Bool)
+    return 0;
+
+  // Compare the parts of a concatenation separately, so that each byte
+  // which is known not to match makes the whole equality false.
+  if (const ConcatExpr *rc = dyn_cast<ConcatExpr>(r)) {
+    Expr::Width lowWidth = rc->getRight()->getWidth();
+    ref<Expr> lhigh, llow;
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(l)) {
+      lhigh = CE->Extract(lowWidth, rc->getLeft()->getWidth());
+      llow = CE->Extract(0, lowWidth);
+    } else if (const ConcatExpr *lc = dyn_cast<ConcatExpr>(l)) {
+      if (lc->getRight()->getWidth() != lowWidth)
+        return 0;
+      lhigh = lc->getLeft();
+      llow = lc->getRight();
+    } else {
+      return 0;
+    }
+    return AndExpr::create(EqExpr::create(lhigh, rc->getLeft()),
+                           EqExpr::create(llow, rc->getRight()));
+  }
+
+  // Constants are pushed through zero extends by EqExpr::create.
+  const ZExtExpr *lz = dyn_cast<ZExtExpr>(l), *rz = dyn_cast<ZExtExpr>(r);
+  if (lz && rz && lz->src->getWidth() == rz->src->getWidth())
+    return EqExpr::create(lz->src, rz->src);
+
+  return 0;
+}
+
+static ref<Expr> createUnsignedCmp(Expr::Kind k, const ref<Expr> &l,
+                                   const ref<Expr> &r) {
+  return k == Expr::Ult ? UltExpr::create(l, r) : UleExpr::create(l, r);
+}
+
+/// \return the rewritten unsigned comparison of kind \a k of \a l and
+/// \a r, or null if no rewrite applies.
+ref<Expr> QueryNormalizer::rewriteUnsignedCmp(Expr::Kind k,
+                                              const ref<Expr> &l,
+                                              const ref<Expr> &r) {
+  const ZExtExpr *lz = dyn_cast<ZExtExpr>(l), *rz = dyn_cast<ZExtExpr>(r);
+
+  // x < 0 and 0 <= x
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(k == Expr::Ult ? r : l))
+    if (CE->isZero())
+      return ConstantExpr::create(k == Expr::Ule, Expr::Bool);
+
+  if (lz && rz && lz->src->getWidth() == rz->src->getWidth())
+    return createUnsignedCmp(k, lz->src, rz->src);
+
+  if (lz && isa<ConstantExpr>(r)) {
+    ref<ConstantExpr> rc = cast<ConstantExpr>(r);
+    ref<ConstantExpr> trunc = rc->ZExt(lz->src->getWidth());
+    // The constant is above every value of the extended expression.
+    if (trunc->ZExt(rc->getWidth()) != rc)
+      return ConstantExpr::create(1, Expr::Bool);
+    return createUnsignedCmp(k, lz->src, trunc);
+  }
+
+  if (rz && isa<ConstantExpr>(l)) {
+    ref<ConstantExpr> lc = cast<ConstantExpr>(l);
+    ref<ConstantExpr> trunc = lc->ZExt(rz->src->getWidth());
+    if (trunc->ZExt(lc->getWidth()) != lc)
+      return ConstantExpr::create(0, Expr::Bool);
+    return createUnsignedCmp(k, trunc, rz->src);
+  }
+
+  return 0;
+}
+
+/// \return the rewritten signed comparison of kind \a k of \a l and \a r,
+/// or null if no rewrite applies.
+ref<Expr> QueryNormalizer::rewriteSignedCmp(Expr::Kind k,
+                                            const ref<Expr> &l,
+                                            const ref<Expr> &r) {
+  // A zero extended expression is never negative, so it compares with a
+  // constant the same way in both signed and unsigned terms unless the
+  // constant is negative.
+  Expr::Kind unsignedKind = k == Expr::Slt ? Expr::Ult : Expr::Ule;
+  if (isa<ZExtExpr>(l)) {
+    if (ConstantExpr *rc = dyn_cast<ConstantExpr>(r)) {
+      if (rc->Extract(rc->getWidth() - 1, 1)->isTrue())
+        return ConstantExpr::create(0, Expr::Bool);
+      return createUnsignedCmp(unsignedKind, l, r);
+    }
+  } else if (isa<ZExtExpr>(r)) {
+    if (ConstantExpr *lc = dyn_cast<ConstantExpr>(l)) {
+      if (lc->Extract(lc->getWidth() - 1, 1)->isTrue())
+        return ConstantExpr::create(1, Expr::Bool);
+      return createUnsignedCmp(unsignedKind, l, r);
+    }
+  }
+  return 0;
+}
+
+class NormalizingSolver : public SolverImpl {
+private:
+  Solver *solver;
+
+  /// The normalized forms of recently seen expressions. Constraints are
+  /// shared between many queries, so most of them are found here.
+  ExprLRUCache<ref<Expr> > normalized;
+
+  ref<Expr> normalize(const ref<Expr> &e);
+
+  /// Normalize the constraints and expression of \a query, dropping the
+  /// constraints which become true and splitting conjunctions.
+  ///
+  /// \return false if a constraint becomes false, in which case the query
+  /// should be passed on unchanged.
+  bool normalizeQuery(const Query &query, std::vector< ref<Expr> > &constraints,
+                      ref<Expr> &expr);
+
+public:
+  NormalizingSolver(Solver *_solver) : solver(_solver), normalized(4096, &cacheBytes) {}
+  ~NormalizingSolver() { delete solver; }
+
+  bool computeTruth(const Query&, bool &isValid);
+  bool computeValidity(const Query&, Solver::Validity &result);
+  bool computeValue(const Query&, ref<Expr> &result);
+  bool computeInitialValues(const Query& query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query&);
+  void setCoreSolverTimeout(double timeout);
+};
+
+ref<Expr> NormalizingSolver::normalize(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return e;
+  if (ref<Expr> *res = normalized.lookup(e))
+    return *res;
+  ref<Expr> res = QueryNormalizer().visit(e);
+  normalized.insert(e, res);
+  return res;
+}
+
+static void addConjuncts(const ref<Expr> &e,
+                         std::vector< ref<Expr> > &constraints) {
+  if (const AndExpr *ae = dyn_cast<AndExpr>(e)) {
+    addConjuncts(ae->left, constraints);
+    addConjuncts(ae->right, constraints);
+  } else {
+    constraints.push_back(e);
+  }
+}
+
+bool NormalizingSolver::normalizeQuery(const Query &query,
+                                       std::vector< ref<Expr> > &constraints,
+                                       ref<Expr> &expr) {
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+         ie = query.constraints.end(); it != ie; ++it) {
+    ref<Expr> e = normalize(*it);
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
+      if (CE->isFalse())
+        return false;
+    } else {
+      addConjuncts(e, constraints);
+    }
+  }
+  expr = normalize(query.expr);
+  return true;
+}
+
+bool NormalizingSolver::computeValidity(const Query& query,
+                                        Solver::Validity &result) {
+  std::vector< ref<Expr> > constraints;
+  ref<Expr> expr;
+  if (!normalizeQuery(query, constraints, expr))
+    return solver->impl->computeValidity(query, result);
+
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr)) {
+    ++stats::queryNormalizationHits;
+    result = CE->isTrue() ? Solver::True : Solver::False;
+    return true;
+  }
+  ConstraintManager tmp(constraints);
+  return solver->impl->computeValidity(Query(tmp, expr), result);
+}
+
+bool NormalizingSolver::computeTruth(const Query& query, bool &isValid) {
+  std::vector< ref<Expr> > constraints;
+  ref<Expr> expr;
+  if (!normalizeQuery(query, constraints, expr))
+    return solver->impl->computeTruth(query, isValid);
+
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr)) {
+    ++stats::queryNormalizationHits;
+    isValid = CE->isTrue();
+    return true;
+  }
+  ConstraintManager tmp(constraints);
+  return solver->impl->computeTruth(Query(tmp, expr), isValid);
+}
+
+bool NormalizingSolver::computeValue(const Query& query, ref<Expr> &result) {
+  std::vector< ref<Expr> > constraints;
+  ref<Expr> expr;
+  if (!normalizeQuery(query, constraints, expr))
+    return solver->impl->computeValue(query, result);
+
+  if (isa<ConstantExpr>(expr)) {
+    ++stats::queryNormalizationHits;
+    result = expr;
+    return true;
+  }
+  ConstraintManager tmp(constraints);
+  return solver->impl->computeValue(Query(tmp, expr), result);
+}
+
+bool NormalizingSolver::computeInitialValues(const Query& query,
+                                             const std::vector<const Array*> &objects,
+                                             std::vector< std::vector<unsigned char> > &values,
+                                             bool &hasSolution) {
+  std::vector< ref<Expr> > constraints;
+  ref<Expr> expr;
+  if (!normalizeQuery(query, constraints, expr))
+    return solver->impl->computeInitialValues(query, objects, values,
+                                              hasSolution);
+
+  // The arrays of the query may no longer all be read after normalization,
+  // so this is always passed on for the requested objects to be assigned.
+  ConstraintManager tmp(constraints);
+  return solver->impl->computeInitialValues(Query(tmp, expr), objects, values,
+                                            hasSolution);
+}
+
+SolverImpl::SolverRunStatus NormalizingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *NormalizingSolver::getConstraintLog(const Query& query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void NormalizingSolver::setCoreSolverTimeout(double timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+}
+
+Solver *klee::createNormalizingSolver(Solver *s) {
+  return new Solver(new NormalizingSolver(s));
+}
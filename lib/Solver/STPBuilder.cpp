@@ -12,6 +12,7 @@
 
 #include "klee/Expr.h"
 #include "klee/Solver.h"
+#include "klee/SolverImpl.h"
 #include "klee/util/Bits.h"
 #include "klee/SolverStats.h"
 
@@ -75,7 +76,10 @@ STPArrayExprHash::~STPArrayExprHash() {
 /***/
 
 STPBuilder::STPBuilder(::VC _vc, bool _optimizeDivides)
-  : vc(_vc), optimizeDivides(_optimizeDivides) {
+  : vc(_vc),
+    constructed(ConstructCacheSize ? ConstructCacheSize : ~0U,
+                &SolverImpl::cacheBytes),
+    optimizeDivides(_optimizeDivides), evicted(false) {
 
 }
 
@@ -484,7 +488,7 @@ ExprHandle STPBuilder::getInitialRead(const Array *root, unsigned index) {
                                construct(un->index, 0),
                                construct(un->value, 0));
 	
-	_arr_hash.hashUpdateNodeExpr(un, un_expr);
+	_arr_hash.hashUpdateNodeExpr(root, un, un_expr);
       }
       
       return(un_expr);
@@ -497,17 +501,17 @@ ExprHandle STPBuilder::construct(ref<Expr> e, int *width_out) {
   if (!UseConstructHash || isa<ConstantExpr>(e)) {
     return constructActual(e, width_out);
   } else {
-    ExprHashMap< std::pair<ExprHandle, unsigned> >::iterator it = 
-      constructed.find(e);
-    if (it!=constructed.end()) {
+    std::pair<ExprHandle, unsigned> *cached = constructed.lookup(e);
+    if (cached) {
       if (width_out)
-        *width_out = it->second.second;
-      return it->second.first;
+        *width_out = cached->second;
+      return cached->first;
     } else {
       int width;
       if (!width_out) width_out = &width;
       ExprHandle res = constructActual(e, width_out);
-      constructed.insert(std::make_pair(e, std::make_pair(res, *width_out)));
+      if (constructed.insert(e, std::make_pair(res, *width_out)))
+        evicted = true;
       return res;
     }
   }
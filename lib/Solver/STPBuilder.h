@@ -10,7 +10,8 @@
 #ifndef __UTIL_STPBUILDER_H__
 #define __UTIL_STPBUILDER_H__
 
-#include "klee/util/ExprHashMap.h"
+#include "klee/CommandLine.h"
+#include "klee/util/ExprLRUCache.h"
 #include "klee/util/ArrayExprHash.h"
 #include "klee/Config/config.h"
 
@@ -60,11 +61,20 @@ namespace klee {
   public:
     STPArrayExprHash() {};
     virtual ~STPArrayExprHash();
+
+  protected:
+    void releaseExpr(::VCExpr &exp) {
+      if (exp)
+        ::vc_DeleteExpr(exp);
+    }
   };
 
 class STPBuilder {
   ::VC vc;
-  ExprHashMap< std::pair<ExprHandle, unsigned> > constructed;
+
+  /// The translations of expressions, which are kept across queries (see
+  /// --construct-cache-size).
+  ExprLRUCache< std::pair<ExprHandle, unsigned> > constructed;
 
   /// optimizeDivides - Rewrite division and reminders by constants
   /// into multiplies and shifts. STP should probably handle this for
@@ -73,6 +83,10 @@ class STPBuilder {
 
   STPArrayExprHash _arr_hash;
 
+  /// Whether the construct cache evicted entries since the update node
+  /// expressions of _arr_hash were last cleared.
+  bool evicted;
+
 private:  
 
   ExprHandle bvOne(unsigned width);
@@ -121,7 +135,14 @@ public:
 
   ExprHandle construct(ref<Expr> e) { 
     ExprHandle res = construct(e, 0);
-    constructed.clear();
+    if (!ConstructCacheSize)
+      constructed.clear();
+    // The update node expressions keep their nodes alive, so they are only
+    // kept for as long as the construct cache keeps its entries.
+    if (!ConstructCacheSize || evicted) {
+      _arr_hash.clearUpdateNodeExprs();
+      evicted = false;
+    }
     return res;
   }
 };
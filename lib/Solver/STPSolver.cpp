@@ -330,16 +330,19 @@ bool STPSolverImpl::computeInitialValues(
 
   vc_push(vc);
 
-  for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                         ie = query.constraints.end();
-       it != ie; ++it)
-    vc_assertFormula(vc, builder->construct(*it));
+  ExprHandle stp_e;
+  {
+    TimerStatIncrementer constructTimer(stats::queryConstructTime);
+    for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                           ie = query.constraints.end();
+         it != ie; ++it)
+      vc_assertFormula(vc, builder->construct(*it));
+    stp_e = builder->construct(query.expr);
+  }
 
   ++stats::queries;
   ++stats::queryCounterexamples;
 
-  ExprHandle stp_e = builder->construct(query.expr);
-
   if (DebugDumpSTPQueries) {
     char *buf;
     unsigned long len;
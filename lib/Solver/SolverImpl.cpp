@@ -14,6 +14,8 @@ using namespace klee;
 
 SolverImpl::~SolverImpl() {}
 
+size_t SolverImpl::cacheBytes = 0;
+
 bool SolverImpl::computeValidity(const Query &query, Solver::Validity &result) {
   bool isTrue, isFalse;
   if (!computeTruth(query, isTrue))
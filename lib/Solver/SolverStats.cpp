@@ -22,6 +22,8 @@ Statistic stats::queryCexCacheMisses("QueryCexCacheMisses", "QCexMisses");
 Statistic stats::queryConstructTime("QueryConstructTime", "QBtime") ;
 Statistic stats::queryConstructs("QueriesConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
+Statistic stats::queryIntervalSolverHits("QueryIntervalSolverHits", "QIhits");
+Statistic stats::queryNormalizationHits("QueryNormalizationHits", "QNhits");
 Statistic stats::queryTime("QueryTime", "Qtime");
 
 #ifdef DEBUG
@@ -12,6 +12,7 @@
 
 #include "klee/Expr.h"
 #include "klee/Solver.h"
+#include "klee/SolverImpl.h"
 #include "klee/util/Bits.h"
 #include "ConstantDivision.h"
 #include "klee/SolverStats.h"
@@ -51,12 +52,14 @@ void custom_z3_error_handler(Z3_context ctx, Z3_error_code ec) {
 Z3ArrayExprHash::~Z3ArrayExprHash() {}
 
 void Z3ArrayExprHash::clear() {
-  _update_node_hash.clear();
+  clearUpdateNodeExprs();
   _array_hash.clear();
 }
 
 Z3Builder::Z3Builder(bool autoClearConstructCache)
-    : autoClearConstructCache(autoClearConstructCache) {
+    : constructed(ConstructCacheSize ? ConstructCacheSize : ~0U,
+                  &SolverImpl::cacheBytes),
+      autoClearConstructCache(autoClearConstructCache), evicted(false) {
   // FIXME: Should probably let the client pass in a Z3_config instead
   Z3_config cfg = Z3_mk_config();
   // It is very important that we ask Z3 to let us manage memory so that
@@ -404,7 +407,7 @@ Z3ASTHandle Z3Builder::getArrayForUpdate(const Array *root,
       un_expr = writeExpr(getArrayForUpdate(root, un->next),
                           construct(un->index, 0), construct(un->value, 0));
 
-      _arr_hash.hashUpdateNodeExpr(un, un_expr);
+      _arr_hash.hashUpdateNodeExpr(root, un, un_expr);
     }
 
     return (un_expr);
@@ -419,18 +422,18 @@ Z3ASTHandle Z3Builder::construct(ref<Expr> e, int *width_out) {
   if (!UseConstructHashZ3 || isa<ConstantExpr>(e)) {
     return constructActual(e, width_out);
   } else {
-    ExprHashMap<std::pair<Z3ASTHandle, unsigned> >::iterator it =
-        constructed.find(e);
-    if (it != constructed.end()) {
+    std::pair<Z3ASTHandle, unsigned> *cached = constructed.lookup(e);
+    if (cached) {
       if (width_out)
-        *width_out = it->second.second;
-      return it->second.first;
+        *width_out = cached->second;
+      return cached->first;
     } else {
       int width;
       if (!width_out)
         width_out = &width;
       Z3ASTHandle res = constructActual(e, width_out);
-      constructed.insert(std::make_pair(e, std::make_pair(res, *width_out)));
+      if (constructed.insert(e, std::make_pair(res, *width_out)))
+        evicted = true;
       return res;
     }
   }
@@ -10,7 +10,8 @@
 #ifndef __UTIL_Z3BUILDER_H__
 #define __UTIL_Z3BUILDER_H__
 
-#include "klee/util/ExprHashMap.h"
+#include "klee/CommandLine.h"
+#include "klee/util/ExprLRUCache.h"
 #include "klee/util/ArrayExprHash.h"
 #include "klee/Config/config.h"
 #include <z3.h>
@@ -106,7 +107,9 @@ public:
 };
 
 class Z3Builder {
-  ExprHashMap<std::pair<Z3ASTHandle, unsigned> > constructed;
+  /// The translations of expressions, which are kept across queries (see
+  /// --construct-cache-size).
+  ExprLRUCache<std::pair<Z3ASTHandle, unsigned> > constructed;
   Z3ArrayExprHash _arr_hash;
 
 private:
@@ -172,6 +175,10 @@ private:
   Z3SortHandle getArraySort(Z3SortHandle domainSort, Z3SortHandle rangeSort);
   bool autoClearConstructCache;
 
+  /// Whether the construct cache evicted entries since the update node
+  /// expressions of _arr_hash were last cleared.
+  bool evicted;
+
 public:
   Z3_context ctx;
 
@@ -184,12 +191,22 @@ public:
 
   Z3ASTHandle construct(ref<Expr> e) {
     Z3ASTHandle res = construct(e, 0);
-    if (autoClearConstructCache)
+    if (autoClearConstructCache && !ConstructCacheSize) {
       clearConstructCache();
+    } else if (evicted) {
+      // The update node expressions keep their nodes alive, so they are
+      // only kept for as long as the construct cache keeps its entries.
+      _arr_hash.clearUpdateNodeExprs();
+      evicted = false;
+    }
     return res;
   }
 
-  void clearConstructCache() { constructed.clear(); }
+  void clearConstructCache() {
+    constructed.clear();
+    _arr_hash.clearUpdateNodeExprs();
+    evicted = false;
+  }
 };
 }
 
@@ -91,8 +91,8 @@ void Z3Solver::setCoreSolverTimeout(double timeout) {
 
 char *Z3SolverImpl::getConstraintLog(const Query &query) {
   std::vector<Z3ASTHandle> assumptions;
-  for (std::vector<ref<Expr> >::const_iterator it = query.constraints.begin(),
-                                               ie = query.constraints.end();
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                         ie = query.constraints.end();
        it != ie; ++it) {
     assumptions.push_back(builder->construct(*it));
   }
@@ -176,18 +176,20 @@ bool Z3SolverImpl::internalRunSolver(
 
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
 
-  for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                         ie = query.constraints.end();
-       it != ie; ++it) {
-    Z3_solver_assert(builder->ctx, theSolver, builder->construct(*it));
+  Z3ASTHandle z3QueryExpr;
+  {
+    TimerStatIncrementer constructTimer(stats::queryConstructTime);
+    for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                           ie = query.constraints.end();
+         it != ie; ++it) {
+      Z3_solver_assert(builder->ctx, theSolver, builder->construct(*it));
+    }
+    z3QueryExpr = Z3ASTHandle(builder->construct(query.expr), builder->ctx);
   }
   ++stats::queries;
   if (objects)
     ++stats::queryCounterexamples;
 
-  Z3ASTHandle z3QueryExpr =
-      Z3ASTHandle(builder->construct(query.expr), builder->ctx);
-
   // KLEE Queries are validity queries i.e.
   // ∀ X Constraints(X) → query(X)
   // but Z3 works in terms of satisfiability so instead we ask the
@@ -202,12 +204,14 @@ bool Z3SolverImpl::internalRunSolver(
                                        hasSolution);
 
   Z3_solver_dec_ref(builder->ctx, theSolver);
-  // Clear the builder's cache to prevent memory usage exploding.
-  // By using ``autoClearConstructCache=false`` and clearning now
-  // we allow Z3_ast expressions to be shared from an entire
+  // Unless translations are kept across queries (bounded by
+  // --construct-cache-size), clear the builder's cache to prevent memory
+  // usage exploding. By using ``autoClearConstructCache=false`` and
+  // clearning now we allow Z3_ast expressions to be shared from an entire
   // ``Query`` rather than only sharing within a single call to
   // ``builder->construct()``.
-  builder->clearConstructCache();
+  if (!ConstructCacheSize)
+    builder->clearConstructCache();
 
   if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
       runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
@@ -0,0 +1,30 @@
+// Check that reusing the expressions built for instructions explores the
+// same paths as building them anew, and that its lookups are recorded.
+
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --cache-expr-builds %t.bc
+// RUN: grep "KLEE: done: explored paths = 3" %t.klee-out/info
+// RUN: FileCheck -input-file=%t.klee-out/run.stats %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc
+// RUN: grep "KLEE: done: explored paths = 3" %t.klee-out/info
+
+// CHECK: 'ExprBuilderCacheHits','ExprBuilderCacheMisses'
+
+#include "klee/klee.h"
+
+int main() {
+  int x, sum = 0;
+  klee_make_symbolic(&x, sizeof(x), "x");
+
+  // Every iteration builds the same expressions over x.
+  for (int i = 0; i < 16; ++i)
+    sum += (x * 3) ^ (x >> 2);
+
+  if (sum == 16)
+    return 1;
+  if (x < 0)
+    return 2;
+  return 0;
+}
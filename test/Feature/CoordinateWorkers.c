@@ -0,0 +1,32 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --coordinate-workers=2 --search=bfs --donate-states-at=4 %t.bc 2>&1 | FileCheck %s
+// RUN: grep "completed paths = 2" %t.klee-out/worker2/info
+// RUN: grep "completed paths = 2" %t.klee-out/worker3/info
+// RUN: ls %t.klee-out | grep -c ktest | grep -x 8
+// RUN: test -f %t.klee-out/test000008.ktest
+
+// The first worker gives away two of its states once it has four, after
+// the branches on a and b, and each of them is replayed by another worker
+// which explores the branch on c.
+// CHECK: KLEE: done: workers = 3
+// CHECK: KLEE: done: completed paths = 8
+// CHECK: KLEE: done: generated tests = 8
+
+#include "klee/klee.h"
+
+int main() {
+  int a, b, c;
+  klee_make_symbolic(&a, sizeof(a), "a");
+  klee_make_symbolic(&b, sizeof(b), "b");
+  klee_make_symbolic(&c, sizeof(c), "c");
+
+  int r = 0;
+  if (a > 0)
+    r += 1;
+  if (b > 0)
+    r += 2;
+  if (c > 0)
+    r += 4;
+  return r;
+}
@@ -0,0 +1,31 @@
+// Check that the deterministic space grows beyond its initial chunk on
+// demand, and that allocations only fail once the reserved range is used up.
+
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --allocate-determ --allocate-determ-commit-size=1 %t.bc 2>&1 | FileCheck %s
+// RUN: not grep "Not enough deterministic space left" %t.klee-out/warnings.txt
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --allocate-determ --allocate-determ-commit-size=1 --allocate-determ-size=8 %t.bc 2>&1 | FileCheck --check-prefix=CHECK-LIMIT %s
+// RUN: grep "Not enough deterministic space left" %t.klee-out/warnings.txt
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int main() {
+  int i;
+  // 32 MB in total, all of it live at the same time
+  for (i = 0; i < 32; i++) {
+    char *p = malloc(1 << 20);
+    if (!p) {
+      // CHECK-LIMIT: MALLOC FAILED
+      printf("MALLOC FAILED\n");
+      return 1;
+    }
+    p[(1 << 20) - 1] = 1;
+  }
+
+  // CHECK: DONE
+  printf("DONE\n");
+  return 0;
+}
@@ -0,0 +1,45 @@
+// Check that freed memory is reused by the deterministic allocator, so a
+// long sequence of allocations does not exhaust a small deterministic space,
+// but that a freed slot is held back for a while before it is reused.
+
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --allocate-determ --allocate-determ-size=1 --allocate-determ-quarantine=4 %t.bc 2>&1 | FileCheck %s
+// RUN: not grep "Not enough deterministic space left" %t.klee-out/warnings.txt
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int main() {
+  int i;
+  char *first = malloc(100);
+  free(first);
+
+  // A freed slot is not handed out again right away.
+  char *next = malloc(100);
+  assert(next != first);
+  free(next);
+
+  // 100 MB in total, but never more than a few KB live at a time
+  for (i = 0; i < 100000; i++) {
+    char *p = malloc(1000);
+    assert(p && "allocation failed");
+    p[999] = 0;
+    free(p);
+  }
+
+  // Slots of the same size class are handed out again in the order they
+  // were freed, once more than four others were freed after them.
+  for (i = 0; i < 3; i++) {
+    char *p = malloc(100);
+    assert(p != first);
+    free(p);
+  }
+  char *again = malloc(100);
+  assert(again == first);
+
+  // CHECK: DONE
+  printf("DONE\n");
+  return 0;
+}
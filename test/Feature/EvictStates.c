@@ -0,0 +1,48 @@
+// Check that every eviction policy picks states to spill, and that the
+// spilled states are complete when they are read back.
+
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --max-memory=1 --spill-states --evict-states=memory %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --max-memory=1 --spill-states --evict-states=random %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --max-memory=1 --spill-states --evict-states=searcher --search=dfs %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --max-memory=1 --spill-states --evict-states=searcher --search=bfs %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --max-memory=1 --spill-states --evict-states=searcher --search=nurs:depth %t.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out | not grep err
+
+// CHECK: spilled {{[0-9]+}} states to disk
+// CHECK-NOT: killing
+// CHECK: KLEE: done: completed paths = 16
+
+#include "klee/klee.h"
+#include <stdlib.h>
+
+int main() {
+  unsigned char in[5];
+  int i, j, r = 0, x = 0;
+  klee_make_symbolic(in, sizeof(in), "in");
+
+  for (i = 0; i < 4; ++i) {
+    // Objects of different sizes, so that the states hold different
+    // amounts of memory.
+    char *p = malloc(64 << i);
+    p[in[4] & 63] = in[i];
+
+    if (in[i] > 127)
+      r++;
+
+    // Run long enough for the memory usage to be checked.
+    for (j = 0; j < 20000; ++j)
+      x += j;
+
+    if (p[in[4] & 63] != (char) in[i])
+      abort();
+    free(p);
+  }
+
+  return r + (x & 1);
+}
@@ -0,0 +1,36 @@
+// Check that objects are copied out again before an external call whenever
+// their contents changed, both within a state and across forked states
+// which share the contents of a page sized buffer.
+
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck %s
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+char big[8192];
+
+int main() {
+  char buf[8] = "abc";
+  int x;
+
+  assert(strlen(buf) == 3);
+  buf[3] = 'd';
+  assert(strlen(buf) == 4);
+
+  memset(big, 'x', 5000);
+  assert(strlen(big) == 5000);
+
+  klee_make_symbolic(&x, sizeof x, "x");
+  if (x) {
+    big[4096] = 0;
+    // CHECK-DAG: len 4096
+    printf("len %d\n", (int) strlen(big));
+  } else {
+    // CHECK-DAG: len 5000
+    printf("len %d\n", (int) strlen(big));
+  }
+  return 0;
+}
@@ -0,0 +1,37 @@
+// Check that an external call which writes to an object that is no longer
+// bound in the calling state (through a dangling pointer) does not leave
+// stale contents for the other states which still hold the object.
+
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main() {
+  char *p = malloc(16);
+  char *q = malloc(16);
+  int x;
+
+  strcpy(p, "abc");
+  strcpy(q, "abc");
+
+  // Whichever state runs second reads the object the first one wrote to.
+  klee_make_symbolic(&x, sizeof x, "x");
+  if (x) {
+    free(q);
+    strcpy(q, "hello");
+    // CHECK: len 3
+    printf("len %d\n", (int) strlen(p));
+  } else {
+    free(p);
+    strcpy(p, "hello");
+    // CHECK: len 3
+    printf("len %d\n", (int) strlen(q));
+  }
+  return 0;
+}
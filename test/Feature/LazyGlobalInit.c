@@ -0,0 +1,29 @@
+// Check that lazily initialized globals have the same contents as eagerly
+// initialized ones, including pointers to other globals and contents
+// passed to external calls.
+
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --lazy-global-init %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --lazy-global-init=false %t.bc 2>&1 | FileCheck %s
+
+#include <assert.h>
+#include <stdio.h>
+
+int x = 42;
+int *px = &x;
+int unused[1024] = { 1, 2, 3 };
+int arr[100] = { 1, 2, 3 };
+const char *msg = "hello";
+
+int main() {
+  assert(*px == 42);
+  assert(arr[2] == 3 && arr[99] == 0);
+  *px = 1;
+  assert(x == 1);
+
+  // CHECK: hello
+  printf("%s\n", msg);
+  return 0;
+}
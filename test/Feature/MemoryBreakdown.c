@@ -0,0 +1,23 @@
+// Check that the memory usage of the subsystems is recorded, and that
+// tracking it between measurements does not change the explored paths.
+
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --max-memory=1000 %t.bc
+// RUN: grep "KLEE: done: explored paths = 16" %t.klee-out/info
+// RUN: FileCheck -input-file=%t.klee-out/run.stats %s
+
+// CHECK: 'ExprMemory','ObjectMemory','ConstraintMemory','SolverCacheMemory','PTreeMemory'
+
+#include "klee/klee.h"
+
+int main() {
+  char buf[4];
+  klee_make_symbolic(buf, sizeof(buf), "buf");
+
+  int count = 0;
+  for (int i = 0; i < 4; ++i)
+    if (buf[i] > 'a')
+      ++count;
+  return count;
+}
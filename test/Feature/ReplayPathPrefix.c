@@ -0,0 +1,25 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: printf "1\n" > %t.path
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --replay-path %t.path --replay-path-prefix %t.bc 2>&1 | FileCheck %s
+
+// The first branch is fixed by the path, the two others are explored.
+// CHECK: KLEE: done: completed paths = 4
+
+#include "klee/klee.h"
+
+int main() {
+  int a, b, c;
+  klee_make_symbolic(&a, sizeof(a), "a");
+  klee_make_symbolic(&b, sizeof(b), "b");
+  klee_make_symbolic(&c, sizeof(c), "c");
+
+  int r = 0;
+  if (a > 0)
+    r += 1;
+  if (b > 0)
+    r += 2;
+  if (c > 0)
+    r += 4;
+  return r;
+}
@@ -0,0 +1,41 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: printf "1\n" > %t.path
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --replay-path %t.path --replay-path-prefix %t.bc 2>&1 | FileCheck --check-prefix=CHECK-FIRST %s
+// RUN: printf "0\n0\n1\n" > %t.default.path
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --replay-path %t.default.path --replay-path-prefix %t.bc 2>&1 | FileCheck --check-prefix=CHECK-DEFAULT %s
+
+// The switch is recorded as a run of '0's ended by a '1', with the last
+// case written as '0's only. Taking the first case leaves the branches on
+// b and c to be explored.
+// CHECK-FIRST: KLEE: done: completed paths = 4
+
+// Taking the default case and then b > 0 leaves only the branch on c.
+// CHECK-DEFAULT: KLEE: done: completed paths = 2
+
+#include "klee/klee.h"
+
+int main() {
+  int a, b, c;
+  klee_make_symbolic(&a, sizeof(a), "a");
+  klee_make_symbolic(&b, sizeof(b), "b");
+  klee_make_symbolic(&c, sizeof(c), "c");
+
+  int r;
+  switch (a) {
+  case 1:
+    r = 1;
+    break;
+  case 2:
+    r = 2;
+    break;
+  default:
+    r = 3;
+  }
+  if (b > 0)
+    r += 4;
+  if (c > 0)
+    r += 8;
+  return r;
+}
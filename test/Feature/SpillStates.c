@@ -0,0 +1,48 @@
+// Check that states are written to disk rather than killed when over the
+// memory cap, and that they are complete when they are read back.
+
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --max-memory=1 --spill-states %t.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out | not grep err
+
+// Halting reloads the spilled states one at a time to output their tests.
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --max-memory=1 --spill-states --search=bfs --stop-after-n-instructions=1000000 --dump-states-on-halt %t.bc 2>&1 | FileCheck --check-prefix=CHECK-HALT %s
+// RUN: ls %t.klee-out | grep early
+// RUN: ls %t.klee-out | not grep err
+
+// CHECK: spilled {{[0-9]+}} states to disk
+// CHECK-NOT: killing
+// CHECK: KLEE: done: completed paths = 16
+
+// CHECK-HALT: spilled {{[0-9]+}} states to disk
+// CHECK-HALT: halting execution, dumping remaining states
+
+#include "klee/klee.h"
+#include <stdlib.h>
+
+int main() {
+  unsigned char in[5];
+  int i, j, r = 0, x = 0;
+  klee_make_symbolic(in, sizeof(in), "in");
+
+  for (i = 0; i < 4; ++i) {
+    // An object written at a symbolic index by this state only.
+    char *p = malloc(64);
+    p[in[4] & 63] = in[i];
+
+    if (in[i] > 127)
+      r++;
+
+    // Run long enough for the memory usage to be checked.
+    for (j = 0; j < 20000; ++j)
+      x += j;
+
+    if (p[in[4] & 63] != (char) in[i])
+      abort();
+    free(p);
+  }
+
+  return r + (x & 1);
+}
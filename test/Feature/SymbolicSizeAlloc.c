@@ -0,0 +1,27 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --max-sym-size-alloc=64 %t.bc 2>&1 | FileCheck %s
+// RUN: test -f %t.klee-out/test000001.ptr.err
+// RUN: not test -f %t.klee-out/test000001.model.err
+
+#include <assert.h>
+#include <stdlib.h>
+
+int main() {
+  unsigned n;
+  klee_make_symbolic(&n, sizeof(n), "n");
+  klee_assume(n <= 64);
+
+  // A single object of symbolic size instead of one object per size
+  char *p = malloc(n);
+  assert(klee_get_obj_size(p) == n);
+
+  if (n > 10)
+    p[10] = 1;
+
+  // CHECK: SymbolicSizeAlloc.c:24: memory error: out of bound pointer
+  // CHECK-NOT: concretized symbolic size
+  p[n] = 0;
+
+  return 0;
+}
@@ -22,6 +22,7 @@
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/Support/PrintVersion.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "llvm/ADT/StringExtras.h"
 
 #if LLVM_VERSION_CODE > LLVM_VERSION(3, 2)
 #include "llvm/IR/Constants.h"
@@ -67,12 +68,14 @@
 #include <sys/wait.h>
 
 #include <cerrno>
+#include <deque>
 #include <fstream>
 #include <iomanip>
 #include <iterator>
 #include <sstream>
 #include <algorithm>
 #include <iostream>
+#include <map>
 
 
 using namespace llvm;
@@ -197,6 +200,10 @@ namespace {
                  cl::desc("Specify a path file to replay"),
                  cl::value_desc("path file"));
 
+  cl::opt<bool>
+  ReplayPathPrefix("replay-path-prefix",
+                   cl::desc("Explore all the paths which extend the path given by --replay-path, rather than that path only"));
+
   cl::list<std::string>
   SeedOutFile("seed-out");
 
@@ -227,6 +234,11 @@ namespace {
   Watchdog("watchdog",
            cl::desc("Use a watchdog process to enforce --max-time."),
            cl::init(0));
+
+  cl::opt<unsigned>
+  CoordinateWorkers("coordinate-workers",
+                    cl::desc("Explore the paths in this many worker processes, splitting the subtree of a busy worker whenever one is idle. The tests and totals are merged, run.stats and run.istats are kept per worker (requires --output-dir, default=0 (off))"),
+                    cl::init(0));
 }
 
 extern cl::opt<double> MaxTime;
@@ -265,7 +277,7 @@ public:
 
   std::string getOutputFilename(const std::string &filename);
   llvm::raw_fd_ostream *openOutputFile(const std::string &filename);
-  std::string getTestFilename(const std::string &suffix, unsigned id);
+  static std::string getTestFilename(const std::string &suffix, unsigned id);
   llvm::raw_fd_ostream *openTestFile(const std::string &suffix, unsigned id);
 
   // load a .path file
@@ -568,12 +580,9 @@ void KleeHandler::loadPathFile(std::string name,
   if (!f.good())
     assert(0 && "unable to open path file");
 
-  while (f.good()) {
-    unsigned value;
-    f >> value;
+  unsigned value;
+  while (f >> value)
     buffer.push_back(!!value);
-    f.get();
-  }
 }
 
 void KleeHandler::getKTestFilesInDir(std::string directoryPath,
@@ -1130,6 +1139,209 @@ static void halt_via_gdb(int pid) {
     perror("system");
 }
 
+/*** Coordinator for --coordinate-workers ***/
+
+namespace {
+  /// A worker process exploring the subtree below a path prefix.
+  struct CoordinatedWorker {
+    pid_t pid;
+    std::string outputDir;
+    /// The time the worker was last asked to give away states.
+    double lastDonationRequest;
+  };
+}
+
+static void donate_states_handle(int) {
+  if (theInterpreter)
+    theInterpreter->requestStateDonation();
+}
+
+/// Get the number of states of a worker from the last line of its
+/// run.stats, or 0 if it is not known yet.
+static unsigned getWorkerNumStates(const std::string &outputDir) {
+  std::ifstream f((outputDir + "/run.stats").c_str());
+  std::string line, last;
+  while (std::getline(f, line))
+    if (line.size() > 1 && line[0] == '(' && line[1] != '\'')
+      last = line;
+  if (last.empty())
+    return 0;
+
+  // NumStates is the sixth column (see StatsTracker::writeStatsHeader).
+  std::istringstream columns(last.substr(1));
+  std::string column;
+  for (unsigned i = 0; i < 6; ++i)
+    std::getline(columns, column, ',');
+  return atoi(column.c_str());
+}
+
+/// Move the paths given away by a worker (see Executor::donateStates) to
+/// the output directory, and add them to the subtrees left to explore.
+static void collectDonatedPaths(const std::string &workerDir,
+                                unsigned &numPrefixes,
+                                std::deque<std::string> &prefixes) {
+  DIR *d = opendir(workerDir.c_str());
+  if (!d)
+    return;
+  while (struct dirent *entry = readdir(d)) {
+    std::string name = entry->d_name;
+    if (name.compare(0, 7, "donated") != 0 || name.size() < 12 ||
+        name.compare(name.size() - 5, 5, ".path") != 0)
+      continue;
+    std::string prefix = OutputDir + "/prefix" + utostr(++numPrefixes) + ".path";
+    if (rename((workerDir + "/" + name).c_str(), prefix.c_str()) < 0)
+      klee_error("cannot move \"%s\": %s", name.c_str(), strerror(errno));
+    prefixes.push_back(prefix);
+  }
+  closedir(d);
+}
+
+/// Move the test cases of a worker to the output directory, numbering them
+/// after the ones already there, and add up the paths it completed and the
+/// instructions it executed.
+static void collectWorkerResults(const std::string &workerDir,
+                                 unsigned &numTests, unsigned &numPaths,
+                                 uint64_t &numInstructions) {
+  std::map<unsigned, std::vector<std::string> > tests;
+  if (DIR *d = opendir(workerDir.c_str())) {
+    while (struct dirent *entry = readdir(d)) {
+      // test<id>.<suffix>
+      std::string name = entry->d_name;
+      if (name.compare(0, 4, "test") == 0 && name.size() > 11 &&
+          name[10] == '.')
+        tests[atoi(name.substr(4, 6).c_str())].push_back(name);
+    }
+    closedir(d);
+  }
+  for (std::map<unsigned, std::vector<std::string> >::iterator
+         it = tests.begin(), ie = tests.end(); it != ie; ++it) {
+    ++numTests;
+    for (std::vector<std::string>::iterator nit = it->second.begin(),
+           nie = it->second.end(); nit != nie; ++nit) {
+      std::string to = OutputDir + "/" +
+        KleeHandler::getTestFilename(nit->substr(11), numTests);
+      if (rename((workerDir + "/" + *nit).c_str(), to.c_str()) < 0)
+        klee_error("cannot move \"%s\": %s", nit->c_str(), strerror(errno));
+    }
+  }
+
+  std::ifstream info((workerDir + "/info").c_str());
+  std::string line;
+  const std::string completed = "KLEE: done: completed paths = ";
+  const std::string instructions = "KLEE: done: total instructions = ";
+  while (std::getline(info, line)) {
+    if (line.compare(0, completed.size(), completed) == 0)
+      numPaths += atoi(line.substr(completed.size()).c_str());
+    else if (line.compare(0, instructions.size(), instructions) == 0)
+      numInstructions +=
+        strtoull(line.substr(instructions.size()).c_str(), 0, 10);
+  }
+}
+
+/// Hand the subtrees of the execution tree to worker processes until it is
+/// explored, splitting the largest subtree being explored whenever a worker
+/// is idle, and then merge the results of the workers. This only returns
+/// in the workers, set up to explore their subtree.
+///
+/// The test cases and the totals in info are merged. The statistics over
+/// time (run.stats) and the coverage (run.istats) stay in the directories
+/// of the workers, as their subtrees overlap in the instructions covered;
+/// scripts/IStatsMerge.py combines the coverage.
+static void coordinateWorkers() {
+  if (OutputDir == "")
+    klee_error("--coordinate-workers requires --output-dir");
+  if (ReplayPathFile != "")
+    klee_error("--coordinate-workers cannot be used with --replay-path");
+  if (mkdir(OutputDir.c_str(), 0775) < 0)
+    klee_error("cannot create \"%s\": %s", OutputDir.c_str(), strerror(errno));
+  klee_message("output directory is \"%s\"", OutputDir.c_str());
+
+  // The workers stop on ctrl-c by themselves.
+  sys::SetInterruptFunction(interrupt_handle_watchdog);
+
+  // The subtrees left to explore, by the files of the paths leading to
+  // them. The empty path leads to the whole tree.
+  std::deque<std::string> prefixes(1, "");
+  std::vector<CoordinatedWorker> workers;
+  unsigned numRuns = 0, numPrefixes = 0;
+
+  while (!prefixes.empty() || !workers.empty()) {
+    while (!prefixes.empty() && workers.size() < CoordinateWorkers) {
+      CoordinatedWorker w;
+      w.outputDir = OutputDir + "/worker" + utostr(++numRuns);
+      w.lastDonationRequest = util::getWallTime();
+      std::string prefix = prefixes.front();
+      prefixes.pop_front();
+
+      w.pid = fork();
+      if (w.pid < 0)
+        klee_error("unable to fork worker: %s", strerror(errno));
+      if (w.pid == 0) {
+        OutputDir = w.outputDir;
+        ReplayPathFile = prefix;
+        ReplayPathPrefix = true;
+        WritePaths = true;
+        signal(SIGUSR1, donate_states_handle);
+        return;
+      }
+      workers.push_back(w);
+    }
+
+    usleep(100000);
+
+    for (std::vector<CoordinatedWorker>::iterator it = workers.begin();
+         it != workers.end();) {
+      int status, res = waitpid(it->pid, &status, WNOHANG);
+      collectDonatedPaths(it->outputDir, numPrefixes, prefixes);
+      if (res == it->pid) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status))
+          klee_warning("worker in \"%s\" failed", it->outputDir.c_str());
+        it = workers.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    // Ask the worker with the most states to give some away to an idle
+    // worker, giving it time to answer a previous request first.
+    if (prefixes.empty() && workers.size() < CoordinateWorkers) {
+      double now = util::getWallTime();
+      CoordinatedWorker *largest = 0;
+      unsigned largestNumStates = 1;
+      for (std::vector<CoordinatedWorker>::iterator it = workers.begin(),
+             ie = workers.end(); it != ie; ++it) {
+        unsigned numStates = getWorkerNumStates(it->outputDir);
+        if (now >= it->lastDonationRequest + 1. &&
+            numStates > largestNumStates) {
+          largest = &*it;
+          largestNumStates = numStates;
+        }
+      }
+      if (largest) {
+        kill(largest->pid, SIGUSR1);
+        largest->lastDonationRequest = now;
+      }
+    }
+  }
+
+  unsigned numTests = 0, numPaths = 0;
+  uint64_t numInstructions = 0;
+  for (unsigned i = 1; i <= numRuns; ++i)
+    collectWorkerResults(OutputDir + "/worker" + utostr(i), numTests,
+                         numPaths, numInstructions);
+
+  std::stringstream stats;
+  stats << "\n";
+  stats << "KLEE: done: workers = " << numRuns << "\n";
+  stats << "KLEE: done: total instructions = " << numInstructions << "\n";
+  stats << "KLEE: done: completed paths = " << numPaths << "\n";
+  stats << "KLEE: done: generated tests = " << numTests << "\n";
+  llvm::errs() << stats.str();
+  std::ofstream info((OutputDir + "/info").c_str());
+  info << stats.str();
+  exit(0);
+}
+
 // returns the end of the string put in buf
 static char *format_tdiff(char *buf, long seconds)
 {
@@ -1368,6 +1580,9 @@ int main(int argc, char **argv, char **envp) {
     }
   }
 
+  if (CoordinateWorkers)
+    coordinateWorkers();
+
   sys::SetInterruptFunction(interrupt_handle);
 
   // Load the bytecode...
@@ -1522,6 +1737,7 @@ int main(int argc, char **argv, char **envp) {
 
   Interpreter::InterpreterOptions IOpts;
   IOpts.MakeConcreteSymbolic = MakeConcreteSymbolic;
+  IOpts.TrackCoveredLines = WriteCov;
   KleeHandler *handler = new KleeHandler(pArgc, pArgv);
   Interpreter *interpreter =
     theInterpreter = Interpreter::create(ctx, IOpts, handler);
@@ -1537,7 +1753,7 @@ int main(int argc, char **argv, char **envp) {
   externalsAndGlobalsCheck(finalModule);
 
   if (ReplayPathFile != "") {
-    interpreter->setReplayPath(&replayPath);
+    interpreter->setReplayPath(&replayPath, ReplayPathPrefix);
   }
 
   char buf[256];
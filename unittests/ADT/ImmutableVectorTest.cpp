@@ -0,0 +1,133 @@
+//===-- ImmutableVectorTest.cpp ---------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Internal/ADT/ImmutableVector.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+typedef ImmutableVector<unsigned> Vector;
+
+void expectElements(const Vector &v, unsigned n, unsigned first = 0) {
+  ASSERT_EQ(n, v.size());
+  unsigned i = 0;
+  for (Vector::const_iterator it = v.begin(), ie = v.end(); it != ie;
+       ++it, ++i) {
+    EXPECT_EQ(first + i, *it);
+    EXPECT_EQ(first + i, v[i]);
+  }
+  EXPECT_EQ(n, i);
+}
+
+TEST(ImmutableVectorTest, PushBack) {
+  // Enough elements for a tree of three levels.
+  const unsigned n = 32 * 32 + 32 * 2 + 5;
+  Vector v;
+  EXPECT_TRUE(v.empty());
+  for (unsigned i = 0; i != n; ++i) {
+    v.push_back(i);
+    ASSERT_EQ(i, v.back());
+  }
+  expectElements(v, n);
+}
+
+TEST(ImmutableVectorTest, CopiesAreIndependent) {
+  size_t bytes = Vector::getNumAllocatedBytes();
+  {
+    Vector a;
+    for (unsigned i = 0; i != 100; ++i)
+      a.push_back(i);
+    size_t aBytes = Vector::getNumAllocatedBytes();
+
+    // Copies share all nodes.
+    Vector b(a);
+    EXPECT_EQ(aBytes, Vector::getNumAllocatedBytes());
+    EXPECT_TRUE(a == b);
+
+    // Appending to a copy only copies the tail.
+    b.push_back(1000);
+    size_t bBytes = Vector::getNumAllocatedBytes();
+    EXPECT_LT(aBytes, bBytes);
+    EXPECT_GT(aBytes + 100 * sizeof(unsigned), bBytes);
+    expectElements(a, 100);
+    EXPECT_EQ(1000u, b.back());
+    EXPECT_FALSE(a == b);
+
+    // Both can grow past the shared part of the tree.
+    Vector c(b);
+    for (unsigned i = 100; i != 2000; ++i)
+      a.push_back(i);
+    for (unsigned i = 0; i != 100; ++i)
+      c.push_back(i);
+    expectElements(a, 2000);
+    ASSERT_EQ(201u, c.size());
+    EXPECT_EQ(1000u, c[100]);
+    EXPECT_EQ(99u, c[200]);
+    ASSERT_EQ(101u, b.size());
+
+    std::vector<unsigned> elements(a.begin(), a.end());
+    Vector d(elements.begin() + 10, elements.end());
+    expectElements(d, 1990, 10);
+
+    d = c;
+    d.clear();
+    EXPECT_TRUE(d.empty());
+    EXPECT_EQ(201u, c.size());
+  }
+  EXPECT_EQ(bytes, Vector::getNumAllocatedBytes());
+}
+
+TEST(ImmutableVectorTest, SharedElements) {
+  size_t bytes = Vector::getNumAllocatedBytes();
+  {
+    const unsigned n = 32 * 32 + 32 * 3 + 7;
+    Vector a;
+    for (unsigned i = 0; i != n; ++i)
+      a.push_back(i);
+    EXPECT_EQ(0u, a.getNumSharedElements());
+
+    // A copy shares everything until either is changed.
+    Vector b(a);
+    EXPECT_EQ(n, a.getNumSharedElements());
+    b.push_back(n);
+    EXPECT_EQ(n - 7, a.getNumSharedElements());
+    EXPECT_EQ(n - 7, b.getNumSharedElements());
+    for (unsigned i = n + 1; i != n + 100; ++i)
+      b.push_back(i);
+    EXPECT_EQ(n - 7, b.getNumSharedElements());
+    expectElements(b, n + 100);
+
+    // Truncating keeps the whole shared leaves, so it takes no more than
+    // the new inner nodes and tail.
+    size_t beforeBytes = Vector::getNumAllocatedBytes();
+    b.truncate(n - 7);
+    expectElements(b, n - 7);
+    EXPECT_EQ(n - 7, b.getNumSharedElements());
+    EXPECT_GT(beforeBytes, Vector::getNumAllocatedBytes());
+    for (unsigned i = n - 7; i != n + 40; ++i)
+      b.push_back(i);
+    expectElements(b, n + 40);
+    expectElements(a, n);
+
+    Vector c(a);
+    c.truncate(40);
+    expectElements(c, 40);
+    c.truncate(0);
+    EXPECT_TRUE(c.empty());
+    expectElements(a, n);
+  }
+  EXPECT_EQ(bytes, Vector::getNumAllocatedBytes());
+}
+
+}
@@ -0,0 +1,61 @@
+//===-- SharedBitmapTest.cpp ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Internal/ADT/SharedBitmap.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+TEST(SharedBitmapTest, SetAndTest) {
+  SharedBitmap b;
+  EXPECT_TRUE(b.empty());
+  EXPECT_FALSE(b.test(0));
+
+  unsigned values[] = { 100000, 3, 64, 63, 0, 65 };
+  for (unsigned i = 0; i != sizeof(values) / sizeof(values[0]); ++i)
+    b.set(values[i]);
+  EXPECT_FALSE(b.empty());
+  EXPECT_TRUE(b.test(63));
+  EXPECT_TRUE(b.test(100000));
+  EXPECT_FALSE(b.test(1));
+  EXPECT_FALSE(b.test(99999));
+
+  std::vector<unsigned> elements;
+  b.getElements(elements);
+  unsigned expected[] = { 0, 3, 63, 64, 65, 100000 };
+  EXPECT_EQ(std::vector<unsigned>(expected, expected + 6), elements);
+}
+
+TEST(SharedBitmapTest, CopiesAreIndependent) {
+  SharedBitmap a;
+  a.set(1);
+  SharedBitmap b(a);
+  b.set(2);
+  a.set(200);
+  EXPECT_TRUE(a.test(1));
+  EXPECT_FALSE(a.test(2));
+  EXPECT_TRUE(b.test(1));
+  EXPECT_FALSE(b.test(200));
+
+  b = a;
+  a.clear();
+  EXPECT_TRUE(a.empty());
+  EXPECT_TRUE(b.test(200));
+
+  a.swap(b);
+  EXPECT_TRUE(b.empty());
+  EXPECT_TRUE(a.test(200));
+}
+
+}
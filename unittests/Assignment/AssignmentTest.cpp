@@ -33,3 +33,83 @@ TEST(AssignmentTest, FoldNotOptimized)
   ASSERT_TRUE(asConstant != NULL);
   ASSERT_EQ(asConstant->getZExtValue(), (unsigned) 128);
 }
+
+TEST(AssignmentTest, CompiledExpr)
+{
+  ArrayCache ac;
+  const Array* array = ac.CreateArray("arr", /*size=*/ 4);
+  ref<Expr> r0 = ReadExpr::create(UpdateList(array, 0),
+                                  ConstantExpr::alloc(0, Expr::Int32));
+  ref<Expr> r32 = Expr::createTempRead(array, Expr::Int32);
+
+  // An update with a symbolic index, read back at a constant index.
+  UpdateList ul(array, 0);
+  ul.extend(ZExtExpr::create(r0, Expr::Int32),
+            ConstantExpr::alloc(42, Expr::Int8));
+  ref<Expr> updated = ReadExpr::create(ul,
+                                       ConstantExpr::alloc(1, Expr::Int32));
+
+  std::vector< ref<Expr> > exprs;
+  exprs.push_back(AddExpr::create(r32, SExtExpr::create(r0, Expr::Int32)));
+  exprs.push_back(MulExpr::create(ZExtExpr::create(r32, Expr::Int64),
+                                  SExtExpr::create(r32, Expr::Int64)));
+  exprs.push_back(SltExpr::create(r32, ConstantExpr::alloc(7, Expr::Int32)));
+  exprs.push_back(ExtractExpr::create(r32, 3, Expr::Int16));
+  exprs.push_back(AShrExpr::create(r32, ConstantExpr::alloc(5, Expr::Int32)));
+  exprs.push_back(SDivExpr::create(r32, ConstantExpr::alloc(-1, Expr::Int32)));
+  exprs.push_back(URemExpr::create(r32, ZExtExpr::create(r0, Expr::Int32)));
+  exprs.push_back(updated);
+
+  std::vector<Assignment*> assignments;
+  for (unsigned i = 0; i != 4; ++i) {
+    std::vector<const Array*> objects(1, array);
+    std::vector< std::vector<unsigned char> > values(1);
+    for (unsigned j = 0; j != 4; ++j)
+      values[0].push_back((unsigned char) (i * 0x55 + j * 17));
+    assignments.push_back(new Assignment(objects, values));
+  }
+  std::vector<const Assignment*> lanes(assignments.begin(),
+                                       assignments.end());
+
+  for (unsigned i = 0; i != exprs.size(); ++i) {
+    CompiledExpr *ce = CompiledExpr::compile(exprs[i]);
+    ASSERT_TRUE(ce != NULL);
+
+    std::vector<uint64_t> results;
+    std::vector<bool> valid;
+    ce->evaluate(lanes, results, valid);
+    for (unsigned l = 0; l != lanes.size(); ++l) {
+      AssignmentEvaluator v(*lanes[l]);
+      ref<Expr> expected = v.visit(exprs[i]);
+      if (!isa<ConstantExpr>(expected)) {
+        // Division by zero is not folded.
+        ASSERT_FALSE(valid[l]);
+        continue;
+      }
+      ASSERT_TRUE(valid[l]);
+      ASSERT_EQ(cast<ConstantExpr>(expected)->getZExtValue(), results[l]);
+
+      uint64_t single;
+      ASSERT_TRUE(ce->evaluate(*lanes[l], single));
+      ASSERT_EQ(results[l], single);
+    }
+    delete ce;
+  }
+
+  for (unsigned i = 0; i != assignments.size(); ++i)
+    delete assignments[i];
+}
+
+TEST(AssignmentTest, CompiledExprThreshold)
+{
+  ArrayCache ac;
+  const Array* array = ac.CreateArray("threshold_arr", /*size=*/ 4);
+  ref<Expr> e = AddExpr::create(Expr::createTempRead(array, Expr::Int32),
+                                ConstantExpr::alloc(1, Expr::Int32));
+
+  // Compiled on the second use with the default --compile-exprs-threshold.
+  ASSERT_TRUE(CompiledExpr::getCached(e) == NULL);
+  const CompiledExpr *ce = CompiledExpr::getCached(e);
+  ASSERT_TRUE(ce != NULL);
+  ASSERT_EQ(ce, CompiledExpr::getCached(e));
+}
@@ -0,0 +1,62 @@
+//===-- PageStoreTest.cpp ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "PageStore.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+TEST(PageStoreTest, UsedSizeDropsOnRelease) {
+  uint64_t used = PageStore::getUsedSize();
+  uint64_t allocated = PageStore::getAllocatedSize();
+
+  // More than one chunk of full pages, and a partial page.
+  const unsigned N = 1000;
+  std::vector<StorePage *> pages;
+  for (unsigned i = 0; i != N; ++i)
+    pages.push_back(PageStore::allocate(PageStore::PageSize));
+  pages.push_back(PageStore::allocate(100));
+  EXPECT_EQ(used + N * PageStore::PageSize, PageStore::getUsedSize());
+  EXPECT_LT(allocated, PageStore::getAllocatedSize());
+
+  // A page shared with a copy is only released with its last reference.
+  PageStore::retain(pages[0]);
+  for (unsigned i = 0; i != pages.size(); ++i)
+    PageStore::release(pages[i]);
+  EXPECT_EQ(used + PageStore::PageSize, PageStore::getUsedSize());
+
+  PageStore::release(pages[0]);
+  EXPECT_EQ(used, PageStore::getUsedSize());
+  EXPECT_EQ(allocated, PageStore::getAllocatedSize());
+
+  // Released pages are reused before more memory is reserved.
+  StorePage *page = PageStore::allocate(PageStore::PageSize);
+  EXPECT_EQ(used + PageStore::PageSize, PageStore::getUsedSize());
+  PageStore::release(page);
+  EXPECT_EQ(used, PageStore::getUsedSize());
+}
+
+TEST(PageStoreTest, FilledPagesAreShared) {
+  StorePage *a = PageStore::getFilled(PageStore::PageSize, 0);
+  uint64_t used = PageStore::getUsedSize();
+  StorePage *b = PageStore::getFilled(PageStore::PageSize, 0);
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(used, PageStore::getUsedSize());
+  EXPECT_FALSE(b->isWriteable());
+  PageStore::release(a);
+  PageStore::release(b);
+  EXPECT_EQ(used, PageStore::getUsedSize());
+}
+
+}
@@ -0,0 +1,80 @@
+//===-- ConstraintsTest.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/util/ArrayCache.h"
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> getConstant(int value, Expr::Width width) {
+  int64_t ext = value;
+  uint64_t trunc = ext & (((uint64_t) -1LL) >> (64 - width));
+  return ConstantExpr::create(trunc, width);
+}
+
+TEST(ConstraintsTest, MemoryAccounting) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  size_t bytes = ConstraintManager::getNumAllocatedBytes();
+  {
+    ConstraintManager cm;
+    for (unsigned i = 0; i != 100; ++i) {
+      ref<Expr> read = ReadExpr::create(
+          UpdateList(array, 0), getConstant(i, Expr::Int32));
+      cm.addConstraint(UltExpr::create(read, getConstant(100, Expr::Int8)));
+    }
+    EXPECT_LT(bytes + 100 * sizeof(ref<Expr>),
+              ConstraintManager::getNumAllocatedBytes());
+
+    // Copies share the constraints until they add their own. Index all
+    // constraints first, so that the copy does not need its own
+    // simplification cache.
+    ref<Expr> extra = UltExpr::create(
+        ReadExpr::create(UpdateList(array, 0), getConstant(200, Expr::Int32)),
+        getConstant(100, Expr::Int8));
+    cm.simplifyExpr(extra);
+    size_t copyBytes = ConstraintManager::getNumAllocatedBytes();
+    ConstraintManager copy(cm);
+    EXPECT_EQ(copyBytes, ConstraintManager::getNumAllocatedBytes());
+    copy.addConstraint(extra);
+    EXPECT_LT(copyBytes, ConstraintManager::getNumAllocatedBytes());
+    EXPECT_GT(copyBytes + 100 * sizeof(ref<Expr>),
+              ConstraintManager::getNumAllocatedBytes());
+    EXPECT_EQ(100u, cm.size());
+    EXPECT_EQ(101u, copy.size());
+
+    // Only the constraints in the copy's tail belong to it alone. Dropping
+    // them keeps the shared ones in place, with a new path to them.
+    EXPECT_EQ(96u, copy.getNumSharedConstraints());
+    copy.truncate(copy.getNumSharedConstraints());
+    EXPECT_LE(copyBytes, ConstraintManager::getNumAllocatedBytes());
+    EXPECT_GT(copyBytes + 96 * sizeof(ref<Expr>),
+              ConstraintManager::getNumAllocatedBytes());
+    for (unsigned i = 96; i != 100; ++i)
+      copy.restoreConstraint(cm[i]);
+    copy.restoreConstraint(extra);
+    EXPECT_EQ(101u, copy.size());
+    EXPECT_TRUE(copy.back() == extra);
+
+    copy = ConstraintManager();
+    EXPECT_EQ(copyBytes, ConstraintManager::getNumAllocatedBytes());
+
+    // Rewriting equalities rebuilds the indices.
+    cm.addConstraint(EqExpr::create(
+        getConstant(7, Expr::Int8),
+        ReadExpr::create(UpdateList(array, 0), getConstant(3, Expr::Int32))));
+  }
+  EXPECT_EQ(bytes, ConstraintManager::getNumAllocatedBytes());
+}
+}
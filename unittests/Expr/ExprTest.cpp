@@ -264,4 +264,71 @@ TEST(ExprTest, ReadExprFoldingSymbolicIndexUpdate) {
     EXPECT_EQ(Expr::Read, read.get()->getKind());
   }
 }
+
+TEST(ExprTest, HashConsing) {
+  Expr::hashConsing = true;
+  unsigned numHashConsed = Expr::getNumHashConsed();
+  {
+    ArrayCache ac;
+    const Array *array = ac.CreateArray("arr", 256);
+    ref<Expr> read1 = Expr::createTempRead(array, Expr::Int32);
+    ref<Expr> read2 = Expr::createTempRead(array, Expr::Int32);
+    ref<Expr> add1 = AddExpr::create(read1, getConstant(1, Expr::Int32));
+    ref<Expr> add2 = AddExpr::create(read2, getConstant(1, Expr::Int32));
+
+    // Structurally equal expressions are shared.
+    EXPECT_EQ(read1.get(), read2.get());
+    EXPECT_EQ(add1.get(), add2.get());
+    EXPECT_TRUE(add1->isHashConsed());
+    EXPECT_NE(add1.get(), AddExpr::create(read1,
+                                          getConstant(2, Expr::Int32)).get());
+    EXPECT_GT(Expr::getNumHashConsed(), numHashConsed);
+  }
+  // Expressions leave the table once they are no longer referenced.
+  EXPECT_EQ(numHashConsed, Expr::getNumHashConsed());
+  Expr::hashConsing = false;
+}
+
+TEST(ExprTest, MemoryPerNode) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  ref<Expr> read = Expr::createTempRead(array, Expr::Int32);
+  const unsigned N = 10000;
+  size_t bytes = Expr::getNumAllocatedBytes();
+  unsigned count = Expr::count;
+  {
+    std::vector<ref<Expr> > exprs;
+    for (unsigned i = 0; i != N; ++i)
+      exprs.push_back(getConstant(i + 1, Expr::Int32));
+    double constantBytes =
+        double(Expr::getNumAllocatedBytes() - bytes) / (Expr::count - count);
+
+    size_t binaryStart = Expr::getNumAllocatedBytes();
+    for (unsigned i = 0; i != N; ++i)
+      exprs.push_back(AddExpr::create(exprs[i], read));
+    double binaryBytes =
+        double(Expr::getNumAllocatedBytes() - binaryStart) / N;
+
+    size_t readStart = Expr::getNumAllocatedBytes();
+    UpdateList ul(array, 0);
+    for (unsigned i = 0; i != N; ++i)
+      exprs.push_back(ReadExpr::create(ul, exprs[N + i]));
+    double readBytes = double(Expr::getNumAllocatedBytes() - readStart) / N;
+
+    std::cout << "bytes per node: constant " << constantBytes << ", binary "
+              << binaryBytes << ", read " << readBytes << "\n";
+    EXPECT_EQ(double(sizeof(ConstantExpr)), constantBytes);
+    EXPECT_EQ(double(sizeof(AddExpr)), binaryBytes);
+    EXPECT_EQ(double(sizeof(ReadExpr)), readBytes);
+    if (sizeof(void *) == 8) {
+      // A vtable pointer and one word each for the reference count and
+      // hash, the width and kind, and the value or each kid.
+      EXPECT_EQ(32u, sizeof(ConstantExpr));
+      EXPECT_EQ(40u, sizeof(AddExpr));
+      EXPECT_EQ(32u, sizeof(ZExtExpr));
+    }
+  }
+  EXPECT_EQ(count, Expr::count);
+  EXPECT_EQ(bytes, Expr::getNumAllocatedBytes());
+}
 }
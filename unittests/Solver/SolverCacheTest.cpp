@@ -0,0 +1,86 @@
+//===-- SolverCacheTest.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr.h"
+#include "klee/util/ArrayCache.h"
+#include "klee/util/ArrayExprHash.h"
+#include "klee/util/ExprLRUCache.h"
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> getConstant(int value, Expr::Width width) {
+  int64_t ext = value;
+  uint64_t trunc = ext & (((uint64_t) -1LL) >> (64 - width));
+  return ConstantExpr::create(trunc, width);
+}
+
+TEST(SolverCacheTest, LRUCache) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  ref<Expr> a = Expr::createTempRead(array, Expr::Int8);
+  ref<Expr> b = AddExpr::create(a, getConstant(1, Expr::Int8));
+  ref<Expr> c = AddExpr::create(a, getConstant(2, Expr::Int8));
+
+  ExprLRUCache<int> cache(2);
+  EXPECT_FALSE(cache.insert(a, 1));
+  EXPECT_FALSE(cache.insert(b, 2));
+  // Using a makes b the least recently used entry.
+  ASSERT_TRUE(cache.lookup(a));
+  EXPECT_EQ(1, *cache.lookup(a));
+  EXPECT_TRUE(cache.insert(c, 3));
+  EXPECT_EQ(2U, cache.size());
+  EXPECT_FALSE(cache.lookup(b));
+  EXPECT_EQ(3, *cache.lookup(c));
+  // Lookups are structural.
+  EXPECT_EQ(3, *cache.lookup(AddExpr::create(a, getConstant(2, Expr::Int8))));
+  cache.clear();
+  EXPECT_FALSE(cache.lookup(a));
+}
+
+TEST(SolverCacheTest, LRUCacheMemoryAccounting) {
+  size_t bytes = 0;
+  {
+    ExprLRUCache<int> cache(2, &bytes);
+    cache.insert(getConstant(1, Expr::Int8), 1);
+    size_t entryBytes = bytes;
+    EXPECT_LT(0u, entryBytes);
+    cache.insert(getConstant(2, Expr::Int8), 2);
+    // Evicting an entry frees its space for the new one.
+    cache.insert(getConstant(3, Expr::Int8), 3);
+    EXPECT_EQ(2 * entryBytes, bytes);
+  }
+  EXPECT_EQ(0u, bytes);
+}
+
+TEST(SolverCacheTest, ArrayExprHashReleasesUpdateNodes) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  ref<Expr> value = getConstant(42, Expr::Int8);
+  unsigned refCount = value->refCount;
+
+  ArrayExprHash<int> hash;
+  {
+    UpdateList ul(array, 0);
+    ul.extend(getConstant(1, Expr::Int32), value);
+    int exp = 1;
+    hash.hashUpdateNodeExpr(array, ul.head, exp);
+  }
+  // The hash keeps the update node alive while it is hashed.
+  EXPECT_EQ(1U, hash.getNumUpdateNodeExprs());
+  EXPECT_EQ(refCount + 1, value->refCount);
+
+  hash.clearUpdateNodeExprs();
+  EXPECT_EQ(0U, hash.getNumUpdateNodeExprs());
+  EXPECT_EQ(refCount, value->refCount);
+}
+}
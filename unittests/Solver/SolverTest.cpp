@@ -166,4 +166,96 @@ TEST(SolverTest, Evaluation) {
   delete solver;
 }
 
+TEST(SolverTest, IntervalSolver) {
+  // The dummy solver fails all queries, so only the queries which are
+  // decided by the interval solver succeed.
+  Solver *solver = createIntervalSolver(createDummySolver());
+
+  const Array *array = ac.CreateArray("interval", 4);
+  ref<Expr> index = ZExtExpr::create(
+      ReadExpr::create(UpdateList(array, 0), ConstantExpr::alloc(0, Expr::Int32)),
+      Expr::Int32);
+  ref<Expr> word = Expr::createTempRead(array, Expr::Int32);
+
+  ConstraintManager constraints;
+  constraints.addConstraint(UltExpr::create(index,
+                                            ConstantExpr::alloc(10, Expr::Int32)));
+  constraints.addConstraint(EqExpr::create(
+      ConstantExpr::alloc(0, Expr::Int32),
+      AndExpr::create(word, ConstantExpr::alloc(0x80000000, Expr::Int32))));
+
+  bool res;
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(constraints,
+            UltExpr::create(AddExpr::create(ConstantExpr::alloc(4, Expr::Int32),
+                                            index),
+                            ConstantExpr::alloc(16, Expr::Int32))), res));
+  EXPECT_TRUE(res);
+  ASSERT_TRUE(solver->mustBeFalse(
+      Query(constraints,
+            EqExpr::create(ConstantExpr::alloc(12, Expr::Int32), index)), res));
+  EXPECT_TRUE(res);
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(constraints,
+            SleExpr::create(ConstantExpr::alloc(0, Expr::Int32), word)), res));
+  EXPECT_TRUE(res);
+
+  // Not decided by the ranges alone.
+  EXPECT_FALSE(solver->mustBeTrue(
+      Query(constraints,
+            UltExpr::create(index, ConstantExpr::alloc(5, Expr::Int32))), res));
+
+  delete solver;
+}
+
+TEST(SolverTest, NormalizingSolver) {
+  // The dummy solver fails all queries, so only the queries which are
+  // decided by normalization succeed.
+  Solver *solver = createNormalizingSolver(createDummySolver());
+
+  const Array *array = ac.CreateArray("normalize", 4);
+  ref<Expr> byte0 =
+      ReadExpr::create(UpdateList(array, 0), ConstantExpr::alloc(0, Expr::Int32));
+  ref<Expr> byte1 =
+      ReadExpr::create(UpdateList(array, 0), ConstantExpr::alloc(1, Expr::Int32));
+  ref<Expr> word = ConcatExpr::create(byte1, byte0);
+  ref<Expr> wide = ZExtExpr::create(byte0, Expr::Int32);
+
+  ConstraintManager constraints;
+  bool res;
+
+  // Per-byte equality: the high byte is known to be 0x12.
+  ASSERT_TRUE(solver->mustBeFalse(
+      Query(constraints,
+            EqExpr::create(ConstantExpr::alloc(0x1234, Expr::Int16),
+                           ConcatExpr::create(
+                               ConstantExpr::alloc(0x13, Expr::Int8),
+                               byte0))), res));
+  EXPECT_TRUE(res);
+
+  // Comparisons through zero extends, against out of range constants.
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(constraints,
+            UltExpr::create(wide, ConstantExpr::alloc(256, Expr::Int32))), res));
+  EXPECT_TRUE(res);
+  ASSERT_TRUE(solver->mustBeFalse(
+      Query(constraints,
+            SltExpr::create(wide, ConstantExpr::alloc(-1, Expr::Int32))), res));
+  EXPECT_TRUE(res);
+
+  // Extracts of zero extends.
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(solver->getValue(
+      Query(constraints, ExtractExpr::create(wide, 8, Expr::Int16)), value));
+  EXPECT_EQ(0u, value->getZExtValue());
+
+  // Not decided by normalization alone.
+  EXPECT_FALSE(solver->mustBeTrue(
+      Query(constraints,
+            EqExpr::create(ConstantExpr::alloc(0x1234, Expr::Int16), word)),
+      res));
+
+  delete solver;
+}
+
 }
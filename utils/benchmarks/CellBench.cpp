@@ -0,0 +1,97 @@
+//===-- CellBench.cpp -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Times the register work of the executor's concrete integer instructions,
+// once through ConstantExpr (as without --concrete-fast-path) and once on
+// unboxed Cell values. The loop is the inner loop of a bitwise CRC-32, five
+// instructions per iteration. See README.txt for how to build it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr.h"
+#include "klee/Internal/Module/Cell.h"
+#include "klee/Internal/Support/IntEvaluation.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/time.h>
+
+using namespace klee;
+
+namespace {
+const unsigned Iterations = 10000000;
+const Expr::Width W = Expr::Int32;
+
+double now() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1))
+uint64_t runBoxed(uint64_t init) {
+  Cell crc, one, zero, poly, t1, t2, t3, t4;
+  crc.setValue(ConstantExpr::create(init, W));
+  one.setValue(ConstantExpr::create(1, W));
+  zero.setValue(ConstantExpr::create(0, W));
+  poly.setValue(ConstantExpr::create(0xEDB88320u, W));
+  for (unsigned i = 0; i != Iterations; ++i) {
+    t1.setValue(LShrExpr::create(crc.getValue(), one.getValue()));
+    t2.setValue(AndExpr::create(crc.getValue(), one.getValue()));
+    t3.setValue(SubExpr::create(zero.getValue(), t2.getValue()));
+    t4.setValue(AndExpr::create(poly.getValue(), t3.getValue()));
+    crc.setValue(XorExpr::create(t1.getValue(), t4.getValue()));
+  }
+  return cast<ConstantExpr>(crc.getValue())->getZExtValue();
+}
+
+uint64_t runUnboxed(uint64_t init) {
+  Cell crc, one, zero, poly, t1, t2, t3, t4;
+  crc.setImmediate(init, W);
+  one.setImmediate(1, W);
+  zero.setImmediate(0, W);
+  poly.setImmediate(0xEDB88320u, W);
+  for (unsigned i = 0; i != Iterations; ++i) {
+    t1.setImmediate(ints::lshr(crc.getImmediate(), one.getImmediate(), W), W);
+    t2.setImmediate(ints::land(crc.getImmediate(), one.getImmediate(), W), W);
+    t3.setImmediate(ints::sub(zero.getImmediate(), t2.getImmediate(), W), W);
+    t4.setImmediate(ints::land(poly.getImmediate(), t3.getImmediate(), W), W);
+    crc.setImmediate(ints::lxor(t1.getImmediate(), t4.getImmediate(), W), W);
+  }
+  return crc.getImmediate();
+}
+}
+
+int main(int argc, char **argv) {
+  // Take the initial value from the command line, so that the compiler
+  // cannot fold the loops.
+  uint64_t init = argc > 1 ? strtoul(argv[1], 0, 0) : 0xFFFFFFFFu;
+
+  double start = now();
+  uint64_t boxed = runBoxed(init);
+  double boxedTime = now() - start;
+
+  start = now();
+  uint64_t unboxed = runUnboxed(init);
+  double unboxedTime = now() - start;
+
+  if (boxed != unboxed) {
+    fprintf(stderr, "results differ: %llx != %llx\n",
+            (unsigned long long) boxed, (unsigned long long) unboxed);
+    return 1;
+  }
+
+  unsigned instructions = 5 * Iterations;
+  printf("ConstantExpr: %.3fs (%.1f ns/instruction)\n", boxedTime,
+         boxedTime * 1e9 / instructions);
+  printf("unboxed Cell: %.3fs (%.1f ns/instruction)\n", unboxedTime,
+         unboxedTime * 1e9 / instructions);
+  printf("speedup:      %.1fx\n", boxedTime / unboxedTime);
+  return 0;
+}
@@ -0,0 +1,227 @@
+//===-- DispatchBench.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Times the decoding the executor does to dispatch concrete integer
+// instructions: once asking the LLVM instruction for its opcode, predicate
+// and result width on every execution (as before they were recorded in
+// KInstruction), and once reading them from a pre-decoded record. The
+// register work is the same in both. The instructions are the inner loop
+// of a bitwise CRC-32 followed by a comparison and two casts. See
+// README.txt for how to build it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/IntEvaluation.h"
+
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <sys/time.h>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+const unsigned Iterations = 10000000;
+
+double now() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+struct Reg {
+  uint64_t value;
+  unsigned width;
+};
+
+/// What KFunction records in a KInstruction, with operands referring to
+/// register slots.
+struct Decoded {
+  Instruction *inst;
+  unsigned opcode;
+  unsigned predicate;
+  unsigned width;
+  unsigned operands[2];
+  unsigned dest;
+};
+
+uint64_t evalBinary(unsigned opcode, unsigned predicate, uint64_t l,
+                    uint64_t r, unsigned width) {
+  switch (opcode) {
+  case Instruction::Add: return ints::add(l, r, width);
+  case Instruction::Sub: return ints::sub(l, r, width);
+  case Instruction::And: return ints::land(l, r, width);
+  case Instruction::Xor: return ints::lxor(l, r, width);
+  case Instruction::LShr: return ints::lshr(l, r, width);
+  case Instruction::ICmp:
+    switch (predicate) {
+    case ICmpInst::ICMP_EQ: return ints::eq(l, r, width);
+    case ICmpInst::ICMP_NE: return ints::ne(l, r, width);
+    default: abort();
+    }
+  default: abort();
+  }
+}
+
+uint64_t evalCast(unsigned opcode, uint64_t v, unsigned inWidth,
+                  unsigned outWidth) {
+  switch (opcode) {
+  case Instruction::Trunc: return ints::trunc(v, outWidth, inWidth);
+  case Instruction::ZExt: return ints::zext(v, outWidth, inWidth);
+  default: abort();
+  }
+}
+
+/// Decode every instruction as it is executed.
+uint64_t runDecoding(const DataLayout &dl, const std::vector<Decoded> &code,
+                     std::vector<Reg> regs, unsigned crc, unsigned next) {
+  for (unsigned n = 0; n != Iterations; ++n) {
+    for (unsigned j = 0, e = code.size(); j != e; ++j) {
+      const Decoded &d = code[j];
+      Instruction *i = d.inst;
+      unsigned opcode = i->getOpcode();
+      const Reg &left = regs[d.operands[0]];
+      Reg &dest = regs[d.dest];
+      if (Instruction::isCast(opcode)) {
+        unsigned outWidth = dl.getTypeSizeInBits(i->getType());
+        dest.value = evalCast(opcode, left.value, left.width, outWidth);
+        dest.width = outWidth;
+        continue;
+      }
+      unsigned predicate = 0;
+      if (opcode == Instruction::ICmp)
+        predicate = cast<ICmpInst>(i)->getPredicate();
+      const Reg &right = regs[d.operands[1]];
+      dest.value =
+          evalBinary(opcode, predicate, left.value, right.value, left.width);
+      dest.width = opcode == Instruction::ICmp ? 1 : left.width;
+    }
+    regs[crc] = regs[next];
+  }
+  return regs[crc].value;
+}
+
+/// Read the decoded properties of the instructions.
+uint64_t runPredecoded(const std::vector<Decoded> &code,
+                       std::vector<Reg> regs, unsigned crc, unsigned next) {
+  for (unsigned n = 0; n != Iterations; ++n) {
+    for (unsigned j = 0, e = code.size(); j != e; ++j) {
+      const Decoded &d = code[j];
+      const Reg &left = regs[d.operands[0]];
+      Reg &dest = regs[d.dest];
+      if (Instruction::isCast(d.opcode)) {
+        dest.value = evalCast(d.opcode, left.value, left.width, d.width);
+        dest.width = d.width;
+        continue;
+      }
+      const Reg &right = regs[d.operands[1]];
+      dest.value = evalBinary(d.opcode, d.predicate, left.value, right.value,
+                              left.width);
+      dest.width = d.width;
+    }
+    regs[crc] = regs[next];
+  }
+  return regs[crc].value;
+}
+}
+
+int main(int argc, char **argv) {
+  // Take the initial value from the command line, so that the compiler
+  // cannot fold the loops.
+  uint64_t init = argc > 1 ? strtoul(argv[1], 0, 0) : 0xFFFFFFFFu;
+
+  LLVMContext ctx;
+  Module *m = new Module("bench", ctx);
+  DataLayout dl(m);
+  Type *i32 = Type::getInt32Ty(ctx);
+  std::vector<Type *> args(1, i32);
+  Function *f = Function::Create(FunctionType::get(i32, args, false),
+                                 Function::ExternalLinkage, "crc", m);
+  IRBuilder<> b(BasicBlock::Create(ctx, "entry", f));
+
+  // crc' = (crc >> 1) ^ (0xEDB88320 & -(crc & 1))
+  // crc'' = crc' + zext(trunc(crc') != 0)
+  Value *crc = &*f->arg_begin();
+  Value *t1 = b.CreateLShr(crc, b.getInt32(1));
+  Value *t2 = b.CreateAnd(crc, b.getInt32(1));
+  Value *t3 = b.CreateSub(b.getInt32(0), t2);
+  Value *t4 = b.CreateAnd(b.getInt32(0xEDB88320u), t3);
+  Value *t5 = b.CreateXor(t1, t4);
+  Value *t6 = b.CreateTrunc(t5, b.getInt16Ty());
+  Value *t7 = b.CreateICmpNE(t6, b.getInt16(0));
+  Value *t8 = b.CreateZExt(t7, i32);
+  Value *t9 = b.CreateAdd(t5, t8);
+  b.CreateRet(t9);
+
+  // Give every value a register slot, constants included.
+  std::map<Value *, unsigned> slots;
+  std::vector<Reg> regs;
+  Reg r = { init, 32 };
+  slots[crc] = regs.size();
+  regs.push_back(r);
+  std::vector<Decoded> code;
+  for (BasicBlock::iterator it = f->begin()->begin(), ie = f->begin()->end();
+       it != ie; ++it) {
+    Instruction *i = &*it;
+    if (isa<ReturnInst>(i))
+      break;
+    Decoded d;
+    d.inst = i;
+    d.opcode = i->getOpcode();
+    d.predicate = isa<CmpInst>(i) ? cast<CmpInst>(i)->getPredicate() : 0;
+    d.width = dl.getTypeSizeInBits(i->getType());
+    for (unsigned j = 0; j != i->getNumOperands(); ++j) {
+      Value *v = i->getOperand(j);
+      if (!slots.count(v)) {
+        ConstantInt *c = cast<ConstantInt>(v);
+        Reg k = { c->getZExtValue(), c->getBitWidth() };
+        slots[v] = regs.size();
+        regs.push_back(k);
+      }
+      d.operands[j] = slots[v];
+    }
+    Reg result = { 0, d.width };
+    d.dest = slots[i] = regs.size();
+    regs.push_back(result);
+    code.push_back(d);
+  }
+
+  double start = now();
+  uint64_t decoding = runDecoding(dl, code, regs, slots[crc], slots[t9]);
+  double decodingTime = now() - start;
+
+  start = now();
+  uint64_t predecoded = runPredecoded(code, regs, slots[crc], slots[t9]);
+  double predecodedTime = now() - start;
+
+  if (decoding != predecoded) {
+    fprintf(stderr, "results differ: %llx != %llx\n",
+            (unsigned long long) decoding, (unsigned long long) predecoded);
+    return 1;
+  }
+
+  unsigned instructions = code.size() * Iterations;
+  printf("decoding:    %.3fs (%.2f ns/instruction)\n", decodingTime,
+         decodingTime * 1e9 / instructions);
+  printf("pre-decoded: %.3fs (%.2f ns/instruction)\n", predecodedTime,
+         predecodedTime * 1e9 / instructions);
+  printf("speedup:     %.2fx\n", decodingTime / predecodedTime);
+  delete m;
+  return 0;
+}
@@ -0,0 +1,46 @@
+// Purely concrete integer work (arithmetic, shifts, comparisons and casts
+// of every width), which is dominated by the interpreter loop. The same
+// work as test/Concrete/ConcreteFastPath.c, scaled up for timing.
+
+#include <stdint.h>
+#include <stdio.h>
+
+static uint32_t crc32(uint32_t crc, uint8_t byte) {
+  int i;
+  crc ^= byte;
+  for (i = 0; i < 8; ++i)
+    crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+  return crc;
+}
+
+static uint64_t collatz_steps(uint64_t n) {
+  uint64_t steps = 0;
+  while (n != 1) {
+    n = (n & 1) ? 3 * n + 1 : n / 2;
+    ++steps;
+  }
+  return steps;
+}
+
+int main() {
+  uint32_t crc = 0xFFFFFFFFu;
+  uint64_t steps = 0;
+  int16_t acc16 = 0;
+  int64_t acc64 = 0;
+  unsigned i;
+
+  for (i = 0; i < 400000; ++i)
+    crc = crc32(crc, (uint8_t) (i * 7));
+
+  for (i = 1; i < 40000; ++i)
+    steps += collatz_steps(i);
+
+  for (i = 0; i < 400000; ++i) {
+    acc16 = (int16_t) (acc16 * 31 + (int8_t) i) % 12345;
+    acc64 += ((int64_t) acc16 * 128) / ((int) (i % 13) - 6 ? (int) (i % 13) - 6 : 1);
+  }
+
+  printf("%u %u %d %d\n", (unsigned) ~crc, (unsigned) steps, (int) acc16,
+         (int) (acc64 % 100000));
+  return 0;
+}
@@ -0,0 +1,69 @@
+#!/usr/bin/python
+
+# ===-- klee-bench.py -----------------------------------------------------===##
+# 
+#                      The KLEE Symbolic Virtual Machine
+# 
+#  This file is distributed under the University of Illinois Open Source
+#  License. See LICENSE.TXT for details.
+# 
+# ===----------------------------------------------------------------------===##
+
+"""Run klee on a bitcode file with several command lines and compare the
+time they take. Each command line is run a number of times and the fastest
+run counts. The first command line is the baseline for the speedups."""
+
+from __future__ import division, print_function
+import argparse
+import re
+import shutil
+import subprocess
+import tempfile
+import time
+
+def runOnce(cmd, bitcode, args):
+    outDir = tempfile.mkdtemp(prefix='klee-bench-')
+    shutil.rmtree(outDir)
+    try:
+        start = time.time()
+        with open('/dev/null', 'w') as null:
+            subprocess.check_call(cmd.split() +
+                                  ['--output-dir=' + outDir, '--no-output',
+                                   bitcode] + args,
+                                  stdout=null, stderr=null)
+        elapsed = time.time() - start
+        instructions = None
+        for ln in open(outDir + '/info'):
+            m = re.match(r'KLEE: done: total instructions = (\d+)', ln)
+            if m:
+                instructions = int(m.group(1))
+        return elapsed, instructions
+    finally:
+        shutil.rmtree(outDir, ignore_errors=True)
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--runs', type=int, default=3,
+                        help='number of runs of each command line')
+    parser.add_argument('bitcode', help='the program to run')
+    parser.add_argument('commands', nargs='+',
+                        help='klee command lines, e.g. "klee --opt"')
+    parser.add_argument('--args', nargs=argparse.REMAINDER, default=[],
+                        help='arguments of the program')
+    opts = parser.parse_args()
+
+    baseline = None
+    print('%-50s %10s %14s %12s %8s' %
+          ('command', 'time (s)', 'instructions', 'Minst/s', 'speedup'))
+    for cmd in opts.commands:
+        runs = [runOnce(cmd, opts.bitcode, opts.args)
+                for i in range(opts.runs)]
+        elapsed, instructions = min(runs)
+        if baseline is None:
+            baseline = elapsed
+        print('%-50s %10.2f %14s %12.2f %7.2fx' %
+              (cmd, elapsed, instructions,
+               (instructions or 0) / elapsed / 1e6, baseline / elapsed))
+
+if __name__ == '__main__':
+    main()